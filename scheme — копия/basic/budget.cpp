@@ -0,0 +1,117 @@
+#include "budget.h"
+
+#include <algorithm>
+
+#include "error.h"
+
+class SharedBudget {
+public:
+    explicit SharedBudget(const Budget& budget) : fuel_(budget.fuel), token_(budget.token) {
+    }
+
+    // Takes up to wanted steps of the fuel, less if there is not so much left
+    uint64_t Take(uint64_t wanted) {
+        uint64_t fuel = fuel_.load(std::memory_order_relaxed);
+        uint64_t taken;
+        do {
+            taken = std::min(fuel, wanted);
+        } while (!fuel_.compare_exchange_weak(fuel, fuel - taken, std::memory_order_relaxed));
+        return taken;
+    }
+    void GiveBack(uint64_t steps) {
+        fuel_.fetch_add(steps, std::memory_order_relaxed);
+    }
+    uint64_t Fuel() const {
+        return fuel_.load(std::memory_order_relaxed);
+    }
+
+    // Throws Interrupted if the evaluation is over: stopped on another thread, or cancelled
+    void Check() const {
+        int stopped = stopped_.load(std::memory_order_relaxed);
+        if (stopped != kRunning) {
+            throw Interrupted(static_cast<Interrupted::Reason>(stopped));
+        }
+        if (token_ && token_->IsCancelled()) {
+            Stop(Interrupted::Reason::kCancelled);
+        }
+    }
+    // Ends the evaluation on every thread, and on this one with Interrupted
+    [[noreturn]] void Stop(Interrupted::Reason reason) const {
+        int running = kRunning;
+        stopped_.compare_exchange_strong(running, static_cast<int>(reason),
+                                         std::memory_order_relaxed);
+        throw Interrupted(reason);
+    }
+
+private:
+    static constexpr int kRunning = -1;
+
+    std::atomic<uint64_t> fuel_;
+    std::shared_ptr<const CancellationToken> token_;
+    mutable std::atomic<int> stopped_ = kRunning;
+};
+
+namespace {
+
+thread_local BudgetScope* current_scope = nullptr;
+
+}  // namespace
+
+BudgetScope::BudgetScope(const Budget& budget)
+    : BudgetScope(std::make_shared<SharedBudget>(budget)) {
+}
+
+BudgetScope::BudgetScope(std::shared_ptr<SharedBudget> shared)
+    : shared_(std::move(shared)),
+      previous_(current_scope),
+      previous_countdown_(budget_internal::countdown) {
+    // an evaluation short enough to take no check would get past the limits otherwise
+    if (shared_) {
+        shared_->Check();
+    }
+    current_scope = this;
+    budget_internal::countdown =
+        shared_ ? shared_->Take(kCheckInterval) : std::numeric_limits<uint64_t>::max();
+}
+
+BudgetScope::~BudgetScope() {
+    if (shared_) {
+        shared_->GiveBack(budget_internal::countdown);
+    }
+    current_scope = previous_;
+    budget_internal::countdown = previous_countdown_;
+}
+
+uint64_t BudgetScope::FuelLeft() const {
+    if (shared_ == nullptr) {
+        return Budget::kUnlimited;
+    }
+    // the part of the portion of this thread which is left is not in the shared fuel
+    uint64_t left = current_scope == this ? budget_internal::countdown : 0;
+    return shared_->Fuel() + left;
+}
+
+std::shared_ptr<SharedBudget> BudgetScope::Current() {
+    return current_scope ? current_scope->shared_ : nullptr;
+}
+
+void CheckBudget(uint64_t steps) {
+    auto* scope = current_scope;
+    if (scope == nullptr || scope->shared_ == nullptr) {
+        budget_internal::countdown = std::numeric_limits<uint64_t>::max();
+        return;
+    }
+    auto& shared = *scope->shared_;
+    auto& countdown = budget_internal::countdown;
+    shared.Check();
+    // the rest of the portion is not enough for the steps, the shared fuel makes up for it and
+    // gives the next portion
+    uint64_t missing = steps - countdown;
+    uint64_t wanted = std::min(missing, Budget::kUnlimited - BudgetScope::kCheckInterval);
+    uint64_t taken = shared.Take(wanted + BudgetScope::kCheckInterval);
+    if (taken < missing) {
+        countdown = 0;
+        shared.Stop(Interrupted::Reason::kOutOfFuel);
+    }
+    countdown = taken - missing;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+
+// Limits on an evaluation: fuel, the number of steps it may take, and a token another thread can
+// cancel it with. The steps are the applications of builtins and procedures and the steps of list
+// traversals, each of them a safe point where an evaluation which ran out of fuel or was
+// cancelled is ended with Interrupted. A step costs a decrement of a thread local counter: each
+// thread takes the fuel in portions of kCheckInterval steps and looks at the limits only when a
+// portion is used up, so a cancelled evaluation takes up to that many steps to end.
+//
+// The work an evaluation hands to the threads of a pool, by the parallel builtins and futures,
+// runs under its limits too: the tasks join them with the limits of the thread submitting them,
+// see BudgetScope::Current. Once one thread of the evaluation is interrupted, the others are at
+// their next check.
+
+class CancellationToken {
+public:
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+    bool IsCancelled() const {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> cancelled_ = false;
+};
+
+// The limits of one evaluation, none by default
+struct Budget {
+    static constexpr uint64_t kUnlimited = std::numeric_limits<uint64_t>::max();
+
+    Budget() = default;
+    Budget(uint64_t fuel, std::shared_ptr<const CancellationToken> token = nullptr)
+        : fuel(fuel), token(std::move(token)) {
+    }
+    explicit Budget(std::shared_ptr<const CancellationToken> token) : token(std::move(token)) {
+    }
+
+    uint64_t fuel = kUnlimited;
+    std::shared_ptr<const CancellationToken> token;
+};
+
+// The limits one evaluation is under, shared by the threads it runs on
+class SharedBudget;
+
+// Puts limits on the calling thread while it exists. Scopes nest: the one created last is in
+// force, the steps taken in it are not charged to the one it hides. Throws Interrupted if the
+// limits are over already.
+class BudgetScope {
+public:
+    static constexpr uint64_t kCheckInterval = 256;
+
+    // The limits of a new evaluation
+    explicit BudgetScope(const Budget& budget);
+    // Joins the limits of an evaluation running on other threads, none if shared is nullptr
+    explicit BudgetScope(std::shared_ptr<SharedBudget> shared);
+    BudgetScope(const BudgetScope&) = delete;
+    BudgetScope& operator=(const BudgetScope&) = delete;
+    // Gives the fuel the thread took and did not use back to the evaluation
+    ~BudgetScope();
+
+    // The steps the evaluation may still take, on all of its threads
+    uint64_t FuelLeft() const;
+
+    // The limits the calling thread is under, for the tasks it hands to other threads; nullptr
+    // if there are none
+    static std::shared_ptr<SharedBudget> Current();
+
+private:
+    friend void CheckBudget(uint64_t steps);
+
+    void Enter();
+
+    std::shared_ptr<SharedBudget> shared_;
+    BudgetScope* previous_;
+    uint64_t previous_countdown_;
+};
+
+namespace budget_internal {
+
+// The steps before the limits of the thread are looked at again
+inline thread_local uint64_t countdown = std::numeric_limits<uint64_t>::max();
+
+}  // namespace budget_internal
+
+// Charges the steps to the limits of the thread. Throws Interrupted when they are over.
+void CheckBudget(uint64_t steps);
+
+inline void SpendFuel(uint64_t steps = 1) {
+    auto& countdown = budget_internal::countdown;
+    if (countdown <= steps) {
+        CheckBudget(steps);
+    } else {
+        countdown -= steps;
+    }
+}
@@ -0,0 +1,533 @@
+#include "builtins.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "channel.h"
+#include "environment.h"
+#include "parallel.h"
+#include "typed_function.h"
+
+namespace {
+
+struct Add : TypedFunction<Add> {
+    static int64_t Run(Numbers args) {
+        int64_t sum = 0;
+        for (int64_t x : args) {
+            sum = CheckedAdd(sum, x);
+        }
+        return sum;
+    }
+    static int64_t RunBinary(int64_t a, int64_t b) {
+        return CheckedAdd(a, b);
+    }
+};
+
+struct Multiply : TypedFunction<Multiply> {
+    static int64_t Run(Numbers args) {
+        int64_t product = 1;
+        for (int64_t x : args) {
+            product = CheckedMul(product, x);
+        }
+        return product;
+    }
+    static int64_t RunBinary(int64_t a, int64_t b) {
+        return CheckedMul(a, b);
+    }
+};
+
+// - / max min: the first argument combined with each of the others, (- x) is x
+template <int64_t (*Op)(int64_t, int64_t)>
+struct LeftFold : TypedFunction<LeftFold<Op>> {
+    static int64_t Run(Numbers args) {
+        if (args.empty()) {
+            throw RuntimeError("no arguments");
+        }
+        int64_t res = args[0];
+        for (size_t i = 1; i < args.size(); ++i) {
+            res = Op(res, args[i]);
+        }
+        return res;
+    }
+    static int64_t RunBinary(int64_t a, int64_t b) {
+        return Op(a, b);
+    }
+};
+
+int64_t Max(int64_t a, int64_t b) {
+    return std::max(a, b);
+}
+
+int64_t Min(int64_t a, int64_t b) {
+    return std::min(a, b);
+}
+
+// The first argument is compared with each of the others, the rest is not looked at once one
+// comparison fails
+template <class Compare>
+struct Comparison : TypedFunction<Comparison<Compare>> {
+    static bool Run(Numbers args) {
+        if (args.empty()) {
+            return true;
+        }
+        int64_t first = args[0];
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (!Compare()(first, args[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    static bool RunBinary(int64_t a, int64_t b) {
+        return Compare()(a, b);
+    }
+};
+
+struct Abs : TypedFunction<Abs> {
+    static int64_t Run(int64_t x) {
+        return x < 0 ? CheckedSub(0, x) : x;
+    }
+};
+
+// number? boolean?: whether all the arguments are of the type
+template <class T>
+struct IsType : TypedFunction<IsType<T>> {
+    static bool Run(Args args) {
+        if (args.empty()) {
+            throw RuntimeError("no arguments");
+        }
+        for (const auto& arg : args) {
+            if (!Is<T>(arg)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct Not : TypedFunction<Not> {
+    static bool Run(const std::shared_ptr<Object>& arg) {
+        if (Is<Number>(arg)) {
+            return false;
+        }
+        if (auto boolean = As<Boolean>(arg)) {
+            return !boolean->GetValue();
+        }
+        if (auto quote = As<Quote>(arg)) {
+            return quote->GetObject() != nullptr;
+        }
+        throw RuntimeError("не те аргументы");
+    }
+};
+
+struct IsPair : TypedFunction<IsPair> {
+    static bool Run(const std::shared_ptr<Object>& arg) {
+        if (auto quote = As<Quote>(arg)) {
+            return quote->GetObject() != nullptr;
+        }
+        if (auto cell = As<Cell>(arg)) {
+            return cell->GetFirst() != nullptr;
+        }
+        return false;
+    }
+};
+
+// (null?) is #t
+struct IsNull : TypedFunction<IsNull> {
+    static bool Run(Args args) {
+        if (args.size() > 1) {
+            throw RuntimeError("no or too many arguments");
+        }
+        if (args.empty()) {
+            return true;
+        }
+        if (auto quote = As<Quote>(args[0])) {
+            return quote->GetObject() == nullptr;
+        }
+        if (auto cell = As<Cell>(args[0])) {
+            return cell->GetFirst() == nullptr;
+        }
+        return false;
+    }
+};
+
+struct IsList : TypedFunction<IsList> {
+    static bool Run(const std::shared_ptr<Object>& arg) {
+        auto list = Unquote(arg);
+        if (list == nullptr) {
+            return true;
+        }
+        auto cell = As<Cell>(list);
+        return cell != nullptr && cell->IsProperList();
+    }
+};
+
+struct Length : TypedFunction<Length> {
+    static int64_t Run(ListView list) {
+        if (!list.IsProper()) {
+            throw RuntimeError("length of not a list");
+        }
+        return list.Length();
+    }
+};
+
+// (cons a b c) is (cons a c)
+struct Cons : TypedFunction<Cons> {
+    static std::shared_ptr<Object> Run(Args args) {
+        if (args.empty()) {
+            throw RuntimeError("no or too many arguments");
+        }
+        return std::make_shared<Cell>(args.front(), args.size() > 1 ? args.back() : nullptr);
+    }
+};
+
+struct Car : TypedFunction<Car> {
+    static std::shared_ptr<Object> Run(std::shared_ptr<Cell> cell) {
+        return cell->GetFirst();
+    }
+};
+
+struct Cdr : TypedFunction<Cdr> {
+    static std::shared_ptr<Object> Run(std::shared_ptr<Cell> cell) {
+        return cell->GetSecond();
+    }
+};
+
+struct List : TypedFunction<List> {
+    static std::shared_ptr<Object> Run(Args args) {
+        // элементы неизменяемые, поэтому кладём их в список без копий
+        ListBuilder list;
+        for (const auto& arg : args) {
+            list.Add(arg);
+        }
+        return list.Build();
+    }
+};
+
+struct ListRef : TypedFunction<ListRef> {
+    static std::shared_ptr<Object> Run(ListView list, int64_t index) {
+        if (index < 0) {
+            throw RuntimeError("invalid index");
+        }
+        if (static_cast<size_t>(index) >= list.Length()) {
+            throw RuntimeError("index is out of range");
+        }
+        ListWalker walker(list.GetCell());
+        walker.Skip(index);
+        return walker.Head();
+    }
+};
+
+// (list-tail x 0) is x, whatever x is
+struct ListTail : TypedFunction<ListTail> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& list, int64_t index) {
+        if (index < 0) {
+            throw RuntimeError("invalid index");
+        }
+        if (index == 0) {
+            return list;
+        }
+        auto cell = As<Cell>(Unquote(list));
+        if (cell == nullptr || static_cast<size_t>(index) > cell->Length()) {
+            throw RuntimeError("index is out of range");
+        }
+        ListWalker walker(cell);
+        walker.Skip(index);
+        return walker.Rest();
+    }
+};
+
+// The parallel builtins split the list into ranges of at least kGrain elements and call the
+// function on them on the threads of SharedPool. The function must not depend on the order of
+// the calls; the results come in the order of the list all the same.
+constexpr size_t kGrain = 16;
+
+std::vector<std::shared_ptr<Object>> Elements(const ListView& list) {
+    if (!list.IsProper()) {
+        throw RuntimeError("argument 2 is not a list");
+    }
+    std::vector<std::shared_ptr<Object>> res;
+    res.reserve(list.Length());
+    for (ListWalker walker(list.GetCell()); walker.AtCell(); walker.Next()) {
+        res.push_back(walker.Head());
+    }
+    return res;
+}
+
+struct ParallelMap : TypedFunction<ParallelMap> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& func, ListView list) {
+        auto values = Elements(list);
+        ParallelFor(values.size(), kGrain, [&func, &values](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                values[i] = Invoke(func, Args(&values[i], 1));
+            }
+        });
+        ListBuilder res;
+        for (auto& value : values) {
+            res.Add(std::move(value));
+        }
+        return res.Build();
+    }
+};
+
+struct ParallelForEach : TypedFunction<ParallelForEach> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& func, ListView list) {
+        auto values = Elements(list);
+        ParallelFor(values.size(), kGrain, [&func, &values](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                Invoke(func, Args(&values[i], 1));
+            }
+        });
+        return nullptr;
+    }
+};
+
+bool IsAssociative(const std::shared_ptr<Object>& func) {
+    for (auto name : {"+", "*", "max", "min"}) {
+        if (func == FindBuiltin(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// (parallel-reduce f init list) is (f (f (f init x1) x2) x3). Only the associative builtins are
+// run in parallel: each range is folded on its own, then the results are combined pairwise, as a
+// tree. Other functions are folded from the left on the calling thread.
+struct ParallelReduce : TypedFunction<ParallelReduce> {
+    static std::shared_ptr<Object> Run(Args args) {
+        if (args.size() != 3) {
+            throw RuntimeError("no or too many arguments");
+        }
+        const auto& func = args[0];
+        auto values = Elements(UnboxArg<ListView>(args[2], 2));
+        if (!IsAssociative(func)) {
+            auto res = args[1];
+            for (const auto& value : values) {
+                const std::shared_ptr<Object> call[] = {res, value};
+                res = Invoke(func, call);
+            }
+            return res;
+        }
+        if (values.empty()) {
+            return args[1];
+        }
+        // a range leaves its result in its first element
+        std::vector<uint8_t> is_head(values.size());
+        ParallelFor(values.size(), kGrain, [&](size_t begin, size_t end) {
+            for (size_t i = begin + 1; i < end; ++i) {
+                values[begin] = func->ApplyBinary(values[begin], values[i]);
+            }
+            is_head[begin] = true;
+        });
+        std::vector<size_t> heads;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (is_head[i]) {
+                heads.push_back(i);
+            }
+        }
+        for (size_t step = 1; step < heads.size(); step *= 2) {
+            for (size_t i = 0; i + step < heads.size(); i += 2 * step) {
+                auto& lhs = values[heads[i]];
+                lhs = func->ApplyBinary(lhs, values[heads[i + step]]);
+            }
+        }
+        return func->ApplyBinary(args[1], values.front());
+    }
+};
+
+// (future expr) is (spawn (lambda () expr))
+struct Spawn : TypedFunction<Spawn> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& thunk) {
+        return Future::Spawn(thunk);
+    }
+};
+
+// (touch x) is x for the values which are not futures
+struct Touch : TypedFunction<Touch> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& value) {
+        if (auto future = As<Future>(value)) {
+            return future->Touch();
+        }
+        return value;
+    }
+};
+
+template <Channel::Kind kKind>
+struct MakeChannel : TypedFunction<MakeChannel<kKind>> {
+    static std::shared_ptr<Object> Run(int64_t capacity) {
+        if (capacity <= 0) {
+            throw RuntimeError("invalid channel capacity");
+        }
+        return std::make_shared<Channel>(kKind, capacity);
+    }
+};
+
+std::shared_ptr<Channel> GetChannel(const std::shared_ptr<Object>& obj) {
+    auto channel = As<Channel>(obj);
+    if (channel == nullptr) {
+        ThrowWrongType(0, "a channel");
+    }
+    return channel;
+}
+
+// Waits while the channel is full
+struct ChannelSend : TypedFunction<ChannelSend> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& channel,
+                                       const std::shared_ptr<Object>& value) {
+        GetChannel(channel)->Send(value);
+        return nullptr;
+    }
+};
+
+// Waits while the channel is empty
+struct ChannelReceive : TypedFunction<ChannelReceive> {
+    static std::shared_ptr<Object> Run(const std::shared_ptr<Object>& channel) {
+        return GetChannel(channel)->Receive();
+    }
+};
+
+struct BuiltinInfo {
+    std::string_view name;
+    std::shared_ptr<Object> (*make)();
+    // no effects besides the result
+    bool pure = true;
+};
+
+template <class F>
+std::shared_ptr<Object> Make() {
+    return std::make_shared<F>();
+}
+
+constexpr BuiltinInfo kBuiltins[] = {
+    {"+", Make<Add>},
+    {"-", Make<LeftFold<CheckedSub>>},
+    {"*", Make<Multiply>},
+    {"/", Make<LeftFold<CheckedDiv>>},
+    {"max", Make<LeftFold<Max>>},
+    {"min", Make<LeftFold<Min>>},
+    {"abs", Make<Abs>},
+    {"<", Make<Comparison<std::less<>>>},
+    {"<=", Make<Comparison<std::less_equal<>>>},
+    {">", Make<Comparison<std::greater<>>>},
+    {">=", Make<Comparison<std::greater_equal<>>>},
+    {"number?", Make<IsType<Number>>},
+    {"=", Make<Comparison<std::equal_to<>>>},
+    {"boolean?", Make<IsType<Boolean>>},
+    {"not", Make<Not>},
+    {"pair?", Make<IsPair>},
+    {"null?", Make<IsNull>},
+    {"list?", Make<IsList>},
+    {"cons", Make<Cons>},
+    {"car", Make<Car>},
+    {"cdr", Make<Cdr>},
+    {"list", Make<List>},
+    {"list-ref", Make<ListRef>},
+    {"list-tail", Make<ListTail>},
+    {"length", Make<Length>},
+    {"parallel-map", Make<ParallelMap>, false},
+    {"parallel-for-each", Make<ParallelForEach>, false},
+    {"parallel-reduce", Make<ParallelReduce>, false},
+    {"spawn", Make<Spawn>, false},
+    {"touch", Make<Touch>, false},
+    {"make-channel", Make<MakeChannel<Channel::Kind::kMpmc>>, false},
+    {"make-spsc-channel", Make<MakeChannel<Channel::Kind::kSpsc>>, false},
+    {"channel-send", Make<ChannelSend>, false},
+    {"channel-receive", Make<ChannelReceive>, false},
+};
+
+constexpr size_t kCount = std::size(kBuiltins);
+constexpr size_t kTableSize = 128;
+static_assert(kCount < kTableSize);
+
+// FNV-1a с солью и перемешиванием в конце (младшие биты FNV от соли почти не зависят),
+// соль подбирается так, чтобы у всех имён были разные слоты
+constexpr uint32_t Hash(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    hash ^= seed;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+constexpr bool IsPerfect(uint32_t seed) {
+    std::array<bool, kTableSize> used{};
+    for (const auto& builtin : kBuiltins) {
+        auto slot = Hash(builtin.name, seed) % kTableSize;
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t FindSeed() {
+    uint32_t seed = 0;
+    while (!IsPerfect(seed)) {
+        ++seed;
+    }
+    return seed;
+}
+
+constexpr uint32_t kSeed = FindSeed();
+
+// slot -> index in kBuiltins, kCount for empty slots
+constexpr std::array<uint8_t, kTableSize> MakeSlots() {
+    std::array<uint8_t, kTableSize> slots{};
+    slots.fill(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        slots[Hash(kBuiltins[i].name, kSeed) % kTableSize] = i;
+    }
+    return slots;
+}
+
+constexpr auto kSlots = MakeSlots();
+
+// builtins have no state, so one instance of each serves everybody;
+// the extra last element is the nullptr returned for unknown names
+using Instances = std::array<std::shared_ptr<Object>, kCount + 1>;
+
+const Instances& GetInstances() {
+    static const Instances kInstances = [] {
+        Instances res;
+        for (size_t i = 0; i < kCount; ++i) {
+            res[i] = kBuiltins[i].make();
+        }
+        return res;
+    }();
+    return kInstances;
+}
+
+}  // namespace
+
+const std::shared_ptr<Object>& FindBuiltin(std::string_view name) {
+    size_t index = kSlots[Hash(name, kSeed) % kTableSize];
+    if (index < kCount && kBuiltins[index].name != name) {
+        index = kCount;
+    }
+    return GetInstances()[index];
+}
+
+std::vector<std::string_view> BuiltinNames() {
+    std::vector<std::string_view> res;
+    for (const auto& builtin : kBuiltins) {
+        res.push_back(builtin.name);
+    }
+    return res;
+}
+
+bool IsPureBuiltin(std::string_view name) {
+    size_t index = kSlots[Hash(name, kSeed) % kTableSize];
+    return index < kCount && kBuiltins[index].name == name && kBuiltins[index].pure;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+// Builtin functions live in one immutable table shared by all interpreters. The table is indexed
+// by a perfect hash of the name computed at compile time, so a lookup is one hash, one string
+// compare and no allocation, whether the name is known or not.
+
+// Returns the builtin called name, or nullptr if there is none.
+const std::shared_ptr<Object>& FindBuiltin(std::string_view name);
+
+// The names of all builtins, in the order of the table
+std::vector<std::string_view> BuiltinNames();
+
+// Pure builtins have no effects besides their result, so a call with constant arguments can be
+// evaluated once, ahead of time. False for unknown names.
+bool IsPureBuiltin(std::string_view name);
@@ -0,0 +1,79 @@
+#include "channel.h"
+
+#include <new>
+#include <thread>
+
+#include "budget.h"
+
+namespace {
+
+// A waiting thread spins for a while, a peer on another core is likely to be done soon, then
+// gives its core away between the attempts. Each of those is a step of the budget, so a wait
+// can be cancelled or run out of fuel.
+constexpr int kSpins = 64;
+
+template <class Attempt>
+void WaitFor(Attempt attempt) {
+    for (int i = 0; !attempt(); ++i) {
+        if (i >= kSpins) {
+            SpendFuel();
+            std::this_thread::yield();
+        }
+    }
+}
+
+}  // namespace
+
+Channel::Channel(Kind kind, size_t capacity) : kind_(kind) {
+    if (capacity == 0 || capacity > kMaxCapacity) {
+        throw RuntimeError("invalid channel capacity");
+    }
+    try {
+        if (kind == Kind::kSpsc) {
+            spsc_ = std::make_unique<SpscRing<std::shared_ptr<Object>>>(capacity);
+        } else {
+            mpmc_ = std::make_unique<MpmcRing<std::shared_ptr<Object>>>(capacity);
+        }
+    } catch (const std::bad_alloc&) {
+        throw RuntimeError("no memory for the channel");
+    }
+}
+
+size_t Channel::Capacity() const {
+    return spsc_ ? spsc_->Capacity() : mpmc_->Capacity();
+}
+
+template <class Attempt>
+bool Channel::Exclusive(std::atomic<bool>* busy, const char* role, Attempt attempt) {
+    if (busy->exchange(true, std::memory_order_acquire)) {
+        throw RuntimeError(std::string("spsc channel has another ") + role);
+    }
+    bool res = attempt();
+    busy->store(false, std::memory_order_release);
+    return res;
+}
+
+bool Channel::TrySend(std::shared_ptr<Object>&& value) {
+    if (spsc_) {
+        return Exclusive(&sending_, "sender",
+                         [this, &value] { return spsc_->TryPush(std::move(value)); });
+    }
+    return mpmc_->TryPush(std::move(value));
+}
+
+bool Channel::TryReceive(std::shared_ptr<Object>* value) {
+    if (spsc_) {
+        return Exclusive(&receiving_, "receiver", [this, value] { return spsc_->TryPop(value); });
+    }
+    return mpmc_->TryPop(value);
+}
+
+void Channel::Send(std::shared_ptr<Object> value) {
+    WaitFor([this, &value] { return TrySend(std::move(value)); });
+}
+
+std::shared_ptr<Object> Channel::Receive() {
+    std::shared_ptr<Object> value;
+    WaitFor([this, &value] { return TryReceive(&value); });
+    return value;
+}
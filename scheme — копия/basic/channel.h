@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "object.h"
+
+// Bounded lock-free queues. The capacity is rounded up to a power of two, an index is masked
+// into the buffer instead of being divided. The indexes written by different threads are on
+// different cache lines.
+inline constexpr size_t kCacheLine = 64;
+
+inline size_t RingCapacity(size_t capacity) {
+    size_t res = 1;
+    while (res < capacity) {
+        res *= 2;
+    }
+    return res;
+}
+
+// One thread pushes and one thread pops. Each of them keeps a copy of the index of the other
+// and reads the shared one only when the copy says the queue is full or empty.
+template <class T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : mask_(RingCapacity(capacity) - 1), items_(new T[mask_ + 1]) {
+    }
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    // False if the queue is full, value is left alone then
+    bool TryPush(T&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_copy_ > mask_) {
+            head_copy_ = head_.load(std::memory_order_acquire);
+            if (tail - head_copy_ > mask_) {
+                return false;
+            }
+        }
+        items_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // False if the queue is empty
+    bool TryPop(T* value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_copy_) {
+            tail_copy_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_copy_) {
+                return false;
+            }
+        }
+        *value = std::move(items_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t mask_;
+    const std::unique_ptr<T[]> items_;
+    // the producer's
+    alignas(kCacheLine) std::atomic<size_t> tail_ = 0;
+    size_t head_copy_ = 0;
+    // the consumer's
+    alignas(kCacheLine) std::atomic<size_t> head_ = 0;
+    size_t tail_copy_ = 0;
+};
+
+// Any number of threads push and pop. Every slot has a sequence number which tells whose turn
+// it is: a producer claims position pos when the slot's number is pos, a consumer when it is
+// pos + 1, and the number moves on by the capacity each round.
+template <class T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity)
+        : mask_(RingCapacity(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    bool TryPush(T&& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T* value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    *value = std::move(slot.value);
+                    slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct alignas(kCacheLine) Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask_;
+    const std::unique_ptr<Slot[]> slots_;
+    alignas(kCacheLine) std::atomic<size_t> tail_ = 0;
+    alignas(kCacheLine) std::atomic<size_t> head_ = 0;
+};
+
+// A queue of values between threads, usually between the interpreters of different threads, see
+// Interpreter::Define. Values are immutable, so a value sent is the same object the receiver
+// gets, nothing is copied or printed; a big one is best frozen, see FrozenSegment. A frozen
+// value is sent without its segment: the receivers may use it only while the sender keeps the
+// segment, as the interpreter a constant is defined in does. An SPSC channel has one sender and
+// one receiver at a time, on any thread: an evaluation may be resumed or run by a pool on another
+// one. A send while another one runs gets RuntimeError, and so does a receive.
+class Channel : public Object {
+public:
+    enum class Kind { kSpsc, kMpmc };
+
+    // A slot of an MPMC channel takes a cache line, so this is up to 4 MiB
+    static constexpr size_t kMaxCapacity = size_t(1) << 16;
+
+    // Throws RuntimeError for a capacity of 0 or above kMaxCapacity, or if there is no memory for
+    // it
+    Channel(Kind kind, size_t capacity);
+
+    Kind GetKind() const {
+        return kind_;
+    }
+    size_t Capacity() const;
+
+    // False if the channel is full or empty. A value which was not sent is left alone.
+    bool TrySend(std::shared_ptr<Object>&& value);
+    bool TryReceive(std::shared_ptr<Object>* value);
+    // Wait while the channel is full or empty
+    void Send(std::shared_ptr<Object> value);
+    std::shared_ptr<Object> Receive();
+
+    std::string Cerealize() override {
+        throw SyntaxError("can't cerealize channel");
+    }
+    std::shared_ptr<Object> Clone() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Calculate() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Apply(Args) override {
+        throw SyntaxError("can not apply");
+    }
+
+private:
+    // Runs attempt on a side of the SPSC ring, busy is set meanwhile. The flag also orders the
+    // operations of a side which moved to another thread.
+    template <class Attempt>
+    bool Exclusive(std::atomic<bool>* busy, const char* role, Attempt attempt);
+
+    Kind kind_;
+    std::unique_ptr<SpscRing<std::shared_ptr<Object>>> spsc_;
+    std::unique_ptr<MpmcRing<std::shared_ptr<Object>>> mpmc_;
+    std::atomic<bool> sending_ = false;
+    std::atomic<bool> receiving_ = false;
+};
@@ -0,0 +1,947 @@
+#include "compiler.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "builtins.h"
+#include "jit.h"
+#include "parallel.h"
+#include "special_forms.h"
+
+namespace {
+
+// Arguments are evaluated into a buffer on the stack, calls with up to kInlineArgs of them
+// allocate nothing. call gets them as Args.
+constexpr size_t kInlineArgs = 8;
+
+template <class F>
+std::shared_ptr<Object> WithArgs(const std::vector<std::shared_ptr<Node>>& nodes, Frame* frame,
+                                 F call) {
+    if (nodes.size() > kInlineArgs) {
+        std::vector<std::shared_ptr<Object>> args;
+        args.reserve(nodes.size());
+        for (const auto& node : nodes) {
+            args.push_back(node->Run(frame));
+        }
+        return call(Args(args));
+    }
+    std::shared_ptr<Object> args[kInlineArgs];
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        args[i] = nodes[i]->Run(frame);
+    }
+    return call(Args(args, nodes.size()));
+}
+
+// Literals and everything else which evaluates to itself
+class ConstantNode : public Node {
+public:
+    explicit ConstantNode(std::shared_ptr<Object> value) : value_(std::move(value)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame*) override {
+        return value_;
+    }
+
+private:
+    std::shared_ptr<Object> value_;
+};
+
+// Expressions which can not be evaluated fail when executed, not when compiled
+class ErrorNode : public Node {
+public:
+    explicit ErrorNode(std::string message) : message_(std::move(message)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame*) override {
+        throw RuntimeError(message_);
+    }
+
+private:
+    std::string message_;
+};
+
+class CallNode : public Node {
+public:
+    CallNode(std::shared_ptr<Object> functor, std::vector<std::shared_ptr<Node>> args)
+        : functor_(std::move(functor)), args_(std::move(args)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        return WithArgs(args_, frame, [this](Args args) { return functor_->Apply(args); });
+    }
+
+private:
+    std::shared_ptr<Object> functor_;
+    std::vector<std::shared_ptr<Node>> args_;
+};
+
+class UnaryCallNode : public Node {
+public:
+    UnaryCallNode(std::shared_ptr<Object> functor, std::shared_ptr<Node> arg)
+        : functor_(std::move(functor)), arg_(std::move(arg)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        return functor_->ApplyUnary(arg_->Run(frame));
+    }
+
+private:
+    std::shared_ptr<Object> functor_;
+    std::shared_ptr<Node> arg_;
+};
+
+class BinaryCallNode : public Node {
+public:
+    BinaryCallNode(std::shared_ptr<Object> functor, std::shared_ptr<Node> lhs,
+                   std::shared_ptr<Node> rhs)
+        : functor_(std::move(functor)), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        auto lhs = lhs_->Run(frame);
+        return functor_->ApplyBinary(lhs, rhs_->Run(frame));
+    }
+
+private:
+    std::shared_ptr<Object> functor_;
+    std::shared_ptr<Node> lhs_;
+    std::shared_ptr<Node> rhs_;
+};
+
+// A call of a pure builtin with expensive arguments made of pure builtins only. The arguments are
+// evaluated on the threads of SharedPool; they only read variables, so they can share the frame.
+// The error of the first argument which fails is raised, as if they were evaluated in order.
+class ParallelCallNode : public Node {
+public:
+    ParallelCallNode(std::shared_ptr<Object> functor, std::vector<std::shared_ptr<Node>> args)
+        : functor_(std::move(functor)), args_(std::move(args)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        std::vector<std::shared_ptr<Object>> values(args_.size());
+        ParallelFor(args_.size(), 1, [this, frame, &values](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                values[i] = args_[i]->Run(frame);
+            }
+        });
+        return functor_->Apply(values);
+    }
+
+private:
+    std::shared_ptr<Object> functor_;
+    std::vector<std::shared_ptr<Node>> args_;
+};
+
+// A call in tail position does not call a procedure of this engine, it leaves the callee and
+// the arguments here and returns TailCallMarker(). The procedure it is a part of returns then,
+// and TreeProcedure::Call makes the call in its place.
+struct TailCall {
+    std::shared_ptr<Object> callee;
+    std::vector<std::shared_ptr<Object>> args;
+    // the call is the last operand of an and, of an or: its value is checked as theirs when it
+    // returns. The checks of and and or change different values, so any number of them is these
+    // two.
+    bool stops_and = false;
+    bool stops_or = false;
+};
+
+TailCall* PendingTailCall() {
+    thread_local TailCall pending;
+    return &pending;
+}
+
+const std::shared_ptr<Object>& TailCallMarker() {
+    static const std::shared_ptr<Object> kMarker = std::make_shared<Symbol>("tail call");
+    return kMarker;
+}
+
+// and, or: evaluates the operands until one decides the result
+class ShortCircuitNode : public Node {
+public:
+    ShortCircuitNode(bool is_and, std::vector<std::shared_ptr<Node>> operands)
+        : is_and_(is_and), operands_(std::move(operands)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        std::shared_ptr<Object> value = MakeBool(is_and_);
+        for (const auto& operand : operands_) {
+            value = operand->Run(frame);
+            if (value == TailCallMarker()) {
+                // the last operand in tail position
+                auto* pending = PendingTailCall();
+                (is_and_ ? pending->stops_and : pending->stops_or) = true;
+                return value;
+            }
+            if (is_and_ ? StopsAnd(value) : StopsOr(value)) {
+                return MakeBool(!is_and_);
+            }
+        }
+        return value;
+    }
+
+private:
+    bool is_and_;
+    std::vector<std::shared_ptr<Node>> operands_;
+};
+
+// if, cond, when
+class CondNode : public Node {
+public:
+    struct Clause {
+        std::shared_ptr<Node> test;  // nullptr for else
+        std::vector<std::shared_ptr<Node>> body;
+    };
+
+    explicit CondNode(std::vector<Clause> clauses) : clauses_(std::move(clauses)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        for (const auto& clause : clauses_) {
+            std::shared_ptr<Object> value;
+            if (clause.test != nullptr) {
+                value = clause.test->Run(frame);
+                if (!IsTrue(value)) {
+                    continue;
+                }
+            }
+            for (const auto& expression : clause.body) {
+                value = expression->Run(frame);
+            }
+            return value;
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<Clause> clauses_;
+};
+
+class LocalNode : public Node {
+public:
+    LocalNode(uint32_t slot, std::string name) : slot_(slot), name_(std::move(name)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        const auto& value = frame->slots[slot_];
+        if (value == Unbound()) {
+            ThrowUnbound(name_);
+        }
+        return value;
+    }
+
+private:
+    uint32_t slot_;
+    std::string name_;
+};
+
+class CapturedNode : public Node {
+public:
+    CapturedNode(uint32_t index, std::string name) : index_(index), name_(std::move(name)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        const auto& value = frame->closure->Captured(index_);
+        if (value == Unbound()) {
+            ThrowUnbound(name_);
+        }
+        return value;
+    }
+
+private:
+    uint32_t index_;
+    std::string name_;
+};
+
+class SelfNode : public Node {
+public:
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        return frame->closure->shared_from_this();
+    }
+};
+
+class SiblingNode : public Node {
+public:
+    SiblingNode(uint32_t index, std::string name) : index_(index), name_(std::move(name)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        auto value = frame->closure->Group()->Get(index_);
+        if (value == Unbound()) {
+            ThrowUnbound(name_);
+        }
+        return value;
+    }
+
+private:
+    uint32_t index_;
+    std::string name_;
+};
+
+class GlobalNode : public Node {
+public:
+    explicit GlobalNode(std::shared_ptr<Global> global) : global_(std::move(global)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame*) override {
+        auto value = global_->Load();
+        if (value == Unbound()) {
+            ThrowUnbound(global_->name);
+        }
+        return value;
+    }
+
+private:
+    std::shared_ptr<Global> global_;
+};
+
+std::shared_ptr<Node> MakeVariableNode(const VariableRef& ref, const std::string& name) {
+    switch (ref.kind) {
+        case VariableRef::kLocal:
+            return std::make_shared<LocalNode>(ref.index, name);
+        case VariableRef::kCaptured:
+            return std::make_shared<CapturedNode>(ref.index, name);
+        case VariableRef::kSelf:
+            return std::make_shared<SelfNode>();
+        case VariableRef::kSibling:
+            return std::make_shared<SiblingNode>(ref.index, name);
+    }
+    return nullptr;
+}
+
+// The slots of a frame, on the stack when there are few of them
+class Slots {
+public:
+    static constexpr size_t kInline = 8;
+
+    explicit Slots(size_t size) {
+        if (size > kInline) {
+            heap_.resize(size);
+        }
+    }
+
+    std::shared_ptr<Object>* Data() {
+        return heap_.empty() ? inline_ : heap_.data();
+    }
+
+private:
+    std::shared_ptr<Object> inline_[kInline];
+    std::vector<std::shared_ptr<Object>> heap_;
+};
+
+// The top-level expressions which have variables get a frame here
+class FrameNode : public Node {
+public:
+    FrameNode(uint32_t size, std::shared_ptr<Node> body) : size_(size), body_(std::move(body)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame*) override {
+        Slots slots(size_);
+        Frame frame{slots.Data(), nullptr};
+        return body_->Run(&frame);
+    }
+
+private:
+    uint32_t size_;
+    std::shared_ptr<Node> body_;
+};
+
+// Procedures of this engine recurse on the C++ stack, a call throws RuntimeError when less than
+// this much of it is left rather than overflow it. Sanitized builds take several times more of
+// the stack per call, so the limit is on the stack, not on the number of calls.
+constexpr size_t kStackReserve = 256 << 10;
+
+// The lowest address the calls of the thread may use
+uintptr_t StackLimit() {
+    thread_local uintptr_t limit = [] {
+        pthread_attr_t attr;
+        void* low = nullptr;
+        size_t size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            pthread_attr_getstack(&attr, &low, &size);
+            pthread_attr_destroy(&attr);
+        }
+        return low ? reinterpret_cast<uintptr_t>(low) + kStackReserve : 0;
+    }();
+    return limit;
+}
+
+}  // namespace
+
+void CheckStack() {
+    char here;
+    if (reinterpret_cast<uintptr_t>(&here) < StackLimit()) {
+        throw RuntimeError("recursion is too deep");
+    }
+}
+
+namespace {
+
+class TreeProcedure : public ProcedureCode {
+public:
+    TreeProcedure(uint32_t params, bool variadic, uint32_t frame_size, std::shared_ptr<Node> body)
+        : ProcedureCode(params, variadic, frame_size), body_(std::move(body)) {
+    }
+
+    std::shared_ptr<Object> Call(Closure* closure, Args args) override {
+        CheckStack();
+        TreeProcedure* procedure = this;
+        // the closure and the arguments of the tail call being made
+        std::shared_ptr<Object> callee;
+        std::vector<std::shared_ptr<Object>> tail_args;
+        bool stops_and = false;
+        bool stops_or = false;
+        while (true) {
+            Slots slots(procedure->FrameSize());
+            procedure->Bind(args, slots.Data());
+            Frame frame{slots.Data(), closure};
+            auto res = procedure->body_->Run(&frame);
+            if (res != TailCallMarker()) {
+                if (stops_and && StopsAnd(res)) {
+                    return MakeBool(false);
+                }
+                if (stops_or && StopsOr(res)) {
+                    return MakeBool(true);
+                }
+                return res;
+            }
+            auto* pending = PendingTailCall();
+            stops_and |= std::exchange(pending->stops_and, false);
+            stops_or |= std::exchange(pending->stops_or, false);
+            callee = std::move(pending->callee);
+            tail_args.swap(pending->args);
+            pending->args.clear();
+            closure = static_cast<Closure*>(callee.get());
+            procedure = static_cast<TreeProcedure*>(closure->GetCode());
+            args = tail_args;
+        }
+    }
+
+private:
+    std::shared_ptr<Node> body_;
+};
+
+bool IsTreeProcedure(const std::shared_ptr<Object>& obj) {
+    auto closure = dynamic_cast<Closure*>(obj.get());
+    return closure != nullptr && dynamic_cast<TreeProcedure*>(closure->GetCode()) != nullptr;
+}
+
+class LambdaNode : public Node {
+public:
+    LambdaNode(std::shared_ptr<TreeProcedure> code, std::vector<std::shared_ptr<Node>> captures,
+               std::optional<GroupMember> member)
+        : code_(std::move(code)), captures_(std::move(captures)), member_(member) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        std::vector<std::shared_ptr<Object>> captured;
+        captured.reserve(captures_.size());
+        for (const auto& capture : captures_) {
+            captured.push_back(capture->Run(frame));
+        }
+        if (member_) {
+            auto* group = static_cast<ProcedureGroup*>(frame->slots[member_->group].get());
+            return group->Define(member_->index, code_, std::move(captured));
+        }
+        return std::make_shared<Closure>(code_, std::move(captured));
+    }
+
+private:
+    std::shared_ptr<TreeProcedure> code_;
+    std::vector<std::shared_ptr<Node>> captures_;
+    std::optional<GroupMember> member_;
+};
+
+// Calls of anything but a builtin known at compile time
+class ApplyNode : public Node {
+public:
+    ApplyNode(std::shared_ptr<Node> callee, std::vector<std::shared_ptr<Node>> args, bool tail)
+        : callee_(std::move(callee)), args_(std::move(args)), tail_(tail) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        auto callee = callee_->Run(frame);
+        return WithArgs(args_, frame, [this, &callee](Args args) {
+            if (tail_ && IsTreeProcedure(callee)) {
+                auto* pending = PendingTailCall();
+                pending->callee = std::move(callee);
+                pending->args.assign(args.begin(), args.end());
+                return TailCallMarker();
+            }
+            return Invoke(callee, args);
+        });
+    }
+
+private:
+    std::shared_ptr<Node> callee_;
+    std::vector<std::shared_ptr<Node>> args_;
+    bool tail_;
+};
+
+class LetNode : public Node {
+public:
+    LetNode(uint32_t first_slot, std::vector<std::shared_ptr<Node>> values,
+            std::shared_ptr<Node> body)
+        : first_slot_(first_slot), values_(std::move(values)), body_(std::move(body)) {
+    }
+
+    // the values may use the slots of the variables for their own lets, so they are stored
+    // after all of them are evaluated
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        WithArgs(values_, frame, [this, frame](Args values) {
+            std::copy(values.begin(), values.end(), frame->slots + first_slot_);
+            return nullptr;
+        });
+        return body_->Run(frame);
+    }
+
+private:
+    uint32_t first_slot_;
+    std::vector<std::shared_ptr<Node>> values_;
+    std::shared_ptr<Node> body_;
+};
+
+// The variables defined in a body are unbound until their definitions are executed
+class BodyNode : public Node {
+public:
+    // The definitions in the group of the body, see BodyGroup, get their ProcedureGroup in slot
+    // group, if there are more than one of them
+    BodyNode(std::vector<uint32_t> defined, int64_t group, uint32_t members,
+             std::vector<std::shared_ptr<Node>> expressions)
+        : defined_(std::move(defined)),
+          group_(group),
+          members_(members),
+          expressions_(std::move(expressions)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        for (uint32_t slot : defined_) {
+            frame->slots[slot] = Unbound();
+        }
+        if (group_ >= 0) {
+            frame->slots[group_] = std::make_shared<ProcedureGroup>(members_);
+        }
+        for (size_t i = 0; i + 1 < expressions_.size(); ++i) {
+            expressions_[i]->Run(frame);
+        }
+        return expressions_.back()->Run(frame);
+    }
+
+private:
+    std::vector<uint32_t> defined_;
+    int64_t group_;
+    uint32_t members_;
+    std::vector<std::shared_ptr<Node>> expressions_;
+};
+
+// A variable of the group of the body is set in the group as well, for the procedures
+class DefineLocalNode : public Node {
+public:
+    DefineLocalNode(uint32_t slot, std::shared_ptr<Node> value,
+                    std::optional<GroupMember> member = std::nullopt)
+        : slot_(slot), value_(std::move(value)), member_(member) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        auto value = value_->Run(frame);
+        if (member_) {
+            auto* group = static_cast<ProcedureGroup*>(frame->slots[member_->group].get());
+            group->Set(member_->index, value);
+        }
+        frame->slots[slot_] = std::move(value);
+        return nullptr;
+    }
+
+private:
+    uint32_t slot_;
+    std::shared_ptr<Node> value_;
+    std::optional<GroupMember> member_;
+};
+
+class DefineGlobalNode : public Node {
+public:
+    DefineGlobalNode(std::shared_ptr<Global> global, std::shared_ptr<Node> value)
+        : global_(std::move(global)), value_(std::move(value)) {
+    }
+
+    std::shared_ptr<Object> Run(Frame* frame) override {
+        global_->Store(value_->Run(frame));
+        return nullptr;
+    }
+
+private:
+    std::shared_ptr<Global> global_;
+    std::shared_ptr<Node> value_;
+};
+
+}  // namespace
+
+std::shared_ptr<Node> Compiler::Compile(const std::shared_ptr<Object>& obj) {
+    if (obj == nullptr) {
+        return std::make_shared<ErrorNode>("can not calculate");
+    }
+    Scope scope(nullptr, "");
+    std::shared_ptr<Node> node;
+    std::string name;
+    costs_.clear();
+    if (FindDefinition(obj, &name)) {
+        auto syntax = ParseSpecialForm(SpecialForm::kDefine, As<Cell>(obj)->GetSecond());
+        const auto& global = globals_->Define(name);
+        auto value = syntax.lambda ? CompileLambda(*syntax.lambda, "", &scope)
+                                   : CompileOperand(syntax.operands[0], &scope);
+        node = std::make_shared<DefineGlobalNode>(global, std::move(value));
+    } else {
+        node = CompileOperand(obj, &scope);
+    }
+    if (scope.FrameSize() > 0) {
+        return std::make_shared<FrameNode>(scope.FrameSize(), std::move(node));
+    }
+    return node;
+}
+
+void Compiler::EnableJit(uint32_t threshold) {
+    jit_ = JitAvailable();
+    jit_threshold_ = threshold;
+}
+
+void Compiler::EnableParallelArguments(size_t threshold) {
+    parallel_threshold_ = threshold;
+}
+
+std::shared_ptr<Node> Compiler::CompileCall(const std::shared_ptr<Cell>& cell, Scope* scope,
+                                            bool tail) {
+    auto first = cell->GetFirst();
+    if (auto symbol = As<Symbol>(first)) {
+        SpecialForm form;
+        if (FindSpecialForm(symbol->GetName(), &form)) {
+            return CompileSpecialForm(form, cell, scope, tail);
+        }
+        VariableRef ref;
+        bool is_variable = scope->Resolve(symbol->GetName(), &ref);
+        const auto& functor = FindBuiltin(symbol->GetName());
+        if (!is_variable && functor != nullptr) {
+            if (parallel_threshold_ > 0 && IsPureBuiltin(symbol->GetName())) {
+                if (auto node = CompileParallel(cell, functor, scope)) {
+                    return node;
+                }
+            }
+            if (jit_) {
+                if (auto node = CompileNumeric(cell, scope)) {
+                    return node;
+                }
+            }
+            std::vector<std::shared_ptr<Node>> args;
+            for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next()) {
+                args.push_back(CompileOperand(it.Head(), scope));
+            }
+            if (args.size() == 1) {
+                return std::make_shared<UnaryCallNode>(functor, std::move(args[0]));
+            }
+            if (args.size() == 2) {
+                return std::make_shared<BinaryCallNode>(functor, std::move(args[0]),
+                                                        std::move(args[1]));
+            }
+            return std::make_shared<CallNode>(functor, std::move(args));
+        }
+    } else if (Is<Quote>(first)) {
+        if (cell->GetSecond() != nullptr) {
+            return std::make_shared<ErrorNode>("quote takes one argument");
+        }
+        return std::make_shared<ConstantNode>(first);
+    } else if (!Is<Cell>(first)) {
+        return std::make_shared<ErrorNode>("can not apply");
+    }
+    auto callee = CompileOperand(first, scope);
+    std::vector<std::shared_ptr<Node>> args;
+    for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next()) {
+        args.push_back(CompileOperand(it.Head(), scope));
+    }
+    return std::make_shared<ApplyNode>(std::move(callee), std::move(args), tail);
+}
+
+// вложенные списки вычисляются, символы это переменные, остальное вычисляется в себя
+std::shared_ptr<Node> Compiler::CompileOperand(const std::shared_ptr<Object>& obj, Scope* scope,
+                                               bool tail) {
+    if (auto cell = As<Cell>(obj)) {
+        return CompileCall(cell, scope, tail);
+    }
+    if (auto symbol = As<Symbol>(obj)) {
+        return CompileVariable(symbol->GetName(), scope);
+    }
+    return std::make_shared<ConstantNode>(obj);
+}
+
+std::shared_ptr<Node> Compiler::CompileVariable(const std::string& name, Scope* scope) {
+    VariableRef ref;
+    if (scope->Resolve(name, &ref)) {
+        return MakeVariableNode(ref, name);
+    }
+    if (const auto& builtin = FindBuiltin(name)) {
+        return std::make_shared<ConstantNode>(builtin);
+    }
+    return std::make_shared<GlobalNode>(globals_->Find(name));
+}
+
+std::shared_ptr<Node> Compiler::CompileSpecialForm(SpecialForm form,
+                                                   const std::shared_ptr<Cell>& cell, Scope* scope,
+                                                   bool tail) {
+    auto syntax = ParseSpecialForm(form, cell->GetSecond());
+    if (form == SpecialForm::kAnd || form == SpecialForm::kOr) {
+        std::vector<std::shared_ptr<Node>> operands;
+        for (size_t i = 0; i < syntax.operands.size(); ++i) {
+            bool last = i + 1 == syntax.operands.size();
+            operands.push_back(CompileOperand(syntax.operands[i], scope, tail && last));
+        }
+        return std::make_shared<ShortCircuitNode>(form == SpecialForm::kAnd, std::move(operands));
+    }
+    if (form == SpecialForm::kDefine) {
+        throw SyntaxError("define is only allowed at the top level and in bodies");
+    }
+    if (form == SpecialForm::kLambda || form == SpecialForm::kLet) {
+        return CompileBindingForm(syntax, scope, tail);
+    }
+    if (form == SpecialForm::kFuture) {
+        return std::make_shared<UnaryCallNode>(FindBuiltin("spawn"),
+                                               CompileLambda(*syntax.lambda, "", scope));
+    }
+    std::vector<CondNode::Clause> clauses;
+    for (const auto& clause : syntax.clauses) {
+        CondNode::Clause compiled;
+        if (!clause.is_else) {
+            compiled.test = CompileOperand(clause.test, scope);
+        }
+        for (size_t i = 0; i < clause.body.size(); ++i) {
+            bool last = i + 1 == clause.body.size();
+            compiled.body.push_back(CompileOperand(clause.body[i], scope, tail && last));
+        }
+        clauses.push_back(std::move(compiled));
+    }
+    return std::make_shared<CondNode>(std::move(clauses));
+}
+
+std::shared_ptr<Node> Compiler::CompileBindingForm(const SpecialFormSyntax& syntax, Scope* scope,
+                                                   bool tail) {
+    if (syntax.form == SpecialForm::kLambda) {
+        return CompileLambda(*syntax.lambda, "", scope);
+    }
+    // the values are evaluated outside of the scope of the variables
+    std::vector<std::shared_ptr<Node>> values;
+    for (const auto& value : syntax.operands) {
+        values.push_back(CompileOperand(value, scope));
+    }
+    if (!syntax.name.empty()) {
+        auto loop = CompileLambda(*syntax.lambda, syntax.name, scope);
+        return std::make_shared<ApplyNode>(std::move(loop), std::move(values), tail);
+    }
+    size_t mark = scope->Mark();
+    uint32_t first_slot = scope->FrameSize();
+    for (size_t i = 0; i < syntax.lambda->params.size(); ++i) {
+        uint32_t slot = scope->Declare(syntax.lambda->params[i]);
+        if (i == 0) {
+            first_slot = slot;
+        }
+    }
+    auto body = CompileBody(syntax.lambda->body, scope, tail);
+    scope->Release(mark);
+    if (values.empty()) {
+        return body;
+    }
+    return std::make_shared<LetNode>(first_slot, std::move(values), std::move(body));
+}
+
+std::shared_ptr<Node> Compiler::CompileLambda(const LambdaSyntax& lambda, const std::string& self,
+                                              Scope* scope, std::optional<GroupMember> member) {
+    Scope inner(scope, self, member);
+    for (const auto& param : lambda.params) {
+        inner.Declare(param);
+    }
+    auto body = CompileBody(lambda.body, &inner, true);
+    auto code = std::make_shared<TreeProcedure>(lambda.params.size(), lambda.variadic,
+                                                inner.FrameSize(), std::move(body));
+    std::vector<std::shared_ptr<Node>> captures;
+    for (size_t i = 0; i < inner.Captures().size(); ++i) {
+        captures.push_back(MakeVariableNode(inner.Captures()[i], inner.CapturedNames()[i]));
+    }
+    return std::make_shared<LambdaNode>(std::move(code), std::move(captures), member);
+}
+
+std::shared_ptr<Node> Compiler::CompileBody(const std::vector<std::shared_ptr<Object>>& body,
+                                            Scope* scope, bool tail) {
+    size_t mark = scope->Mark();
+    // definitions are variables of the whole body, so that procedures can use the ones after them
+    auto names = BodyDefinitions(body);
+    std::vector<SpecialFormSyntax> definitions(body.size());
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (!names[i].empty()) {
+            definitions[i] =
+                ParseSpecialForm(SpecialForm::kDefine, As<Cell>(body[i])->GetSecond());
+        }
+    }
+    auto in_group = BodyGroup(names, definitions);
+    uint32_t group_size = std::count(in_group.begin(), in_group.end(), true);
+    // the procedures get each other from their group; no variable is called ""
+    int64_t group = group_size > 1 ? static_cast<int64_t>(scope->Declare("")) : -1;
+    std::vector<uint32_t> defined;
+    std::vector<int64_t> slots(body.size(), -1);
+    std::vector<std::optional<GroupMember>> members(body.size());
+    uint32_t index = 0;
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (names[i].empty()) {
+            continue;
+        }
+        if (group >= 0 && in_group[i]) {
+            members[i] = GroupMember{static_cast<uint32_t>(group), index++};
+        }
+        slots[i] = scope->Declare(names[i], members[i]);
+        defined.push_back(slots[i]);
+    }
+    std::vector<std::shared_ptr<Node>> expressions;
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (slots[i] < 0) {
+            expressions.push_back(CompileOperand(body[i], scope, tail && i + 1 == body.size()));
+            continue;
+        }
+        const auto& syntax = definitions[i];
+        if (syntax.lambda) {
+            auto value = CompileLambda(*syntax.lambda, syntax.name, scope, members[i]);
+            expressions.push_back(std::make_shared<DefineLocalNode>(slots[i], std::move(value)));
+        } else {
+            auto value = CompileOperand(syntax.operands[0], scope);
+            expressions.push_back(
+                std::make_shared<DefineLocalNode>(slots[i], std::move(value), members[i]));
+        }
+    }
+    scope->Release(mark);
+    if (defined.empty() && expressions.size() == 1) {
+        return expressions[0];
+    }
+    return std::make_shared<BodyNode>(std::move(defined), group, group_size,
+                                      std::move(expressions));
+}
+
+std::shared_ptr<Node> Compiler::CompileParallel(const std::shared_ptr<Cell>& cell,
+                                                const std::shared_ptr<Object>& functor,
+                                                Scope* scope) {
+    std::vector<std::shared_ptr<Object>> operands;
+    size_t expensive = 0;
+    ListWalker it(cell->GetSecond());
+    for (; it.AtCell(); it.Next()) {
+        auto cost = PureCost(it.Head(), scope);
+        if (!cost) {
+            return nullptr;
+        }
+        expensive += *cost >= parallel_threshold_;
+        operands.push_back(it.Head());
+    }
+    // one expensive argument has nothing to run alongside
+    if (it.Rest() != nullptr || expensive < 2) {
+        return nullptr;
+    }
+    std::vector<std::shared_ptr<Node>> args;
+    for (const auto& operand : operands) {
+        args.push_back(CompileOperand(operand, scope));
+    }
+    return std::make_shared<ParallelCallNode>(functor, std::move(args));
+}
+
+std::optional<size_t> Compiler::PureCost(const std::shared_ptr<Object>& obj, Scope* scope) {
+    auto cell = As<Cell>(obj);
+    if (cell == nullptr) {
+        // variables are only read, and the rest are constants
+        return 1;
+    }
+    if (auto it = costs_.find(cell.get()); it != costs_.end()) {
+        return it->second;
+    }
+    std::optional<size_t> cost;
+    auto symbol = As<Symbol>(cell->GetFirst());
+    VariableRef ref;
+    if (symbol != nullptr && !scope->Resolve(symbol->GetName(), &ref) &&
+        IsPureBuiltin(symbol->GetName())) {
+        cost = 1;
+        ListWalker it(cell->GetSecond());
+        for (; it.AtCell() && cost; it.Next()) {
+            auto arg = PureCost(it.Head(), scope);
+            cost = arg ? std::optional(*cost + *arg) : std::nullopt;
+        }
+        if (it.Rest() != nullptr) {
+            cost.reset();
+        }
+    }
+    costs_.emplace(cell.get(), cost);
+    return cost;
+}
+
+std::shared_ptr<Node> Compiler::CompileNumeric(const std::shared_ptr<Cell>& cell, Scope* scope) {
+    NumericOp op;
+    if (!FindNumericOp(As<Symbol>(cell->GetFirst())->GetName(), &op)) {
+        return nullptr;
+    }
+    std::vector<NumericInstr> code;
+    std::vector<std::shared_ptr<Object>> operands;
+    if (!AddNumeric(cell, scope, &code, &operands)) {
+        return nullptr;
+    }
+    std::vector<std::shared_ptr<Node>> inputs;
+    for (const auto& operand : operands) {
+        inputs.push_back(CompileOperand(operand, scope));
+    }
+    return std::make_shared<JitNode>(std::move(code), std::move(inputs), jit_threshold_);
+}
+
+// Appends the call to code. Number literals and nested arithmetic become part of the expression,
+// other calls and variables are inputs, and anything else (booleans, ...) makes the builtin fail,
+// so such calls are left to the interpreter.
+bool Compiler::AddNumeric(const std::shared_ptr<Cell>& cell, Scope* scope,
+                          std::vector<NumericInstr>* code,
+                          std::vector<std::shared_ptr<Object>>* inputs) {
+    auto symbol = As<Symbol>(cell->GetFirst());
+    NumericOp op;
+    FindNumericOp(symbol->GetName(), &op);
+    uint32_t argc = 0;
+    for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next(), ++argc) {
+        const auto& arg = it.Head();
+        if (Is<Number>(arg)) {
+            code->push_back({NumericInstr::kConstant, {}, 0, arg});
+            continue;
+        }
+        auto call = As<Cell>(arg);
+        if (call == nullptr && !Is<Symbol>(arg)) {
+            return false;
+        }
+        // сравнения дают #t/#f, поэтому внутри выражения они только входы
+        auto name = call ? As<Symbol>(call->GetFirst()) : nullptr;
+        NumericOp nested;
+        VariableRef ref;
+        if (name != nullptr && !scope->Resolve(name->GetName(), &ref) &&
+            FindNumericOp(name->GetName(), &nested) && !IsComparison(nested)) {
+            if (!AddNumeric(call, scope, code, inputs)) {
+                return false;
+            }
+            continue;
+        }
+        if (inputs->size() == JitNode::kMaxInputs) {
+            return false;
+        }
+        // the native code has the values of all the inputs before the first operation, the
+        // builtins get to an input only if the operations before it succeed: the inputs after an
+        // operation may have no side effects
+        bool after_operation = std::any_of(code->begin(), code->end(), [](const auto& instr) {
+            return instr.kind == NumericInstr::kCall;
+        });
+        if (after_operation && !PureCost(arg, scope)) {
+            return false;
+        }
+        code->push_back({NumericInstr::kInput, {}, static_cast<uint32_t>(inputs->size()), {}});
+        inputs->push_back(arg);
+    }
+    if (!AcceptsArgs(op, argc)) {
+        return false;
+    }
+    code->push_back({NumericInstr::kCall, op, argc, FindBuiltin(symbol->GetName())});
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "environment.h"
+#include "object.h"
+
+// The variables of the procedure a node is run for, see environment.h
+struct Frame {
+    std::shared_ptr<Object>* slots = nullptr;
+    Closure* closure = nullptr;
+};
+
+// A parsed expression compiled into a tree of nodes. Builtins and variables are resolved,
+// literals are boxed and argument lists are unpacked once at compile time, so executing a node
+// does no symbol lookups, type checks of the syntax or list walking, and it can be executed any
+// number of times.
+class Node {
+public:
+    virtual ~Node() = default;
+
+    // Executes a compiled top-level expression
+    std::shared_ptr<Object> Execute() {
+        return Run(nullptr);
+    }
+    // Executes the node as a part of a procedure. Nodes of top-level expressions without
+    // variables get no frame.
+    virtual std::shared_ptr<Object> Run(Frame* frame) = 0;
+};
+
+// Throws RuntimeError when the stack of the thread is about to run out. Every call of a procedure
+// which takes the C++ stack checks it: the tree engine recurses on it, and the VM does when the
+// calls go through builtins or Execute.
+void CheckStack();
+
+struct NumericInstr;
+enum class SpecialForm;
+struct LambdaSyntax;
+struct SpecialFormSyntax;
+
+// Procedures run their calls in tail position in a loop, so they take no stack.
+class Compiler {
+public:
+    explicit Compiler(std::shared_ptr<Globals> globals = std::make_shared<Globals>())
+        : globals_(std::move(globals)) {
+    }
+
+    // Throws SyntaxError for malformed special forms, see special_forms.h. Other expressions which
+    // can not be evaluated compile to nodes raising the same RuntimeError the evaluation would,
+    // and unbound variables to nodes raising NameError.
+    std::shared_ptr<Node> Compile(const std::shared_ptr<Object>& obj);
+
+    // Numeric expressions compiled from now on are translated to machine code after they were
+    // executed threshold times, see jit.h. Does nothing where the JIT is not available.
+    void EnableJit(uint32_t threshold);
+
+    static constexpr size_t kDefaultParallelThreshold = 512;
+    // Calls of pure builtins compiled from now on evaluate their arguments in parallel, see
+    // parallel.h, when at least two of them are made of pure builtins, constants and variables
+    // only, of threshold calls and values or more. 0 turns it off.
+    void EnableParallelArguments(size_t threshold);
+
+private:
+    // tail is true for the expressions whose value the procedure returns
+    std::shared_ptr<Node> CompileCall(const std::shared_ptr<Cell>& cell, Scope* scope, bool tail);
+    std::shared_ptr<Node> CompileOperand(const std::shared_ptr<Object>& obj, Scope* scope,
+                                         bool tail = false);
+    std::shared_ptr<Node> CompileVariable(const std::string& name, Scope* scope);
+    std::shared_ptr<Node> CompileSpecialForm(SpecialForm form, const std::shared_ptr<Cell>& cell,
+                                             Scope* scope, bool tail);
+    std::shared_ptr<Node> CompileBindingForm(const SpecialFormSyntax& syntax, Scope* scope,
+                                             bool tail);
+    std::shared_ptr<Node> CompileLambda(const LambdaSyntax& lambda, const std::string& self,
+                                        Scope* scope,
+                                        std::optional<GroupMember> member = std::nullopt);
+    std::shared_ptr<Node> CompileBody(const std::vector<std::shared_ptr<Object>>& body,
+                                      Scope* scope, bool tail);
+    // nullptr if the arguments are not worth evaluating in parallel
+    std::shared_ptr<Node> CompileParallel(const std::shared_ptr<Cell>& cell,
+                                          const std::shared_ptr<Object>& functor, Scope* scope);
+    // The number of calls and values in obj, if it is made of pure builtins only
+    std::optional<size_t> PureCost(const std::shared_ptr<Object>& obj, Scope* scope);
+    // nullptr if the call is not a numeric expression the JIT can handle
+    std::shared_ptr<Node> CompileNumeric(const std::shared_ptr<Cell>& cell, Scope* scope);
+    bool AddNumeric(const std::shared_ptr<Cell>& cell, Scope* scope,
+                    std::vector<NumericInstr>* code, std::vector<std::shared_ptr<Object>>* inputs);
+
+    std::shared_ptr<Globals> globals_;
+    bool jit_ = false;
+    uint32_t jit_threshold_ = 0;
+    size_t parallel_threshold_ = 0;
+    // PureCost of the calls of the expression being compiled
+    std::unordered_map<const Object*, std::optional<size_t>> costs_;
+};
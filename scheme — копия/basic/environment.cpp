@@ -0,0 +1,188 @@
+#include "environment.h"
+
+#include <algorithm>
+
+#include "builtins.h"
+#include "error.h"
+
+namespace {
+
+class UnboundValue : public Object {
+public:
+    std::string Cerealize() override {
+        throw RuntimeError("unbound variable");
+    }
+    std::shared_ptr<Object> Clone() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Calculate() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Apply(Args) override {
+        throw RuntimeError("unbound variable");
+    }
+};
+
+}  // namespace
+
+const std::shared_ptr<Object>& Unbound() {
+    static const std::shared_ptr<Object> kUnbound = std::make_shared<UnboundValue>();
+    return kUnbound;
+}
+
+void ThrowUnbound(const std::string& name) {
+    throw NameError("unbound variable " + name);
+}
+
+Globals::~Globals() {
+    for (auto& [name, global] : globals_) {
+        global->Store(Unbound());
+    }
+}
+
+const std::shared_ptr<Global>& Globals::Find(const std::string& name) {
+    auto& global = globals_[name];
+    if (global == nullptr) {
+        global = std::make_shared<Global>();
+        global->name = name;
+    }
+    return global;
+}
+
+const std::shared_ptr<Global>& Globals::Define(const std::string& name) {
+    if (FindBuiltin(name) != nullptr) {
+        throw SyntaxError("can not redefine builtin " + name);
+    }
+    return Find(name);
+}
+
+uint32_t Scope::Declare(const std::string& name, std::optional<GroupMember> member) {
+    uint32_t slot = locals_.size();
+    locals_.push_back({name, slot, member});
+    frame_size_ = std::max<uint32_t>(frame_size_, locals_.size());
+    return slot;
+}
+
+bool Scope::Resolve(const std::string& name, VariableRef* ref) {
+    for (auto it = locals_.rbegin(); it != locals_.rend(); ++it) {
+        if (it->name == name) {
+            *ref = {VariableRef::kLocal, it->slot};
+            return true;
+        }
+    }
+    if (name == self_) {
+        *ref = {VariableRef::kSelf, 0};
+        return true;
+    }
+    if (auto sibling = FindSibling(name)) {
+        *ref = {VariableRef::kSibling, *sibling};
+        return true;
+    }
+    for (size_t i = 0; i < captured_names_.size(); ++i) {
+        if (captured_names_[i] == name) {
+            *ref = {VariableRef::kCaptured, static_cast<uint32_t>(i)};
+            return true;
+        }
+    }
+    VariableRef outer;
+    if (parent_ == nullptr || !parent_->Resolve(name, &outer)) {
+        return false;
+    }
+    captures_.push_back(outer);
+    captured_names_.push_back(name);
+    *ref = {VariableRef::kCaptured, static_cast<uint32_t>(captures_.size() - 1)};
+    return true;
+}
+
+std::optional<uint32_t> Scope::FindSibling(const std::string& name) const {
+    if (!member_) {
+        return std::nullopt;
+    }
+    for (auto it = parent_->locals_.rbegin(); it != parent_->locals_.rend(); ++it) {
+        if (it->name == name) {
+            if (it->member && it->member->group == member_->group) {
+                return it->member->index;
+            }
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+void ProcedureCode::Bind(Args args, std::shared_ptr<Object>* slots) const {
+    SpendFuel();
+    uint32_t fixed = variadic_ ? params_ - 1 : params_;
+    if (args.size() < fixed || (!variadic_ && args.size() != fixed)) {
+        throw RuntimeError("no or too many arguments");
+    }
+    std::copy(args.begin(), args.begin() + fixed, slots);
+    if (variadic_) {
+        ListBuilder rest;
+        for (size_t i = fixed; i < args.size(); ++i) {
+            rest.Add(args[i]);
+        }
+        slots[fixed] = rest.Build();
+    }
+}
+
+std::shared_ptr<Object> ProcedureGroup::Define(uint32_t index,
+                                               std::shared_ptr<ProcedureCode> code,
+                                               std::vector<std::shared_ptr<Object>> captured) {
+    std::lock_guard lock(mutex_);
+    auto& member = members_[index];
+    member.code = std::move(code);
+    member.captured = std::move(captured);
+    return MakeClosure(&member);
+}
+
+void ProcedureGroup::Set(uint32_t index, std::shared_ptr<Object> value) {
+    std::lock_guard lock(mutex_);
+    members_[index].is_set = true;
+    members_[index].value = std::move(value);
+}
+
+std::shared_ptr<Object> ProcedureGroup::Get(uint32_t index) {
+    std::lock_guard lock(mutex_);
+    auto& member = members_[index];
+    if (member.is_set) {
+        return member.value;
+    }
+    if (member.code == nullptr) {
+        return Unbound();
+    }
+    if (auto closure = member.closure.lock()) {
+        return closure;
+    }
+    return MakeClosure(&member);
+}
+
+std::shared_ptr<Object> ProcedureGroup::MakeClosure(Member* member) {
+    auto closure = std::make_shared<Closure>(
+        member->code, member->captured,
+        std::static_pointer_cast<ProcedureGroup>(shared_from_this()));
+    member->closure = closure;
+    return closure;
+}
+
+std::string ProcedureGroup::Cerealize() {
+    throw RuntimeError("unbound variable");
+}
+
+std::shared_ptr<Object> ProcedureGroup::Clone() {
+    return shared_from_this();
+}
+
+std::shared_ptr<Object> ProcedureGroup::Calculate() {
+    return shared_from_this();
+}
+
+std::shared_ptr<Object> ProcedureGroup::Apply(Args) {
+    throw RuntimeError("unbound variable");
+}
+
+std::shared_ptr<Object> Invoke(const std::shared_ptr<Object>& callee, Args args) {
+    if (dynamic_cast<Function*>(callee.get()) == nullptr) {
+        throw RuntimeError("can not apply");
+    }
+    return callee->Apply(args);
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Variables are resolved when an expression is compiled, the compiled code never looks a name up.
+// A variable is
+//   - a local of the procedure being run, a slot in its frame: the parameters, the variables of
+//     let and the definitions in bodies;
+//   - a captured one, a variable of an enclosing procedure. Closures are flat: a closure copies
+//     the values of the variables it uses when it is created and nothing else;
+//   - the procedure itself, in the body of a named let or of a procedure defined in a body;
+//   - another procedure defined in the same body, or a variable defined there after the first
+//     procedure, in a procedure defined in a body: such procedures can call each other and use
+//     the variables defined after them, see ProcedureGroup;
+//   - a global, defined at the top level.
+// Lexical variables shadow builtins, globals can not: define does not take the names of builtins.
+
+// The value of variables which are declared, but not defined yet
+const std::shared_ptr<Object>& Unbound();
+[[noreturn]] void ThrowUnbound(const std::string& name);
+
+// Futures keep running after the expression which spawned them, so a global can be read on
+// another thread while it is defined
+struct Global {
+    std::string name;
+
+    std::shared_ptr<Object> Load() {
+        std::lock_guard lock(mutex_);
+        return value_;
+    }
+    void Store(std::shared_ptr<Object> value) {
+        std::lock_guard lock(mutex_);
+        value_.swap(value);
+    }
+
+private:
+    std::mutex mutex_;
+    std::shared_ptr<Object> value_ = Unbound();
+};
+
+// The global variables of an interpreter. Compiled code refers to them directly.
+class Globals {
+public:
+    Globals() = default;
+    Globals(const Globals&) = delete;
+    Globals& operator=(const Globals&) = delete;
+    // Closures in globals refer to the globals they use, the values are dropped here to break
+    // such cycles.
+    ~Globals();
+
+    // The variable called name, it is created unbound if there is none
+    const std::shared_ptr<Global>& Find(const std::string& name);
+    // Same, for define. Throws SyntaxError for the names of builtins.
+    const std::shared_ptr<Global>& Define(const std::string& name);
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<Global>> globals_;
+};
+
+struct VariableRef {
+    enum Kind : uint8_t { kLocal, kCaptured, kSelf, kSibling };
+
+    Kind kind;
+    // kLocal: the slot in the frame, kCaptured: the index of the captured value, kSibling: the
+    // index of the member in the group of the one being run
+    uint32_t index;
+};
+
+// A definition in a body which has a ProcedureGroup: the slot of the group in the frame and the
+// index of the definition in it
+struct GroupMember {
+    uint32_t group;
+    uint32_t index;
+};
+
+// The lexical variables of one procedure while it is compiled, or of a top-level expression,
+// which has no parent.
+class Scope {
+public:
+    // self is the name under which the procedure can call itself, or empty. member is set for
+    // a procedure defined in a body, which gets the others defined there from its group.
+    Scope(Scope* parent, std::string self, std::optional<GroupMember> member = std::nullopt)
+        : parent_(parent), self_(std::move(self)), member_(member) {
+    }
+
+    bool IsTopLevel() const {
+        return parent_ == nullptr;
+    }
+
+    // Adds a local, which shadows the variables called the same until it is released.
+    // Returns its slot. member is set for the definitions in a body which are in its group.
+    uint32_t Declare(const std::string& name,
+                     std::optional<GroupMember> member = std::nullopt);
+    // Locals declared after Mark() are released by Release(mark). Their slots can be reused.
+    size_t Mark() const {
+        return locals_.size();
+    }
+    void Release(size_t mark) {
+        locals_.resize(mark);
+    }
+    // The number of slots the frame of the procedure needs
+    uint32_t FrameSize() const {
+        return frame_size_;
+    }
+
+    // Looks name up here and in the enclosing scopes. A variable of an enclosing procedure is
+    // captured by this one, and by each procedure in between. False if name is not a lexical
+    // variable, it is a builtin or a global then.
+    bool Resolve(const std::string& name, VariableRef* ref);
+
+    // Where the captured values come from, in the parent scope
+    const std::vector<VariableRef>& Captures() const {
+        return captures_;
+    }
+    const std::vector<std::string>& CapturedNames() const {
+        return captured_names_;
+    }
+
+private:
+    struct Local {
+        std::string name;
+        uint32_t slot;
+        std::optional<GroupMember> member;
+    };
+
+    // The member of the same group as this one called name, if it is one
+    std::optional<uint32_t> FindSibling(const std::string& name) const;
+
+    Scope* parent_;
+    std::string self_;
+    std::optional<GroupMember> member_;
+    std::vector<Local> locals_;
+    uint32_t frame_size_ = 0;
+    std::vector<VariableRef> captures_;
+    std::vector<std::string> captured_names_;
+};
+
+class Closure;
+
+// The code of a lambda, as compiled by one of the engines
+class ProcedureCode {
+public:
+    ProcedureCode(uint32_t params, bool variadic, uint32_t frame_size)
+        : params_(params), variadic_(variadic), frame_size_(frame_size) {
+    }
+    virtual ~ProcedureCode() = default;
+
+    virtual std::shared_ptr<Object> Call(Closure* closure, Args args) = 0;
+
+    uint32_t FrameSize() const {
+        return frame_size_;
+    }
+    // Puts the arguments into the first slots of a frame, the rest of a variadic procedure as
+    // a list. Throws RuntimeError if their number is wrong. Every application of a procedure,
+    // in either engine, comes here and is a step of the budget, see budget.h.
+    void Bind(Args args, std::shared_ptr<Object>* slots) const;
+
+private:
+    uint32_t params_;
+    bool variadic_;
+    uint32_t frame_size_;
+};
+
+class ProcedureGroup;
+
+class Closure : public Function {
+public:
+    Closure(std::shared_ptr<ProcedureCode> code, std::vector<std::shared_ptr<Object>> captured,
+            std::shared_ptr<ProcedureGroup> group = nullptr)
+        : code_(std::move(code)), captured_(std::move(captured)), group_(std::move(group)) {
+    }
+
+    std::shared_ptr<Object> Apply(Args args) override {
+        return code_->Call(this, args);
+    }
+
+    ProcedureCode* GetCode() const {
+        return code_.get();
+    }
+    const std::shared_ptr<Object>& Captured(uint32_t index) const {
+        return captured_[index];
+    }
+    // The procedures defined in the same body, nullptr if this one is not defined in a body
+    ProcedureGroup* Group() const {
+        return group_.get();
+    }
+
+private:
+    std::shared_ptr<ProcedureCode> code_;
+    std::vector<std::shared_ptr<Object>> captured_;
+    std::shared_ptr<ProcedureGroup> group_;
+};
+
+// The procedures defined in one run of a body, which may call each other, and the variables
+// defined after the first of them, which the procedures may use before they are defined. Flat
+// closures which captured each other would be a cycle, never freed: they hold the group instead
+// and get each other, and those variables, from it. The group holds the code and the captured
+// values of the procedures, not their closures, so it makes a closure anew when nobody has the
+// one it made before. It holds the values of the variables, so a value which holds one of the
+// procedures is a cycle still.
+// It lives in a slot of the frame the body runs in, and the body makes a new one each time.
+class ProcedureGroup : public Object {
+public:
+    explicit ProcedureGroup(size_t size) : members_(size) {
+    }
+
+    // Procedure index is defined: returns its closure
+    std::shared_ptr<Object> Define(uint32_t index, std::shared_ptr<ProcedureCode> code,
+                                   std::vector<std::shared_ptr<Object>> captured);
+    // Variable index is defined
+    void Set(uint32_t index, std::shared_ptr<Object> value);
+    // The closure of procedure index or the value of variable index, Unbound() if it is not
+    // defined yet
+    std::shared_ptr<Object> Get(uint32_t index);
+
+    std::string Cerealize() override;
+    std::shared_ptr<Object> Clone() override;
+    std::shared_ptr<Object> Calculate() override;
+    std::shared_ptr<Object> Apply(Args args) override;
+
+private:
+    struct Member {
+        std::shared_ptr<ProcedureCode> code;
+        std::vector<std::shared_ptr<Object>> captured;
+        std::weak_ptr<Object> closure;
+        // of a variable, the others are procedures; the empty list is nullptr
+        bool is_set = false;
+        std::shared_ptr<Object> value;
+    };
+
+    std::shared_ptr<Object> MakeClosure(Member* member);
+
+    // the procedures of a group can run on several threads
+    std::mutex mutex_;
+    std::vector<Member> members_;
+};
+
+// Calls a builtin or a procedure. Throws RuntimeError if callee is not one.
+std::shared_ptr<Object> Invoke(const std::shared_ptr<Object>& callee, Args args);
@@ -13,3 +13,18 @@ struct RuntimeError : public std::runtime_error {
 struct NameError : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
+
+// Thrown at a safe point of an evaluation which ran out of fuel or was cancelled, see budget.h.
+// Not a runtime_error, so nothing which handles the errors of the program catches it, and it is
+// cheap to throw: there is no message to build.
+struct Interrupted : public std::exception {
+    enum class Reason { kOutOfFuel, kCancelled };
+
+    explicit Interrupted(Reason reason) : reason(reason) {
+    }
+    const char* what() const noexcept override {
+        return reason == Reason::kOutOfFuel ? "out of fuel" : "cancelled";
+    }
+
+    Reason reason;
+};
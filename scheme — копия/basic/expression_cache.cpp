@@ -0,0 +1,47 @@
+#include "expression_cache.h"
+
+#include <utility>
+
+std::shared_ptr<Node> ExpressionCache::Find(std::string_view source) {
+    auto it = index_.find(source);
+    if (it == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->node;
+}
+
+void ExpressionCache::Insert(std::string_view source, std::shared_ptr<Node> node) {
+    if (capacity_ == 0) {
+        return;
+    }
+    if (auto it = index_.find(source); it != index_.end()) {
+        it->second->node = std::move(node);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    if (entries_.size() == capacity_) {
+        Evict();
+    }
+    entries_.push_front({std::string(source), std::move(node)});
+    index_.emplace(entries_.front().source, entries_.begin());
+}
+
+void ExpressionCache::Clear() {
+    index_.clear();
+    entries_.clear();
+}
+
+void ExpressionCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    while (entries_.size() > capacity_) {
+        Evict();
+    }
+}
+
+void ExpressionCache::Evict() {
+    index_.erase(entries_.back().source);
+    entries_.pop_back();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "compiler.h"
+
+// Compiled expressions by their source text, so a repeated expression costs a hash lookup
+// instead of tokenizing, parsing and compiling it again. The least recently used one is dropped
+// when the cache is full. Only expressions which compiled are cached, errors are raised again.
+class ExpressionCache {
+public:
+    static constexpr size_t kDefaultCapacity = 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    explicit ExpressionCache(size_t capacity = kDefaultCapacity) : capacity_(capacity) {
+    }
+    ExpressionCache(const ExpressionCache&) = delete;
+    ExpressionCache& operator=(const ExpressionCache&) = delete;
+
+    // nullptr on a miss, which is counted
+    std::shared_ptr<Node> Find(std::string_view source);
+    void Insert(std::string_view source, std::shared_ptr<Node> node);
+    // The compiled code depends on the settings of the interpreter, it is dropped when they change
+    void Clear();
+
+    // 0 disables the cache
+    void SetCapacity(size_t capacity);
+    Stats GetStats() const {
+        return {hits_, misses_, entries_.size(), capacity_};
+    }
+
+private:
+    struct Entry {
+        std::string source;
+        std::shared_ptr<Node> node;
+    };
+
+    void Evict();
+
+    size_t capacity_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    // most recently used first, the keys of index point to the sources here
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+};
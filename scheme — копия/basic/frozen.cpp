@@ -0,0 +1,122 @@
+#include "frozen.h"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+// A pointer which owns nothing and has no reference count
+template <class T>
+std::shared_ptr<T> Unowned(T* ptr) {
+    return std::shared_ptr<T>(std::shared_ptr<T>(), ptr);
+}
+
+}  // namespace
+
+FrozenSegment::~FrozenSegment() {
+    // the pointers between the objects own nothing, so the order does not matter
+    for (auto* obj : objects_) {
+        obj->~Object();
+    }
+    for (auto* chunk : chunks_) {
+        chunk->~ListChunk();
+    }
+}
+
+std::shared_ptr<const FrozenSegment> FrozenSegment::Freeze(const std::shared_ptr<Object>& value) {
+    std::shared_ptr<FrozenSegment> segment(new FrozenSegment());
+    segment->root_ = segment->Copy(value);
+    segment->copies_.clear();
+    segment->chunk_copies_.clear();
+    return segment;
+}
+
+template <class T, class... Args>
+T* FrozenSegment::New(Args&&... args) {
+    void* memory = arena_.allocate(sizeof(T), alignof(T));
+    bytes_ += sizeof(T);
+    auto* obj = new (memory) T(std::forward<Args>(args)...);
+    if constexpr (std::is_same_v<T, ListChunk>) {
+        chunks_.push_back(obj);
+    } else {
+        objects_.push_back(obj);
+    }
+    return obj;
+}
+
+std::shared_ptr<Object> FrozenSegment::Copy(const std::shared_ptr<Object>& value) {
+    if (value == nullptr) {
+        return nullptr;
+    }
+    if (auto it = copies_.find(value.get()); it != copies_.end()) {
+        return it->second;
+    }
+    std::shared_ptr<Object> copy;
+    if (auto cell = As<Cell>(value)) {
+        return CopyList(cell);
+    } else if (auto quote = As<Quote>(value)) {
+        copy = Unowned<Object>(New<Quote>(Copy(quote->GetObject())));
+    } else if (auto number = As<Number>(value)) {
+        copy = Unowned<Object>(New<Number>(number->GetValue()));
+    } else if (auto symbol = As<Symbol>(value)) {
+        copy = Unowned<Object>(New<Symbol>(symbol->GetName()));
+    } else if (auto boolean = As<Boolean>(value)) {
+        copy = Unowned<Object>(New<Boolean>(boolean->GetValue()));
+    } else {
+        throw RuntimeError("can't freeze a procedure");
+    }
+    copies_.emplace(value.get(), copy);
+    return copy;
+}
+
+std::shared_ptr<Object> FrozenSegment::Find(const Cell& cell) {
+    if (cell.chunk_) {
+        auto it = chunk_copies_.find(cell.chunk_.get());
+        if (it == chunk_copies_.end()) {
+            return nullptr;
+        }
+        return Unowned<Object>(New<Cell>(Unowned(it->second), cell.index_));
+    }
+    auto it = copies_.find(&cell);
+    return it == copies_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<Object> FrozenSegment::CopyList(const std::shared_ptr<Cell>& list) {
+    // The cdr chain is followed in a loop, so long lists do not recurse: first to the part
+    // which is copied already or to the tail, then the copies are made back to front.
+    // A view into a chunk stands for the rest of the chunk.
+    std::vector<std::shared_ptr<Cell>> chain;
+    std::shared_ptr<Object> tail = list;
+    std::shared_ptr<Object> copy;
+    while (auto cell = As<Cell>(tail)) {
+        if ((copy = Find(*cell))) {
+            break;
+        }
+        tail = cell->chunk_ ? cell->chunk_->next : cell->cell_.second;
+        chain.push_back(std::move(cell));
+    }
+    if (copy == nullptr) {
+        copy = Copy(tail);
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        const Cell& cell = **it;
+        if (cell.chunk_) {
+            const ListChunk& chunk = *cell.chunk_;
+            auto* chunk_copy = New<ListChunk>();
+            for (size_t i = 0; i < chunk.size; ++i) {
+                chunk_copy->items[i] = Copy(chunk.items[i]);
+            }
+            chunk_copy->size = chunk.size;
+            chunk_copy->next = std::move(copy);
+            chunk_copy->length = chunk.length;
+            chunk_copy->proper = chunk.proper;
+            chunk_copies_.emplace(&chunk, chunk_copy);
+            copy = Unowned<Object>(New<Cell>(Unowned(chunk_copy), cell.index_));
+        } else {
+            copy = Unowned<Object>(New<Cell>(Copy(cell.cell_.first), std::move(copy)));
+            copies_.emplace(&cell, copy);
+        }
+    }
+    return copy;
+}
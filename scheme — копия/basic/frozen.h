@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// An immutable copy of a value, made to be read by any number of threads at once. The objects
+// are laid out in one arena and referred to by shared_ptrs without a control block: copying
+// them, as every read of a variable does, touches no reference count, so the threads do not
+// contend on it. Such pointers do not keep anything alive, the values reachable from Root() are
+// valid as long as the segment is, Interpreter::DefineConstant keeps it for the interpreter. So
+// the frozen values an interpreter hands out, results of Execute and values sent to a Channel,
+// are valid while it exists, or while another owner keeps the segment.
+//
+// Frozen cells are never changed in place, see Cell::ChangeFirst. Lists keep their shape,
+// unrolled ones stay unrolled, and the parts shared within the value are shared in the copy.
+class FrozenSegment {
+public:
+    FrozenSegment(const FrozenSegment&) = delete;
+    FrozenSegment& operator=(const FrozenSegment&) = delete;
+    ~FrozenSegment();
+
+    // Throws RuntimeError if the value contains a procedure
+    static std::shared_ptr<const FrozenSegment> Freeze(const std::shared_ptr<Object>& value);
+
+    const std::shared_ptr<Object>& Root() const {
+        return root_;
+    }
+    // The number of objects and the bytes of the arena they take
+    size_t Objects() const {
+        return objects_.size() + chunks_.size();
+    }
+    size_t Bytes() const {
+        return bytes_;
+    }
+
+private:
+    FrozenSegment() = default;
+
+    template <class T, class... Args>
+    T* New(Args&&... args);
+    std::shared_ptr<Object> Copy(const std::shared_ptr<Object>& value);
+    std::shared_ptr<Object> CopyList(const std::shared_ptr<Cell>& list);
+    // The copy of the list starting at cell, if it is made already
+    std::shared_ptr<Object> Find(const Cell& cell);
+
+    std::pmr::monotonic_buffer_resource arena_;
+    size_t bytes_ = 0;
+    std::vector<Object*> objects_;
+    std::vector<ListChunk*> chunks_;
+    std::shared_ptr<Object> root_;
+
+    // the copies of the objects and of the chunks, while the segment is made
+    std::unordered_map<const Object*, std::shared_ptr<Object>> copies_;
+    std::unordered_map<const ListChunk*, ListChunk*> chunk_copies_;
+};
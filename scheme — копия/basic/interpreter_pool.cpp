@@ -0,0 +1,41 @@
+#include "interpreter_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <utility>
+
+namespace {
+
+size_t PoolSize(size_t size) {
+    if (size == 0) {
+        size = std::thread::hardware_concurrency();
+    }
+    return std::max<size_t>(size, 1);
+}
+
+}  // namespace
+
+InterpreterPool::InterpreterPool(size_t size, Engine engine, const Setup& setup)
+    : interpreters_(PoolSize(size)), pool_(interpreters_.size()) {
+    for (auto& interpreter : interpreters_) {
+        interpreter = std::make_unique<Interpreter>(engine);
+        if (setup) {
+            setup(interpreter.get());
+        }
+    }
+}
+
+std::future<std::string> InterpreterPool::Submit(std::string expression) {
+    // std::function must be copyable, std::promise is not
+    auto promise = std::make_shared<std::promise<std::string>>();
+    auto future = promise->get_future();
+    pool_.Submit([this, promise, expression = std::move(expression)](size_t worker) {
+        try {
+            promise->set_value(interpreters_[worker]->Run(expression));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
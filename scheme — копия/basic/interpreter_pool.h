@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scheme.h"
+#include "work_stealing_pool.h"
+
+// Runs expressions on several threads. Every worker owns an interpreter only it uses, so
+// Interpreter needs no locks; what they share is immutable, the builtins and the constants.
+// The interpreters are independent: a variable defined by one expression is not seen by the
+// expressions run by the other workers, the common definitions are made by setup.
+class InterpreterPool {
+public:
+    using Setup = std::function<void(Interpreter*)>;
+
+    // size of 0 is the number of hardware threads, setup is called for each interpreter
+    explicit InterpreterPool(size_t size = 0, Engine engine = Engine::kTree,
+                             const Setup& setup = nullptr);
+
+    // The future holds the printed result or the SyntaxError, RuntimeError or NameError
+    std::future<std::string> Submit(std::string expression);
+
+    size_t Size() const {
+        return pool_.Size();
+    }
+    size_t QueueDepth() const {
+        return pool_.QueueDepth();
+    }
+    std::vector<WorkStealingPool::WorkerStats> GetStats() const {
+        return pool_.GetStats();
+    }
+
+private:
+    std::vector<std::unique_ptr<Interpreter>> interpreters_;
+    // after the interpreters, so the workers are joined before those are destroyed
+    WorkStealingPool pool_;
+};
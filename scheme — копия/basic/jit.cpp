@@ -0,0 +1,546 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define SCHEME_JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::pair<std::string_view, NumericOp> kNumericOps[] = {
+    {"+", NumericOp::kAdd},     {"-", NumericOp::kSub},         {"*", NumericOp::kMul},
+    {"/", NumericOp::kDiv},     {"max", NumericOp::kMax},       {"min", NumericOp::kMin},
+    {"abs", NumericOp::kAbs},   {"<", NumericOp::kLess},        {"<=", NumericOp::kLessEq},
+    {">", NumericOp::kGreater}, {">=", NumericOp::kGreaterEq}, {"=", NumericOp::kEqual},
+};
+
+// Runs the code with the builtins. get(index, &value) supplies the inputs and returns false to
+// stop the evaluation, then the result is nullptr.
+template <class GetInput>
+std::shared_ptr<Object> Evaluate(const std::vector<NumericInstr>& code, GetInput&& get) {
+    std::vector<std::shared_ptr<Object>> stack;
+    for (const auto& instr : code) {
+        switch (instr.kind) {
+            case NumericInstr::kConstant:
+                stack.push_back(instr.object);
+                break;
+            case NumericInstr::kInput: {
+                std::shared_ptr<Object> value;
+                if (!get(instr.index, &value)) {
+                    return nullptr;
+                }
+                stack.push_back(std::move(value));
+                break;
+            }
+            case NumericInstr::kCall: {
+                size_t base = stack.size() - instr.index;
+                auto value = instr.object->Apply(Args(stack.data() + base, instr.index));
+                stack.resize(base);
+                stack.push_back(std::move(value));
+                break;
+            }
+        }
+    }
+    return std::move(stack.back());
+}
+
+#ifdef SCHEME_JIT_X86_64
+
+// Machine code for the expression, System V calling convention: rdi points to the unboxed
+// inputs, rsi to the result, eax is 1 on success and 0 if a guard failed. Operands are pushed
+// to the machine stack, so the operand number j of n is at [rsp + 8 * (n - 1 - j)]; rbp keeps
+// the stack pointer of the entry to drop them all on failure.
+class CodeGenerator {
+public:
+    std::vector<uint8_t> Generate(const std::vector<NumericInstr>& code) {
+        Emit({0x55, 0x48, 0x89, 0xE5});  // push rbp; mov rbp, rsp
+        for (const auto& instr : code) {
+            switch (instr.kind) {
+                case NumericInstr::kConstant:
+                    Emit({0x48, 0xB8});  // mov rax, imm64
+                    Emit64(static_cast<const Number&>(*instr.object).GetValue());
+                    Emit({0x50});  // push rax
+                    break;
+                case NumericInstr::kInput:
+                    Emit({0x48, 0x8B, 0x87});  // mov rax, [rdi + disp32]
+                    Emit32(8 * instr.index);
+                    Emit({0x50});
+                    break;
+                case NumericInstr::kCall:
+                    Call(instr.op, instr.index);
+                    break;
+            }
+        }
+        // pop rax; mov [rsi], rax; mov rsp, rbp; pop rbp; mov eax, 1; ret
+        Emit({0x58, 0x48, 0x89, 0x06, 0x48, 0x89, 0xEC, 0x5D, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xC3});
+        for (size_t jump : fails_) {
+            Bind(jump);
+        }
+        // mov rsp, rbp; pop rbp; xor eax, eax; ret
+        Emit({0x48, 0x89, 0xEC, 0x5D, 0x31, 0xC0, 0xC3});
+        return std::move(code_);
+    }
+
+private:
+    // condition codes
+    enum : uint8_t {
+        kOverflow = 0x0,
+        kEqual = 0x4,
+        kNotEqual = 0x5,
+        kNotSign = 0x9,
+        kLess = 0xC,
+        kGreaterEq = 0xD,
+        kLessEq = 0xE,
+        kGreater = 0xF,
+    };
+    // register numbers for ModRM
+    enum : uint8_t { kRax = 0, kRcx = 1 };
+
+    // The result is left in rax, the arguments are replaced by it.
+    void Call(NumericOp op, uint32_t argc) {
+        auto slot = [argc](uint32_t j) { return static_cast<int32_t>(8 * (argc - 1 - j)); };
+        switch (op) {
+            case NumericOp::kAdd:
+            case NumericOp::kSub:
+            case NumericOp::kMul:
+                if (argc == 0) {
+                    Emit({0x48, 0xC7, 0xC0});  // mov rax, imm32
+                    Emit32(op == NumericOp::kMul ? 1 : 0);
+                    break;
+                }
+                Operand({0x8B}, kRax, slot(0));  // mov rax, [rsp + slot]
+                for (uint32_t j = 1; j < argc; ++j) {
+                    if (op == NumericOp::kAdd) {
+                        Operand({0x03}, kRax, slot(j));  // add rax, [..]
+                    } else if (op == NumericOp::kSub) {
+                        Operand({0x2B}, kRax, slot(j));  // sub rax, [..]
+                    } else {
+                        Operand({0x0F, 0xAF}, kRax, slot(j));  // imul rax, [..]
+                    }
+                    FailIf(kOverflow);
+                }
+                break;
+            case NumericOp::kDiv:
+                Operand({0x8B}, kRax, slot(0));
+                for (uint32_t j = 1; j < argc; ++j) {
+                    Operand({0x8B}, kRcx, slot(j));  // mov rcx, [..]
+                    Emit({0x48, 0x85, 0xC9});        // test rcx, rcx
+                    FailIf(kEqual);
+                    Emit({0x48, 0x83, 0xF9, 0xFF});  // cmp rcx, -1
+                    size_t not_minus_one = JumpShort(0x70 + kNotEqual);
+                    Emit({0x48, 0xBA});  // mov rdx, INT64_MIN
+                    Emit64(std::numeric_limits<int64_t>::min());
+                    Emit({0x48, 0x39, 0xD0});  // cmp rax, rdx
+                    FailIf(kEqual);
+                    BindShort(not_minus_one);
+                    Emit({0x48, 0x99, 0x48, 0xF7, 0xF9});  // cqo; idiv rcx
+                }
+                break;
+            case NumericOp::kMax:
+            case NumericOp::kMin:
+                Operand({0x8B}, kRax, slot(0));
+                for (uint32_t j = 1; j < argc; ++j) {
+                    Operand({0x8B}, kRcx, slot(j));
+                    Emit({0x48, 0x39, 0xC8});  // cmp rax, rcx
+                    // cmovl rax, rcx / cmovg rax, rcx
+                    Emit({0x48, 0x0F, op == NumericOp::kMax ? uint8_t{0x4C} : uint8_t{0x4F}, 0xC1});
+                }
+                break;
+            case NumericOp::kAbs: {
+                Operand({0x8B}, kRax, slot(0));
+                Emit({0x48, 0x85, 0xC0});  // test rax, rax
+                size_t positive = JumpShort(0x70 + kNotSign);
+                Emit({0x48, 0xF7, 0xD8});  // neg rax
+                FailIf(kOverflow);
+                BindShort(positive);
+                break;
+            }
+            case NumericOp::kLess:
+            case NumericOp::kLessEq:
+            case NumericOp::kGreater:
+            case NumericOp::kGreaterEq:
+            case NumericOp::kEqual: {
+                // like the builtins, the first argument is compared with each of the others
+                std::vector<size_t> falses;
+                if (argc > 0) {
+                    Operand({0x8B}, kRax, slot(0));
+                }
+                for (uint32_t j = 1; j < argc; ++j) {
+                    Operand({0x3B}, kRax, slot(j));  // cmp rax, [..]
+                    falses.push_back(Jump(Negated(op)));
+                }
+                Emit({0xB8, 0x01, 0x00, 0x00, 0x00});  // mov eax, 1
+                size_t done = JumpShort(0xEB);
+                for (size_t jump : falses) {
+                    Bind(jump);
+                }
+                Emit({0x31, 0xC0});  // xor eax, eax
+                BindShort(done);
+                break;
+            }
+        }
+        if (argc > 0) {
+            Emit({0x48, 0x81, 0xC4});  // add rsp, imm32
+            Emit32(8 * argc);
+        }
+        Emit({0x50});
+    }
+
+    static uint8_t Negated(NumericOp op) {
+        switch (op) {
+            case NumericOp::kLess:
+                return kGreaterEq;
+            case NumericOp::kLessEq:
+                return kGreater;
+            case NumericOp::kGreater:
+                return kLessEq;
+            case NumericOp::kGreaterEq:
+                return kLess;
+            default:
+                return kNotEqual;
+        }
+    }
+
+    // REX.W opcode reg, [rsp + disp32]
+    void Operand(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp) {
+        Emit({0x48});
+        Emit(opcode);
+        Emit({static_cast<uint8_t>(0x84 | (reg << 3)), 0x24});
+        Emit32(disp);
+    }
+
+    void FailIf(uint8_t condition) {
+        fails_.push_back(Jump(condition));
+    }
+
+    // jcc rel32, returns the position of rel32 for Bind
+    size_t Jump(uint8_t condition) {
+        Emit({0x0F, static_cast<uint8_t>(0x80 + condition)});
+        Emit32(0);
+        return code_.size() - 4;
+    }
+
+    void Bind(size_t jump) {
+        int32_t offset = code_.size() - (jump + 4);
+        std::memcpy(code_.data() + jump, &offset, sizeof(offset));
+    }
+
+    // short jump with a one byte offset
+    size_t JumpShort(uint8_t opcode) {
+        Emit({opcode, 0x00});
+        return code_.size() - 1;
+    }
+
+    void BindShort(size_t jump) {
+        code_[jump] = static_cast<uint8_t>(code_.size() - (jump + 1));
+    }
+
+    void Emit(std::initializer_list<uint8_t> bytes) {
+        code_.insert(code_.end(), bytes);
+    }
+
+    void Emit32(int32_t value) {
+        auto bytes = reinterpret_cast<const uint8_t*>(&value);
+        code_.insert(code_.end(), bytes, bytes + sizeof(value));
+    }
+
+    void Emit64(int64_t value) {
+        auto bytes = reinterpret_cast<const uint8_t*>(&value);
+        code_.insert(code_.end(), bytes, bytes + sizeof(value));
+    }
+
+    std::vector<uint8_t> code_;
+    std::vector<size_t> fails_;
+};
+
+#endif
+
+}  // namespace
+
+#ifdef SCHEME_JIT_X86_64
+
+// The executable memory of all the nodes. Code is appended to chunks of kChunkSize, a chunk is
+// unmapped once none of its code is used. No page is ever writable and executable at once: on
+// Linux a chunk is mapped twice, writable for adding code and executable for running it, so code
+// can be added to a chunk while other code in it runs. Elsewhere each piece of code gets pages of
+// its own, which are made executable once it is written.
+class CodeArena {
+public:
+    struct Chunk {
+        uint8_t* write;
+        uint8_t* exec;
+        size_t size;
+        size_t used = 0;
+        size_t users = 0;
+    };
+
+    static constexpr size_t kChunkSize = 64 << 10;
+
+    static CodeArena* Instance() {
+        // never destroyed: code of static nodes may be released after the end of main
+        static auto* arena = new CodeArena;
+        return arena;
+    }
+
+    // A copy of code, nullptr if the system does not give executable memory. *chunk is for
+    // Release.
+    void* Add(const std::vector<uint8_t>& code, Chunk** chunk) {
+        std::lock_guard lock(mutex_);
+        size_t offset = current_ ? (current_->used + kAlignment - 1) / kAlignment * kAlignment : 0;
+        if (current_ == nullptr || offset + code.size() > current_->size) {
+            auto* next = NewChunk(std::max(code.size(), kChunkSize));
+            if (next == nullptr) {
+                return nullptr;
+            }
+            if (current_ != nullptr && current_->users == 0) {
+                Unmap(current_);
+            }
+            current_ = next;
+            offset = 0;
+        }
+        std::memcpy(current_->write + offset, code.data(), code.size());
+        current_->used = offset + code.size();
+        ++current_->users;
+        *chunk = current_;
+        void* entry = current_->exec + offset;
+        if (current_->write == current_->exec) {
+            // the chunk is this code only, it is done
+            if (mprotect(current_->exec, current_->size, PROT_READ | PROT_EXEC) != 0) {
+                Unmap(current_);
+                entry = nullptr;
+            }
+            current_ = nullptr;
+        }
+        return entry;
+    }
+
+    void Release(Chunk* chunk) {
+        std::lock_guard lock(mutex_);
+        if (--chunk->users == 0 && chunk != current_) {
+            Unmap(chunk);
+        }
+    }
+
+private:
+    static constexpr size_t kAlignment = 16;
+
+    static Chunk* NewChunk(size_t size) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size = (size + page - 1) / page * page;
+#ifdef __linux__
+        int fd = memfd_create("scheme-jit", MFD_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        void* write = MAP_FAILED;
+        void* exec = MAP_FAILED;
+        if (ftruncate(fd, size) == 0) {
+            write = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            exec = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (write == MAP_FAILED || exec == MAP_FAILED) {
+            for (void* view : {write, exec}) {
+                if (view != MAP_FAILED) {
+                    munmap(view, size);
+                }
+            }
+            return nullptr;
+        }
+#else
+        void* write =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (write == MAP_FAILED) {
+            return nullptr;
+        }
+        void* exec = write;
+#endif
+        return new Chunk{static_cast<uint8_t*>(write), static_cast<uint8_t*>(exec), size};
+    }
+
+    void Unmap(Chunk* chunk) {
+        munmap(chunk->exec, chunk->size);
+        if (chunk->write != chunk->exec) {
+            munmap(chunk->write, chunk->size);
+        }
+        if (current_ == chunk) {
+            current_ = nullptr;
+        }
+        delete chunk;
+    }
+
+    std::mutex mutex_;
+    // the chunk code is added to
+    Chunk* current_ = nullptr;
+};
+
+#endif
+
+// The generated code of a node, in the memory of CodeArena
+class NativeCode {
+public:
+    // nullptr if the system does not give executable memory
+    static std::unique_ptr<NativeCode> Load(const std::vector<uint8_t>& code) {
+#ifdef SCHEME_JIT_X86_64
+        CodeArena::Chunk* chunk;
+        void* entry = CodeArena::Instance()->Add(code, &chunk);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        return std::unique_ptr<NativeCode>(new NativeCode(entry, chunk));
+#else
+        return nullptr;
+#endif
+    }
+
+    ~NativeCode() {
+#ifdef SCHEME_JIT_X86_64
+        CodeArena::Instance()->Release(chunk_);
+#endif
+    }
+
+    void* Entry() const {
+        return entry_;
+    }
+
+private:
+#ifdef SCHEME_JIT_X86_64
+    NativeCode(void* entry, CodeArena::Chunk* chunk) : entry_(entry), chunk_(chunk) {
+    }
+#endif
+
+    void* entry_;
+#ifdef SCHEME_JIT_X86_64
+    CodeArena::Chunk* chunk_;
+#endif
+};
+
+bool FindNumericOp(std::string_view name, NumericOp* op) {
+    for (const auto& [op_name, value] : kNumericOps) {
+        if (op_name == name) {
+            *op = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsComparison(NumericOp op) {
+    return op >= NumericOp::kLess;
+}
+
+bool AcceptsArgs(NumericOp op, size_t argc) {
+    switch (op) {
+        case NumericOp::kAdd:
+        case NumericOp::kMul:
+            return true;
+        case NumericOp::kAbs:
+            return argc == 1;
+        default:
+            return IsComparison(op) || argc >= 1;
+    }
+}
+
+bool JitAvailable() {
+#ifdef SCHEME_JIT_X86_64
+    static const bool kAvailable = NativeCode::Load({0xC3}) != nullptr;
+    return kAvailable;
+#else
+    return false;
+#endif
+}
+
+JitNode::JitNode(std::vector<NumericInstr> code, std::vector<std::shared_ptr<Node>> inputs,
+                 uint32_t threshold)
+    : code_(std::move(code)),
+      inputs_(std::move(inputs)),
+      comparison_(IsComparison(code_.back().op)),
+      calls_(std::count_if(code_.begin(), code_.end(),
+                           [](const auto& instr) { return instr.kind == NumericInstr::kCall; })),
+      threshold_(threshold) {
+}
+
+JitNode::~JitNode() = default;
+
+std::shared_ptr<Object> JitNode::Run(Frame* frame) {
+    if (auto native = native_.load(std::memory_order_acquire)) {
+        return RunNative(native, frame);
+    }
+    if (executions_.fetch_add(1, std::memory_order_relaxed) + 1 >= threshold_ &&
+        !compile_started_.exchange(true)) {
+        Compile();
+        if (auto native = native_.load(std::memory_order_acquire)) {
+            return RunNative(native, frame);
+        }
+    }
+    return Interpret(frame);
+}
+
+std::shared_ptr<Object> JitNode::RunNative(NativeFunction native, Frame* frame) {
+    std::shared_ptr<Object> values[kMaxInputs];
+    int64_t numbers[kMaxInputs];
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+        try {
+            values[i] = inputs_[i]->Run(frame);
+        } catch (...) {
+            // the interpreter would get to this input only if the operations before it succeed
+            Interpret(values, i);
+            throw;
+        }
+    }
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+        auto number = AsRaw<Number>(values[i].get());
+        if (number == nullptr) {
+            return Interpret(values, inputs_.size());
+        }
+        numbers[i] = number->GetValue();
+    }
+    int64_t result;
+    if (!native(numbers, &result)) {
+        // overflow or division by zero, the builtins report it and charge their fuel
+        return Interpret(values, inputs_.size());
+    }
+    // the builtins the code replaces would each take a step; the code has no effects, so charging
+    // them after it is the same as before
+    SpendFuel(calls_);
+    if (comparison_) {
+        return MakeBool(result != 0);
+    }
+    return std::make_shared<Number>(result);
+}
+
+std::shared_ptr<Object> JitNode::Interpret(const std::shared_ptr<Object>* values,
+                                           size_t count) const {
+    return Evaluate(code_, [values, count](uint32_t index, std::shared_ptr<Object>* value) {
+        if (index >= count) {
+            return false;
+        }
+        *value = values[index];
+        return true;
+    });
+}
+
+std::shared_ptr<Object> JitNode::Interpret(Frame* frame) const {
+    return Evaluate(code_, [this, frame](uint32_t index, std::shared_ptr<Object>* value) {
+        *value = inputs_[index]->Run(frame);
+        return true;
+    });
+}
+
+void JitNode::Compile() {
+#ifdef SCHEME_JIT_X86_64
+    code_page_ = NativeCode::Load(CodeGenerator().Generate(code_));
+    if (code_page_ != nullptr) {
+        native_.store(reinterpret_cast<NativeFunction>(code_page_->Entry()),
+                      std::memory_order_release);
+    }
+#endif
+}
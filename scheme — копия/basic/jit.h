@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "compiler.h"
+#include "object.h"
+
+// Template JIT for numeric expressions: trees of + - * / max min abs over integers, optionally
+// under one comparison (< <= > >= =). Every operation is emitted as a fixed piece of x86-64 code
+// into executable memory shared by all the expressions. The numbers are unboxed before the
+// native code runs, which is the type guard, and the code itself checks for overflow and division
+// by zero. When a guard fails the expression is evaluated by the builtins, so results and errors
+// are exactly the interpreter's.
+enum class NumericOp : uint8_t {
+    kAdd,
+    kSub,
+    kMul,
+    kDiv,
+    kMax,
+    kMin,
+    kAbs,
+    kLess,
+    kLessEq,
+    kGreater,
+    kGreaterEq,
+    kEqual,
+};
+
+// Returns false if name is not an operation the JIT can compile.
+bool FindNumericOp(std::string_view name, NumericOp* op);
+bool IsComparison(NumericOp op);
+// Can op be called with argc arguments without always failing
+bool AcceptsArgs(NumericOp op, size_t argc);
+
+// False where there is no code generator (not x86-64) or executable memory is not available
+bool JitAvailable();
+
+// The expression in postfix order
+struct NumericInstr {
+    enum Kind : uint8_t { kConstant, kInput, kCall };
+
+    Kind kind;
+    NumericOp op;                    // kCall
+    uint32_t index;                  // kInput: inputs[index], kCall: the number of arguments
+    std::shared_ptr<Object> object;  // kConstant: the Number, kCall: the builtin
+};
+
+class NativeCode;
+
+class JitNode : public Node {
+public:
+    static constexpr uint32_t kDefaultThreshold = 1000;
+    // Inputs are the subexpressions the JIT does not handle, their values are guarded to be
+    // numbers. There are at most kMaxInputs of them. They are all evaluated before the native
+    // code runs, so the ones after the first operation must be free of side effects.
+    static constexpr size_t kMaxInputs = 8;
+
+    // The expression is interpreted until it was executed threshold times, then compiled.
+    JitNode(std::vector<NumericInstr> code, std::vector<std::shared_ptr<Node>> inputs,
+            uint32_t threshold);
+    ~JitNode() override;
+
+    std::shared_ptr<Object> Run(Frame* frame) override;
+
+    bool IsCompiled() const {
+        return native_.load(std::memory_order_acquire) != nullptr;
+    }
+
+private:
+    using NativeFunction = int (*)(const int64_t* inputs, int64_t* result);
+
+    std::shared_ptr<Object> RunNative(NativeFunction native, Frame* frame);
+    // Evaluates the code with the builtins, input values come from values[0 .. count); stops
+    // and returns nullptr on the input number count.
+    std::shared_ptr<Object> Interpret(const std::shared_ptr<Object>* values, size_t count) const;
+    std::shared_ptr<Object> Interpret(Frame* frame) const;
+    void Compile();
+
+    std::vector<NumericInstr> code_;
+    std::vector<std::shared_ptr<Node>> inputs_;
+    bool comparison_;
+    // kCall instructions, the fuel of the builtin applications native code stands for
+    uint32_t calls_;
+    uint32_t threshold_;
+
+    // nodes can be executed by several threads at once
+    std::atomic<uint32_t> executions_{0};
+    std::atomic<bool> compile_started_{false};
+    std::atomic<NativeFunction> native_{nullptr};
+    std::unique_ptr<NativeCode> code_page_;
+};
@@ -1,37 +1,115 @@
 #pragma once
 
+#include <charconv>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
 #include <unordered_map>
 #include <vector>
+#include "budget.h"
 #include "error.h"
 
+class Object;
+
+// Arguments of a call, a view of the caller's storage: passing them allocates nothing
+using Args = std::span<const std::shared_ptr<Object>>;
+
+// How many arguments a function takes. The compiled code calls functions with one and two
+// arguments through ApplyUnary and ApplyBinary, so functions of fixed arity implement those.
+enum class Arity { kUnary, kBinary, kVariadic };
+
+// The value types checked on every call have a kind, so checking for them is a compare rather
+// than a dynamic_cast. Every other object is kOther.
+enum class ObjectKind { kOther, kBoolean, kQuote, kNumber, kSymbol, kCell };
+
 class Object : public std::enable_shared_from_this<Object> {
 public:
+    explicit Object(ObjectKind kind = ObjectKind::kOther) : kind_(kind) {
+    }
     virtual ~Object() = default;
+    ObjectKind GetKind() const {
+        return kind_;
+    }
     virtual std::string Cerealize() = 0;
+    // Appends the representation to out. Atoms override it to avoid a temporary string.
+    virtual void CerealizeTo(std::string* out) {
+        *out += Cerealize();
+    }
+    // Values are immutable and shared between all the lists they are in, so Clone copies only
+    // the object itself, never the objects it refers to.
     virtual std::shared_ptr<Object> Clone() = 0;
     virtual std::shared_ptr<Object> Calculate() = 0;
-    virtual std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) = 0;
+    virtual std::shared_ptr<Object> Apply(Args args) = 0;
+    // Variadic functions may override these as fast paths for the most common calls.
+    virtual std::shared_ptr<Object> ApplyUnary(const std::shared_ptr<Object>& arg) {
+        return Apply(Args(&arg, 1));
+    }
+    virtual std::shared_ptr<Object> ApplyBinary(const std::shared_ptr<Object>& lhs,
+                                                const std::shared_ptr<Object>& rhs) {
+        const std::shared_ptr<Object> args[] = {lhs, rhs};
+        return Apply(args);
+    }
+    virtual Arity GetArity() const {
+        return Arity::kVariadic;
+    }
+
+private:
+    ObjectKind kind_;
+};
+
+// Builtins and procedures: values which can be called, but not printed
+class Function : public Object {
+public:
+    std::string Cerealize() override {
+        throw SyntaxError("can't cerealize func");
+    }
+    std::shared_ptr<Object> Clone() override {
+        throw SyntaxError("can't clone func");
+    }
+    std::shared_ptr<Object> Calculate() override {
+        throw SyntaxError("can't calculate");
+    }
 };
 
+// obj as a T or nullptr, without taking a reference. The types with a kind are final, so for
+// them the kind alone decides.
+template <class T>
+T* AsRaw(Object* obj) {
+    if constexpr (requires { T::kKind; }) {
+        if (obj == nullptr || obj->GetKind() != T::kKind) {
+            return nullptr;
+        }
+        return static_cast<T*>(obj);
+    } else {
+        return dynamic_cast<T*>(obj);
+    }
+}
+
 template <class T>
 std::shared_ptr<T> As(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<T>(obj);
+    auto raw = AsRaw<T>(obj.get());
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    return std::shared_ptr<T>(obj, raw);
 }
 
 template <class T>
 bool Is(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<T>(obj) != nullptr;
+    return AsRaw<T>(obj.get()) != nullptr;
 };
 
-class Boolean : public Object {
+class Boolean final : public Object {
 private:
     bool state_;
 
 public:
-    Boolean(bool s) : state_(s){};
+    static constexpr ObjectKind kKind = ObjectKind::kBoolean;
+
+    Boolean(bool s) : Object(kKind), state_(s){};
 
     bool GetValue() {
         return state_;
@@ -42,1120 +120,422 @@ public:
         }
         return "#f";
     }
+    void CerealizeTo(std::string* out) override {
+        out->append(state_ ? "#t" : "#f", 2);
+    }
     std::shared_ptr<Object> Clone() override {
-        return std::make_shared<Boolean>(Boolean(this->state_));
+        return shared_from_this();
     };
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) override {
+    std::shared_ptr<Object> Apply(Args v) override {
         throw SyntaxError("cay not apply");
     }
     std::shared_ptr<Object> Calculate() override {
-        return std::make_shared<Boolean>(Boolean(state_));
+        return shared_from_this();
     }
 };
 
-class Quote : public Object {
+// #t and #f are shared by everybody who does not need a fresh object
+inline const std::shared_ptr<Object>& MakeBool(bool value) {
+    static const std::shared_ptr<Object> kTrue = std::make_shared<Boolean>(true);
+    static const std::shared_ptr<Object> kFalse = std::make_shared<Boolean>(false);
+    return value ? kTrue : kFalse;
+}
+
+class Quote final : public Object {
 private:
     std::shared_ptr<Object> object_;
 
 public:
-    Quote(std::shared_ptr<Object> ob) : object_(ob){};
+    static constexpr ObjectKind kKind = ObjectKind::kQuote;
+
+    Quote(std::shared_ptr<Object> ob) : Object(kKind), object_(ob){};
 
     std::shared_ptr<Object> GetObject() {
         return object_;
     }
 
-    std::string Cerealize() override {
-        std::string ch = "(";
-        if (object_ == nullptr) {
-            return "()";
-        }
-        auto res = object_->Cerealize();
-        ch += res;
-        ch += ")";
-        return ch;
-    }
+    std::string Cerealize() override;  // printer.cpp
     std::shared_ptr<Object> Clone() override {
-        throw SyntaxError("  ");
+        return shared_from_this();
     }
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) override {
+    std::shared_ptr<Object> Apply(Args v) override {
         throw SyntaxError("cay not apply");
     }
 
     std::shared_ptr<Object> Calculate() override {
-        return std::make_shared<Quote>(object_);
+        return shared_from_this();
     }
 };
 
-class Number : public Object {
+class Number final : public Object {
 private:
-    int value_;
+    int64_t value_;
 
 public:
-    Number(int val) : value_(val){};
-    int GetValue() const {
+    static constexpr ObjectKind kKind = ObjectKind::kNumber;
+
+    Number(int64_t val) : Object(kKind), value_(val){};
+    int64_t GetValue() const {
         return value_;
     };
     std::shared_ptr<Object> Calculate() override {
-        return std::make_shared<Number>(Number(value_));
+        return shared_from_this();
     }
     std::string Cerealize() override {
         return std::to_string(value_);
     }
+    void CerealizeTo(std::string* out) override {
+        char buf[std::numeric_limits<int64_t>::digits10 + 3];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value_);
+        out->append(buf, end);
+    }
     std::shared_ptr<Object> Clone() override {
-        return std::make_shared<Number>(Number(this->value_));
+        return shared_from_this();
     };
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) override {
+    std::shared_ptr<Object> Apply(Args v) override {
         throw SyntaxError("cay not apply");
     }
 };
 
-class Symbol : public Object {
+class Symbol final : public Object {
 private:
     std::string name_;
 
 public:
-    Symbol(std::string str) : name_(str){};
+    static constexpr ObjectKind kKind = ObjectKind::kSymbol;
+
+    Symbol(std::string str) : Object(kKind), name_(str){};
     const std::string& GetName() const {
         return name_;
     };
     std::string Cerealize() override {
         return name_;
     }
+    void CerealizeTo(std::string* out) override {
+        *out += name_;
+    }
     std::shared_ptr<Object> Calculate() override {  // возвращает функцию
-        return std::make_shared<Symbol>(Symbol(name_));
+        return shared_from_this();
     }
     std::shared_ptr<Object> Clone() override {
-        return std::make_shared<Symbol>(Symbol(this->name_));
+        return shared_from_this();
     };
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) override {
+    std::shared_ptr<Object> Apply(Args v) override {
         throw SyntaxError("cay not apply");
     }
 };
 
-class Cell : public Object {
-
-public:
-    std::pair<std::shared_ptr<Object>, std::shared_ptr<Object>> cell_;
-    Cell(std::shared_ptr<Object> head, std::shared_ptr<Object> tail)
-        : cell_(std::make_pair(head, tail)){};
-    std::shared_ptr<Object> GetFirst() const {
-        return cell_.first;
-    };
-    std::shared_ptr<Object> GetSecond() const {
-        return cell_.second;
-    };
-
-    void ChangeFirst(std::shared_ptr<Object> f) {
-        cell_.first = f;
-    }
-    void ChangeSecond(std::shared_ptr<Object> s) {
-        cell_.second = s;
+// Quote is just a box around data: list builtins and the printer look through it.
+inline std::shared_ptr<Object> Unquote(std::shared_ptr<Object> obj) {
+    while (auto quote = As<Quote>(obj)) {
+        obj = quote->GetObject();
     }
+    return obj;
+}
 
-    std::string Cerealize() override {
-        if (!cell_.first) {
-            return "()";  // когда у нас вообще такая штука получается?
-        }
-        if (!cell_.second) {
-            std::string res;
-            res += cell_.first->Cerealize();
-            // res += ")";
-            return res;
-        }
-        std::string res_first;
-        std::string res_second;
-        std::string res;
-        res_first += cell_.first->Cerealize();
-        if (auto num = std::dynamic_pointer_cast<Cell>(cell_.second)) {
-            res_second += " ";
-            res_second += cell_.second->Cerealize();
-        } else {
-            res_second += " . ";
-            res_second += cell_.second->Cerealize();
-        }
-        res = res_first + res_second;
-        //        res += " ";
-        //        res += cell_.second->Cerealize();
-        //        res += ")";
-        return res;
-    }
-    std::shared_ptr<Object> Clone() override {
-        if (cell_.first == nullptr) {
-            return nullptr;
-        }
-        auto first_clone = cell_.first->Clone();
-        auto second_clone = cell_.second->Clone();
-        auto cell_clone = std::make_shared<Cell>(Cell(first_clone, second_clone));
-        if (auto nested_cell = dynamic_cast<Cell*>(first_clone.get())) {
-            cell_clone->cell_.first = nested_cell->Clone();
-        }
-        return cell_clone;
-    };
+// Long lists are stored unrolled: up to kSize consecutive elements live in one chunk, and a cell
+// pointing into a chunk is just a view (chunk, index). Views are created lazily by GetSecond,
+// code which walks the whole list should use ListWalker, which steps through chunks without them.
+struct ListChunk {
+    static constexpr size_t kSize = 32;
+
+    std::shared_ptr<Object> items[kSize];
+    size_t size = 0;
+    // what follows the last item: the next chunk's first cell, null or an improper tail
+    std::shared_ptr<Object> next;
+    // list metadata as of items[0], see Cell::Length
+    size_t length = 0;
+    bool proper = false;
+};
+
+// Cells are shared between lists (cons, cdr, list-tail never copy), so they are treated as
+// immutable: ChangeFirst/ChangeSecond modify the cell in place only when the caller holds the
+// sole reference to it, otherwise they leave it alone and return a changed copy.
+// Use them as `cell = cell->ChangeFirst(x)`.
+//
+// Every cell knows the length of the list it starts and whether that list is proper. A cell is
+// created in front of an existing tail, so this is computed in O(1) from the tail, and it never
+// goes stale: the only in-place change is ChangeSecond on an unshared cell, which has no
+// predecessors to update.
+class Cell final : public Object {
+private:
+    friend class ListWalker;
+    friend class FrozenSegment;
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& v) override {
-        throw SyntaxError("cay not apply");
-    }
-    std::shared_ptr<Object> Calculate() override {
-        auto first = cell_.first->Calculate();
-        if (auto symbol = dynamic_cast<Symbol*>(first.get())) {
-            // найти соответствующую функцию и применить ее ко второму элементу пары
-        } else if (auto nested_cell = dynamic_cast<Cell*>(first.get())) {
-            // вызвать метод Calculate для вложенной ячейки и применить его результат к второму
-            // элементу пары
-            auto result = nested_cell->Calculate();
+    std::pair<std::shared_ptr<Object>, std::shared_ptr<Object>> cell_;
+    // set for views into an unrolled list, cell_ is empty then
+    std::shared_ptr<ListChunk> chunk_;
+    size_t index_ = 0;
+    size_t length_ = 1;
+    bool proper_ = false;
+
+    // Cells of a FrozenSegment have no owner at all, they count as shared
+    bool IsShared() const {
+        return chunk_ != nullptr || weak_from_this().use_count() != 1;
+    }
+
+    void CountTail() {
+        auto tail = Unquote(cell_.second);
+        if (tail == nullptr) {
+            length_ = 1;
+            proper_ = true;
+        } else if (auto cell = As<Cell>(tail)) {
+            length_ = cell->Length() + 1;
+            proper_ = cell->IsProperList();
         } else {
-            throw SyntaxError("invalid expression");
+            length_ = 1;
+            proper_ = false;
         }
     }
-};
 
-class AddFunction : public Object {
 public:
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) override {
-        double sum = 0;
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Number>(el)) {
-                sum += num->GetValue();
-            } else {
-                throw RuntimeError("Invalid argument type for addition");
-            }
-        }
-        return std::make_shared<Number>(sum);
-    }
-    std::string Cerealize() override {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() override {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() override {
-        throw SyntaxError("can't calculate");
-    };
-};
+    static constexpr ObjectKind kKind = ObjectKind::kCell;
 
-class DecreaseFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
+    Cell(std::shared_ptr<Object> head, std::shared_ptr<Object> tail)
+        : Object(kKind), cell_(std::move(head), std::move(tail)) {
+        CountTail();
     };
+    Cell(std::shared_ptr<ListChunk> chunk, size_t index)
+        : Object(kKind), chunk_(std::move(chunk)), index_(index){};
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        double sum = 0;
-        if (args.empty()) {
-            throw RuntimeError("empty arg_vec for -");
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    sum -= num->GetValue();
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
-        }
-        return std::make_shared<Number>(sum);
-    }
-};
-
-class MultiplyFunction : public Object {
-public:
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        double sum = 1;
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Number>(el)) {
-                sum *= num->GetValue();
-            } else {
-                throw RuntimeError("Invalid argument type for addition");
-            }
+    // Number of cells in the cdr chain starting here, i.e. the length of a proper list
+    size_t Length() const {
+        if (chunk_) {
+            return chunk_->length - index_;
         }
-        return std::make_shared<Number>(sum);
+        return length_;
     }
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-};
-
-class DivedeFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        double sum = 0;
-        if (args.empty()) {
-            throw RuntimeError("empty arg_vec for -");
+    // Whether the cdr chain ends with the empty list
+    bool IsProperList() const {
+        if (chunk_) {
+            return chunk_->proper;
         }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    sum /= num->GetValue();
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
-        }
-        return std::make_shared<Number>(sum);
+        return proper_;
     }
-};
-
-class MaxFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            throw RuntimeError("empty arg_vec for -");
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum = num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum < num->GetValue()) {
-                        sum = num->GetValue();
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("Invalid argument type for max/min");
+    std::shared_ptr<Object> GetFirst() const {
+        if (chunk_) {
+            return chunk_->items[index_];
         }
-        return std::make_shared<Number>(sum);
-    }
-};
-
-class MinFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
+        return cell_.first;
     };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            throw RuntimeError("empty arg_vec for -");
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum = num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum > num->GetValue()) {
-                        sum = num->GetValue();
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
+    std::shared_ptr<Object> GetSecond() const {
+        if (chunk_) {
+            if (index_ + 1 < chunk_->size) {
+                return std::make_shared<Cell>(chunk_, index_ + 1);
             }
-        } else {
-            throw RuntimeError("Invalid argument type for max/min");
+            return chunk_->next;
         }
-        return std::make_shared<Number>(sum);
-    }
-};
-
-class IsSymbol : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
+        return cell_.second;
     };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            throw RuntimeError("no arguments");
+    std::shared_ptr<Cell> ChangeFirst(std::shared_ptr<Object> f) {
+        if (IsShared()) {
+            return std::make_shared<Cell>(std::move(f), GetSecond());
         }
-        bool is_symbol = true;
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Symbol>(el)) {
-                continue;
-            } else {
-                is_symbol = false;
-                return std::make_shared<Boolean>(false);
-            }
-        }
-        return std::make_shared<Boolean>(true);
+        cell_.first = std::move(f);
+        return std::static_pointer_cast<Cell>(shared_from_this());
     }
-};
-
-class IsNumber : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            throw RuntimeError("no arguments");
-        }
-        bool is_numb = true;
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Number>(el)) {
-                continue;
-            } else {
-                is_numb = false;
-                return std::make_shared<Boolean>(is_numb);
-            }
+    std::shared_ptr<Cell> ChangeSecond(std::shared_ptr<Object> s) {
+        if (IsShared()) {
+            return std::make_shared<Cell>(GetFirst(), std::move(s));
         }
-        return std::make_shared<Boolean>(is_numb);
+        cell_.second = std::move(s);
+        CountTail();
+        return std::static_pointer_cast<Cell>(shared_from_this());
     }
-};
 
-class IsBool : public Object {
-    std::string Cerealize() override {
-        throw SyntaxError("can't cerealize func");
-    };
+    std::string Cerealize() override;  // printer.cpp
     std::shared_ptr<Object> Clone() override {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() override {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) override {
-        if (args.empty()) {
-            throw RuntimeError("no arguments");
+        if (chunk_) {
+            return std::make_shared<Cell>(chunk_, index_);
         }
-        bool is_numb = true;
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Boolean>(el)) {
-                continue;
-            } else {
-                is_numb = false;
-                return std::make_shared<Boolean>(is_numb);
-            }
-        }
-        return std::make_shared<Boolean>(is_numb);
-    }
-};
-
-class IntAbsFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
+        return std::make_shared<Cell>(cell_.first, cell_.second);
     };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        size_t sum = 0;
-        if (args.empty() || (args.size() > 1)) {
-            throw RuntimeError("empty arg_vec for -");
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            if (num->GetValue() < 0) {
-                sum = (-1) * num->GetValue();
-            } else {
-                sum = num->GetValue();
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
-        }
-        return std::make_shared<Number>(sum);
+    std::shared_ptr<Object> Apply(Args v) override {
+        throw SyntaxError("cay not apply");
     }
-};
-
-class EqualFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum == num->GetValue()) {
-                        continue;
-                    } else {
-                        return std::make_shared<Boolean>(false);
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
+    std::shared_ptr<Object> Calculate() override {
+        auto first = GetFirst()->Calculate();
+        if (auto symbol = dynamic_cast<Symbol*>(first.get())) {
+            // найти соответствующую функцию и применить ее ко второму элементу пары
+        } else if (auto nested_cell = dynamic_cast<Cell*>(first.get())) {
+            // вызвать метод Calculate для вложенной ячейки и применить его результат к второму
+            // элементу пары
+            auto result = nested_cell->Calculate();
         } else {
-            throw RuntimeError("unvalid arg");
+            throw SyntaxError("invalid expression");
         }
-        return std::make_shared<Boolean>(true);
     }
 };
 
-class GreaterFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum > num->GetValue()) {
-                        continue;
-                    } else {
-                        return std::make_shared<Boolean>(false);
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
-        }
-        return std::make_shared<Boolean>(true);
+// Walks a list element by element. Inside unrolled chunks it just moves an index, so no views
+// are allocated and the elements are read from contiguous memory.
+class ListWalker {
+public:
+    explicit ListWalker(std::shared_ptr<Object> list) {
+        Enter(std::move(list));
     }
-};
-
-class GreaterEqFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum >= num->GetValue()) {
-                        continue;
-                    } else {
-                        return std::make_shared<Boolean>(false);
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
-        }
-        return std::make_shared<Boolean>(true);
+    // false when the list is over: Rest() is null or the tail of an improper list then
+    bool AtCell() const {
+        return chunk_ != nullptr || cell_ != nullptr;
     }
-};
-
-class LessFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum < num->GetValue()) {
-                        continue;
-                    } else {
-                        return std::make_shared<Boolean>(false);
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
-            }
-        } else {
-            throw RuntimeError("unvalid arg");
+    const std::shared_ptr<Object>& Head() const {
+        if (chunk_) {
+            return chunk_->items[index_];
         }
-        return std::make_shared<Boolean>(true);
+        return cell_->cell_.first;
     }
-};
-
-class LessEqFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        long long sum = 0;
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Number>(args[0])) {
-            sum += num->GetValue();
-            for (size_t i = 1; i < args.size(); ++i) {
-                if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                    if (sum <= num->GetValue()) {
-                        continue;
-                    } else {
-                        return std::make_shared<Boolean>(false);
-                    }
-                } else {
-                    throw RuntimeError("Invalid argument type for addition");
-                }
+    // Each element is a step of the budget, see budget.h
+    void Next() {
+        SpendFuel();
+        if (chunk_) {
+            if (++index_ < chunk_->size) {
+                return;
             }
+            Enter(chunk_->next);
         } else {
-            throw RuntimeError("unvalid arg");
+            Enter(cell_->cell_.second);
         }
-        return std::make_shared<Boolean>(true);
     }
-};
 
-class NotFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 1) {
-            throw RuntimeError("а что отрацато-то? ну или слишком много аргументов");
-        }
-        if (Is<Number>(args[0])) {
-            return std::make_shared<Boolean>(false);
-        }
-        if (auto num = std::dynamic_pointer_cast<Boolean>(args[0])) {
-            return std::make_shared<Boolean>(!(num->GetValue()));
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            if (num->GetObject() == nullptr) {
-                return std::make_shared<Boolean>(false);
-            } else {
-                return std::make_shared<Boolean>(true);
-            }
-        }
-
-        throw RuntimeError("не те аргументы");
-    }
-};
-
-class AndFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Number>(el)) {
-                continue;
-            } else if (auto num = std::dynamic_pointer_cast<Boolean>(el)) {
-                if (num->GetValue() == false) {
-                    return std::make_shared<Boolean>(false);
-                }
-            } else if (auto num = std::dynamic_pointer_cast<Quote>(el)) {
-                if (num->GetObject() == nullptr) {
-                    return std::make_shared<Boolean>(false);
-                } else {
-                    continue;
-                }
+    // Moves n elements forward, skipping whole chunks at once. They are n steps of the budget
+    // whatever the list is made of. Returns false if the list is over before that.
+    bool Skip(size_t n) {
+        SpendFuel(n);
+        while (n > 0 && AtCell()) {
+            if (chunk_ && index_ + n < chunk_->size) {
+                index_ += n;
+                return true;
             }
-        }
-        auto final = args[args.size() - 1];
-        if (auto num = std::dynamic_pointer_cast<Boolean>(final)) {
-            if (num->GetValue() == false) {
-                return std::make_shared<Boolean>(false);
+            if (chunk_) {
+                n -= chunk_->size - index_;
+                Enter(chunk_->next);
             } else {
-                return std::make_shared<Boolean>(true);
+                Enter(cell_->cell_.second);
+                --n;
             }
-        } else if (auto num = std::dynamic_pointer_cast<Number>(final)) {
-            return std::make_shared<Number>(num->GetValue());
-        } else if (auto num = std::dynamic_pointer_cast<Symbol>(final)) {
-            return std::make_shared<Symbol>(num->GetName());
-        } else if (auto num = std::dynamic_pointer_cast<Quote>(final)) {
-            return std::make_shared<Quote>(num->GetObject());
         }
+        return n == 0;
     }
-};
-
-class OrFunction : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            return std::make_shared<Boolean>(false);
+    // The list from the current position on
+    std::shared_ptr<Object> Rest() const {
+        if (chunk_) {
+            return std::make_shared<Cell>(chunk_, index_);
         }
-
-        for (auto el : args) {
-            if (auto num = std::dynamic_pointer_cast<Number>(el)) {
-                continue;
-            } else if (auto num = std::dynamic_pointer_cast<Boolean>(el)) {
-                if (num->GetValue() == true) {
-                    return std::make_shared<Boolean>(true);
-                }
-            } else if (auto num = std::dynamic_pointer_cast<Quote>(el)) {
-                if (num->GetObject() != nullptr) {
-                    return std::make_shared<Boolean>(true);
-                } else {
-                    continue;
-                }
-            }
-        }
-        auto final = args[args.size() - 1];
-        if (auto num = std::dynamic_pointer_cast<Boolean>(final)) {
-            if (num->GetValue() == true) {
-                return std::make_shared<Boolean>(true);
-            } else {
-                return std::make_shared<Boolean>(false);
-            }
-        } else if (auto num = std::dynamic_pointer_cast<Number>(final)) {
-            return std::make_shared<Number>(num->GetValue());
-        } else if (auto num = std::dynamic_pointer_cast<Symbol>(final)) {
-            return std::make_shared<Symbol>(num->GetName());
-        } else if (auto num = std::dynamic_pointer_cast<Quote>(final)) {
-            return std::make_shared<Quote>(num->GetObject());
+        if (cell_) {
+            return cell_;
         }
+        return tail_;
     }
-};
 
-class IsPair : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 1) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            auto p = num->GetObject();
-            if (p != nullptr) {
-                return std::make_shared<Boolean>(true);
-            } else {
-                return std::make_shared<Boolean>(false);
-            }
-        } else if (auto num = std::dynamic_pointer_cast<Cell>(args[0])) {
-            if (num->GetFirst() != nullptr) {
-                return std::make_shared<Boolean>(true);
-            } else {
-                return std::make_shared<Boolean>(false);
-            }
+private:
+    void Enter(std::shared_ptr<Object> list) {
+        // list may point into the chunk or the cell being left, so it is taken by value
+        list = Unquote(std::move(list));
+        auto cell = As<Cell>(list);
+        if (cell == nullptr) {
+            tail_ = std::move(list);
+            chunk_ = nullptr;
+            cell_ = nullptr;
+        } else if (cell->chunk_) {
+            chunk_ = cell->chunk_;
+            index_ = cell->index_;
+            cell_ = nullptr;
         } else {
-            return std::make_shared<Boolean>(false);
+            cell_ = std::move(cell);
+            chunk_ = nullptr;
         }
     }
+
+    std::shared_ptr<Cell> cell_;
+    std::shared_ptr<ListChunk> chunk_;
+    size_t index_ = 0;
+    std::shared_ptr<Object> tail_;
 };
 
-class IsNull : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
+// Collects elements front to back and builds a list out of them, unrolled into chunks when
+// there are at least kUnrollFrom elements.
+class ListBuilder {
+public:
+    static constexpr size_t kUnrollFrom = ListChunk::kSize;
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.size() > 1) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (args.empty()) {
-            return std::make_shared<Boolean>(true);
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            auto p = num->GetObject();
-            if (p != nullptr) {
-                return std::make_shared<Boolean>(false);
-            } else {
-                return std::make_shared<Boolean>(true);
-            }
-        } else if (auto num = std::dynamic_pointer_cast<Cell>(args[0])) {
-            if (num->GetFirst() != nullptr) {
-                return std::make_shared<Boolean>(false);
-            } else {
-                return std::make_shared<Boolean>(true);
-            }
-        } else {
-            return std::make_shared<Boolean>(false);
-        }
+    void Add(std::shared_ptr<Object> obj) {
+        items_.push_back(std::move(obj));
     }
-};
-
-class IsList : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 1) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            auto p = num->GetObject();
-            if (p == nullptr) {
-                return std::make_shared<Boolean>(true);
-            } else {
-                auto first = As<Cell>(p)->GetFirst();
-                auto second = As<Cell>(p)->GetSecond();
-                if (Is<Cell>(second)) {
-                    while (second && Is<Cell>(second)) {
-                        if (Is<Cell>(second)) {
-                            second = As<Cell>(second)->GetSecond();
-                        } else {
-                            return std::make_shared<Boolean>(false);
-                        }
-                    }
-                    if (second != nullptr) {
-                        return std::make_shared<Boolean>(false);
-                    }
-                    return std::make_shared<Boolean>(true);
-                }
-                return std::make_shared<Boolean>(false);
-            }
-        } else if (auto num = std::dynamic_pointer_cast<Cell>(args[0])) {
-            if (num->GetFirst() == nullptr) {
-                return std::make_shared<Boolean>(true);
-            } else {
-                return std::make_shared<Boolean>(true);
+    std::shared_ptr<Object> Build(std::shared_ptr<Object> tail = nullptr) {
+        std::shared_ptr<Object> list = std::move(tail);
+        if (items_.size() < kUnrollFrom) {
+            for (auto it = items_.rbegin(); it != items_.rend(); ++it) {
+                list = std::make_shared<Cell>(std::move(*it), std::move(list));
             }
         } else {
-            return std::make_shared<Boolean>(false);
+            size_t end = items_.size();
+            size_t begin = (end - 1) / ListChunk::kSize * ListChunk::kSize;
+            while (end > 0) {
+                auto chunk = std::make_shared<ListChunk>();
+                std::move(items_.begin() + begin, items_.begin() + end, chunk->items);
+                chunk->size = end - begin;
+                chunk->length = chunk->size;
+                chunk->proper = list == nullptr;
+                if (auto cell = As<Cell>(Unquote(list))) {
+                    chunk->length += cell->Length();
+                    chunk->proper = cell->IsProperList();
+                }
+                chunk->next = std::move(list);
+                list = std::make_shared<Cell>(std::move(chunk), 0);
+                end = begin;
+                begin = end < ListChunk::kSize ? 0 : end - ListChunk::kSize;
+            }
         }
+        items_.clear();
+        return list;
     }
-};
-
-class MakePair : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            throw RuntimeError("no or too many arguments");
-        }
-        auto first = args[0];
-        std::shared_ptr<Object> second = nullptr;
-        for (size_t i = 1; i < args.size(); ++i) {
-            second = args[i];
-        }
-        return std::make_shared<Cell>(first, second);
-    }
+private:
+    std::vector<std::shared_ptr<Object>> items_;
 };
 
-class GetFirst : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 1) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            auto p = num->GetObject();
-            if (p == nullptr) {
-                throw RuntimeError("can not understand");
-            } else if (auto n = std::dynamic_pointer_cast<Cell>(p)) {
-                return n->GetFirst();
-            }
-        }
+// Numbers are 64-bit integers, a result which does not fit is an error rather than a wrap-around
+inline int64_t CheckedAdd(int64_t a, int64_t b) {
+    int64_t res;
+    if (__builtin_add_overflow(a, b, &res)) {
+        throw RuntimeError("integer overflow");
     }
-};
-
-class GetSecond : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
+    return res;
+}
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 1) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            auto p = num->GetObject();
-            if (p == nullptr) {
-                throw RuntimeError("can not understand");
-            } else if (auto n = std::dynamic_pointer_cast<Cell>(p)) {
-                return n->GetSecond();
-            }
-        }
+inline int64_t CheckedSub(int64_t a, int64_t b) {
+    int64_t res;
+    if (__builtin_sub_overflow(a, b, &res)) {
+        throw RuntimeError("integer overflow");
     }
-};
-
-class MakeList : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty()) {
-            return nullptr;
-        }
-        auto first = args[0];
-        if (args.size() == 1) {
-            return std::make_shared<Cell>(first, nullptr);
-        }
-        auto second = std::make_shared<Cell>(nullptr, nullptr);
-        auto ter = second;
-        for (size_t i = 1; i < args.size(); i += 2) {
-            if (auto num = std::dynamic_pointer_cast<Number>(args[i])) {
-                auto f = std::make_shared<Number>(num->GetValue());
-                ter->ChangeFirst(f);
-            } else if (auto sym = std::dynamic_pointer_cast<Symbol>(args[i])) {
-                ter->ChangeFirst(std::make_shared<Symbol>(sym->GetName()));
-            } else if (auto boolean = std::dynamic_pointer_cast<Boolean>(args[i])) {
-                ter->ChangeFirst(std::make_shared<Boolean>(boolean->GetValue()));
-            }
+    return res;
+}
 
-            auto new_cell = std::make_shared<Cell>(args[i + 1], nullptr);
-            ter->ChangeSecond(new_cell);
-            ter = new_cell;
-        }
-        return std::make_shared<Cell>(first, second);
+inline int64_t CheckedMul(int64_t a, int64_t b) {
+    int64_t res;
+    if (__builtin_mul_overflow(a, b, &res)) {
+        throw RuntimeError("integer overflow");
     }
-};
-
-class GetListElem : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
+    return res;
+}
 
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 2) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            if (auto n = std::dynamic_pointer_cast<Number>(args[1])) {
-                int ind = n->GetValue();
-                auto ast = num->GetObject();
-                if (auto cell = std::dynamic_pointer_cast<Cell>(ast)) {
-                    auto fin = cell->GetSecond();
-                    int i = 1;
-                    if (ind == 0) {
-                        return cell->GetFirst();
-                    }
-                    while (fin != nullptr) {
-                        if (auto cur = std::dynamic_pointer_cast<Cell>(fin)) {
-                            if (i == ind) {
-                                if (auto ans = std::dynamic_pointer_cast<Number>(cur->GetFirst())) {
-                                    return std::make_shared<Number>(ans->GetValue());
-                                } else if (auto ans = std::dynamic_pointer_cast<Boolean>(
-                                               cur->GetFirst())) {
-                                    return std::make_shared<Boolean>(ans->GetValue());
-                                } else if (auto ans =
-                                               std::dynamic_pointer_cast<Symbol>(cur->GetFirst())) {
-                                    return std::make_shared<Symbol>(ans->GetName());
-                                } else {
-                                    throw RuntimeError("кринжанула");
-                                }
-                            }
-                            ++i;
-                            fin = cur->GetSecond();
-                        }
-                        if (ind > i) {
-                            throw RuntimeError("кринжанула");
-                        }
-                    }
-                } else {
-                    if (ind != 0) {
-                        throw RuntimeError("invslid index");
-                    } else {
-                        return ast;
-                    }
-                }
-            }
-        }
+inline int64_t CheckedDiv(int64_t a, int64_t b) {
+    if (b == 0) {
+        throw RuntimeError("division by zero");
     }
-};
-
-class GetListTail : public Object {
-    std::string Cerealize() {
-        throw SyntaxError("can't cerealize func");
-    };
-    std::shared_ptr<Object> Clone() {
-        throw SyntaxError("can't clone func");
-    };
-    std::shared_ptr<Object> Calculate() {
-        throw SyntaxError("can't calculate");
-    };
-
-    std::shared_ptr<Object> Apply(const std::vector<std::shared_ptr<Object>>& args) {
-        if (args.empty() || args.size() > 2) {
-            throw RuntimeError("no or too many arguments");
-        }
-        if (auto num = std::dynamic_pointer_cast<Quote>(args[0])) {
-            if (auto n = std::dynamic_pointer_cast<Number>(args[1])) {
-                int ind = n->GetValue();
-                auto ast = num->GetObject();
-                if (auto cell = std::dynamic_pointer_cast<Cell>(ast)) {
-                    auto fin = cell->GetSecond();
-                    int i = 1;
-                    if (ind == 0) {
-                        return ast;
-                    }
-
-                    while (fin != nullptr) {
-                        if (auto cur = std::dynamic_pointer_cast<Cell>(fin)) {
-                            if (i == ind) {
-                                return fin;
-                            }
-                            ++i;
-                            fin = cur->GetSecond();
-                        }
-                        if (ind - 1 == i) {
-                            return nullptr;
-                        } else if (ind > i) {
-                            throw RuntimeError("кринжанула");
-                        }
-                    }
-                } else {
-                    if (ind != 0) {
-                        throw RuntimeError("invslid index");
-                    } else {
-                        return ast;
-                    }
-                }
-            }
-        }
+    if (b == -1 && a == std::numeric_limits<int64_t>::min()) {
+        throw RuntimeError("integer overflow");
     }
-};
+    return a / b;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
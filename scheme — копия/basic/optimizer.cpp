@@ -0,0 +1,343 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "builtins.h"
+#include "printer.h"
+#include "special_forms.h"
+
+namespace {
+
+// Literals can be moved around or dropped: evaluating them has no effects and never fails.
+// Symbols are not literals, they are names.
+bool IsLiteral(const std::shared_ptr<Object>& obj) {
+    return !Is<Cell>(obj) && !Is<Symbol>(obj);
+}
+
+// define is not an expression: taken out of an if, it would be evaluated rather than fail
+bool IsDefinition(const std::shared_ptr<Object>& obj) {
+    std::string name;
+    try {
+        return FindDefinition(obj, &name);
+    } catch (const SyntaxError&) {
+        return true;
+    }
+}
+
+// The value of and/or with evaluated operands
+std::shared_ptr<Object> ShortCircuit(bool is_and, const std::vector<std::shared_ptr<Object>>& args) {
+    for (const auto& arg : args) {
+        if (is_and ? StopsAnd(arg) : StopsOr(arg)) {
+            return MakeBool(!is_and);
+        }
+    }
+    return args.empty() ? MakeBool(is_and) : args.back();
+}
+
+std::shared_ptr<Object> MakeCall(const std::shared_ptr<Object>& head,
+                                  const std::vector<std::shared_ptr<Object>>& args,
+                                  std::shared_ptr<Object> tail) {
+    ListBuilder builder;
+    builder.Add(head);
+    for (const auto& arg : args) {
+        builder.Add(arg);
+    }
+    return builder.Build(std::move(tail));
+}
+
+std::shared_ptr<Object> MakeList(const std::vector<std::shared_ptr<Object>>& items) {
+    ListBuilder builder;
+    for (const auto& item : items) {
+        builder.Add(item);
+    }
+    return builder.Build();
+}
+
+std::string Show(const std::shared_ptr<Object>& obj) {
+    std::string res;
+    Printer().Print(obj, &res);
+    return res;
+}
+
+std::string Show(const std::string& name, const std::vector<std::shared_ptr<Object>>& args) {
+    return Show(MakeCall(std::make_shared<Symbol>(name), args, nullptr));
+}
+
+}  // namespace
+
+std::shared_ptr<Object> Optimizer::Optimize(const std::shared_ptr<Object>& ast) {
+    changes_.clear();
+    bound_.clear();
+    return Rewrite(ast);
+}
+
+std::shared_ptr<Object> Optimizer::Rewrite(const std::shared_ptr<Object>& obj) {
+    auto cell = As<Cell>(obj);
+    if (cell == nullptr) {
+        return obj;
+    }
+    auto symbol = As<Symbol>(cell->GetFirst());
+    SpecialForm form;
+    if (symbol != nullptr && FindSpecialForm(symbol->GetName(), &form)) {
+        return RewriteSpecialForm(cell, form);
+    }
+    if (symbol == nullptr && !Is<Cell>(cell->GetFirst())) {
+        return obj;
+    }
+    // про вызываемую процедуру ничего не известно, переписываются только аргументы
+    if (symbol == nullptr || IsBound(symbol->GetName()) ||
+        FindBuiltin(symbol->GetName()) == nullptr) {
+        std::vector<std::shared_ptr<Object>> items;
+        std::shared_ptr<Object> tail;
+        if (!RewriteAll(obj, &items, &tail)) {
+            return obj;
+        }
+        return MakeCall(items[0], {items.begin() + 1, items.end()}, std::move(tail));
+    }
+    const auto& name = symbol->GetName();
+
+    std::vector<std::shared_ptr<Object>> args;
+    std::shared_ptr<Object> tail;
+    bool changed = RewriteAll(cell->GetSecond(), &args, &tail);
+
+    size_t count = changes_.size();
+    Flatten(name, &args);
+    DropOperands(name, &args);
+    changed = changed || changes_.size() != count;
+
+    if (auto value = Fold(name, args)) {
+        return value;
+    }
+    if (!changed) {
+        return obj;
+    }
+    return MakeCall(cell->GetFirst(), args, std::move(tail));
+}
+
+// Malformed special forms are left for the compiler to report.
+std::shared_ptr<Object> Optimizer::RewriteSpecialForm(const std::shared_ptr<Cell>& cell,
+                                                      SpecialForm form) {
+    SpecialFormSyntax syntax;
+    try {
+        syntax = ParseSpecialForm(form, cell->GetSecond());
+    } catch (const SyntaxError&) {
+        return cell;
+    }
+    const auto& name = As<Symbol>(cell->GetFirst())->GetName();
+    std::vector<std::shared_ptr<Object>> args;
+    bool changed = false;
+    if (syntax.lambda) {
+        for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next()) {
+            args.push_back(it.Head());
+        }
+        try {
+            changed = RewriteBindingForm(syntax, &args);
+        } catch (const SyntaxError&) {
+            return cell;
+        }
+    } else if (form == SpecialForm::kDefine) {
+        changed = RewriteAll(cell->GetSecond(), &args);
+    } else if (form == SpecialForm::kCond) {
+        // the clauses are lists of expressions
+        for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next()) {
+            std::vector<std::shared_ptr<Object>> items;
+            if (RewriteAll(it.Head(), &items)) {
+                changed = true;
+                args.push_back(MakeList(items));
+            } else {
+                args.push_back(it.Head());
+            }
+        }
+    } else {
+        changed = RewriteAll(cell->GetSecond(), &args);
+    }
+
+    if (form == SpecialForm::kAnd || form == SpecialForm::kOr) {
+        size_t count = changes_.size();
+        DropOperands(name, &args);
+        changed = changed || changes_.size() != count;
+        if (auto value = Fold(name, args)) {
+            return value;
+        }
+    }
+    if (form == SpecialForm::kIf && IsLiteral(args[0])) {
+        // the branch which is not taken is never evaluated, the missing one gives the empty list
+        std::shared_ptr<Object> branch = IsTrue(args[0])     ? args[1]
+                                         : args.size() == 3 ? args[2]
+                                                            : nullptr;
+        if (branch != nullptr && !IsDefinition(branch)) {
+            changes_.push_back({OptimizerChange::kBranch, Show(name, args), Show(branch)});
+            return branch;
+        }
+    }
+    if (!changed) {
+        return cell;
+    }
+    return MakeCall(cell->GetFirst(), args, nullptr);
+}
+
+// args are the operands of lambda, let, future or define of a procedure. The values of let are
+// rewritten where the form is, the body where its variables are bound. Throws SyntaxError for a
+// malformed definition in the body.
+bool Optimizer::RewriteBindingForm(const SpecialFormSyntax& syntax,
+                                   std::vector<std::shared_ptr<Object>>* args) {
+    bool changed = false;
+    // the operand of future is its body
+    size_t body = syntax.form == SpecialForm::kFuture ? 0 : 1;
+    if (syntax.form == SpecialForm::kDefine && !Is<Cell>((*args)[0])) {
+        // (define f (lambda ...))
+        auto value = Rewrite((*args)[1]);
+        changed = value != (*args)[1];
+        (*args)[1] = std::move(value);
+        return changed;
+    }
+    auto defined = BodyDefinitions(syntax.lambda->body);
+    if (syntax.form == SpecialForm::kLet) {
+        size_t first = syntax.name.empty() ? 0 : 1;
+        std::vector<std::shared_ptr<Object>> bindings;
+        for (size_t i = 0; i < syntax.operands.size(); ++i) {
+            auto value = Rewrite(syntax.operands[i]);
+            changed = changed || value != syntax.operands[i];
+            bindings.push_back(MakeList({std::make_shared<Symbol>(syntax.lambda->params[i]),
+                                         std::move(value)}));
+        }
+        if (changed) {
+            (*args)[first] = MakeList(bindings);
+        }
+        body = first + 1;
+    }
+
+    size_t mark = bound_.size();
+    bound_.insert(bound_.end(), syntax.lambda->params.begin(), syntax.lambda->params.end());
+    if (!syntax.name.empty() && syntax.form == SpecialForm::kLet) {
+        bound_.push_back(syntax.name);
+    }
+    for (const auto& name : defined) {
+        if (!name.empty()) {
+            bound_.push_back(name);
+        }
+    }
+    for (size_t i = body; i < args->size(); ++i) {
+        auto expression = Rewrite((*args)[i]);
+        changed = changed || expression != (*args)[i];
+        (*args)[i] = std::move(expression);
+    }
+    bound_.resize(mark);
+    return changed;
+}
+
+bool Optimizer::IsBound(const std::string& name) const {
+    return std::find(bound_.begin(), bound_.end(), name) != bound_.end();
+}
+
+// Rewrites the elements of a list into args, returns whether any of them changed
+bool Optimizer::RewriteAll(const std::shared_ptr<Object>& list,
+                           std::vector<std::shared_ptr<Object>>* args,
+                           std::shared_ptr<Object>* tail) {
+    bool changed = false;
+    ListWalker it(list);
+    for (; it.AtCell(); it.Next()) {
+        args->push_back(Rewrite(it.Head()));
+        changed = changed || args->back() != it.Head();
+    }
+    if (tail != nullptr) {
+        *tail = it.Rest();
+    }
+    return changed;
+}
+
+// Only the first operand is merged: the operations are applied from left to right, so other
+// operands would change their order. The errors must stay the same as well, and the arguments of
+// both calls are checked by their positions, after the nested call is checked: the operands after
+// it have to be number literals, which move to other positions but never fail.
+void Optimizer::Flatten(const std::string& name, std::vector<std::shared_ptr<Object>>* args) {
+    if (name != "+" && name != "-" && name != "*" && name != "/" && name != "max" &&
+        name != "min") {
+        return;
+    }
+    // (- x) is x and (/ x) is x, but (max) and (min) fail, so those need an argument
+    bool needs_args = name != "+" && name != "*";
+
+    auto nested = args->empty() ? nullptr : As<Cell>(args->front());
+    auto symbol = nested ? As<Symbol>(nested->GetFirst()) : nullptr;
+    if (symbol == nullptr || symbol->GetName() != name) {
+        return;
+    }
+    for (size_t i = 1; i < args->size(); ++i) {
+        if (!Is<Number>((*args)[i])) {
+            return;
+        }
+    }
+    std::vector<std::shared_ptr<Object>> flat;
+    ListWalker it(nested->GetSecond());
+    for (; it.AtCell(); it.Next()) {
+        flat.push_back(it.Head());
+    }
+    if (it.Rest() != nullptr || (needs_args && flat.empty())) {
+        return;
+    }
+    flat.insert(flat.end(), args->begin() + 1, args->end());
+    changes_.push_back({OptimizerChange::kFlatten, Show(name, *args), Show(name, flat)});
+    *args = std::move(flat);
+}
+
+// Literal operands which do not decide the result can go unless they are the last one, which is
+// the result. Once a literal decides the result, the operands after it are never evaluated.
+void Optimizer::DropOperands(const std::string& name, std::vector<std::shared_ptr<Object>>* args) {
+    bool is_and = name == "and";
+    if (!is_and && name != "or") {
+        return;
+    }
+    std::vector<std::shared_ptr<Object>> kept;
+    bool decided = false;
+    for (size_t i = 0; i < args->size(); ++i) {
+        const auto& arg = (*args)[i];
+        if (decided) {
+            break;
+        }
+        if (IsLiteral(arg)) {
+            if (is_and ? StopsAnd(arg) : StopsOr(arg)) {
+                decided = true;
+            } else if (i + 1 < args->size()) {
+                continue;
+            }
+        }
+        kept.push_back(arg);
+    }
+    if (kept.size() != args->size()) {
+        changes_.push_back({OptimizerChange::kDropOperands, Show(name, *args), Show(name, kept)});
+        *args = std::move(kept);
+    }
+}
+
+// Only numbers and booleans are folded: they are the values which mean the same when they are
+// put back into the AST as literals.
+std::shared_ptr<Object> Optimizer::Fold(const std::string& name,
+                                        const std::vector<std::shared_ptr<Object>>& args) {
+    bool is_short_circuit = name == "and" || name == "or";
+    if (!is_short_circuit && !IsPureBuiltin(name)) {
+        return nullptr;
+    }
+    for (const auto& arg : args) {
+        if (!IsLiteral(arg)) {
+            return nullptr;
+        }
+    }
+    std::shared_ptr<Object> value;
+    if (is_short_circuit) {
+        value = ShortCircuit(name == "and", args);
+    } else {
+        try {
+            value = FindBuiltin(name)->Apply(args);
+        } catch (const std::runtime_error&) {
+            // the error is raised when the expression is executed
+            return nullptr;
+        }
+    }
+    if (!Is<Number>(value) && !Is<Boolean>(value)) {
+        return nullptr;
+    }
+    changes_.push_back({OptimizerChange::kFold, Show(name, args), Show(value)});
+    return value;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "object.h"
+#include "special_forms.h"
+
+// One rewrite done by the optimizer, the expressions are printed.
+struct OptimizerChange {
+    enum Kind {
+        kFold,          // a call to a pure builtin with literal arguments replaced by its value
+        kDropOperands,  // operands of and/or which can not change the result removed
+        kFlatten,       // nested arithmetic merged into one n-ary call
+        kBranch,        // an if with a literal test replaced by the branch it takes
+    };
+
+    Kind kind;
+    std::string before;
+    std::string after;
+};
+
+// Rewrites parsed expressions into cheaper ones with the same results and errors:
+//  - calls to pure builtins whose arguments are literals are evaluated once, if they succeed
+//    and give a number or a boolean;
+//  - literal operands of and/or which can not change the result are dropped, and so are the
+//    operands after a literal which decides it;
+//  - an if whose test is a literal becomes the branch it takes;
+//  - (+ (+ a b) 1 2) becomes (+ a b 1 2), the same for - * / max min: only a nested call in
+//    the first operand is merged, and only when the other operands are number literals, which
+//    keeps the order the operations are done in and the errors they give.
+// Variables may shadow builtins: calls through them, and of procedures, only get their arguments
+// rewritten. So do the bodies of lambda, let and define, and the values of let.
+// The AST is not modified, changed calls are rebuilt and everything else is shared.
+class Optimizer {
+public:
+    std::shared_ptr<Object> Optimize(const std::shared_ptr<Object>& ast);
+
+    // Rewrites done by the last Optimize, innermost first
+    const std::vector<OptimizerChange>& Changes() const {
+        return changes_;
+    }
+
+private:
+    std::shared_ptr<Object> Rewrite(const std::shared_ptr<Object>& obj);
+    std::shared_ptr<Object> RewriteSpecialForm(const std::shared_ptr<Cell>& cell, SpecialForm form);
+    bool RewriteBindingForm(const SpecialFormSyntax& syntax,
+                            std::vector<std::shared_ptr<Object>>* args);
+    bool IsBound(const std::string& name) const;
+    bool RewriteAll(const std::shared_ptr<Object>& list, std::vector<std::shared_ptr<Object>>* args,
+                    std::shared_ptr<Object>* tail = nullptr);
+    void Flatten(const std::string& name, std::vector<std::shared_ptr<Object>>* args);
+    void DropOperands(const std::string& name, std::vector<std::shared_ptr<Object>>* args);
+    std::shared_ptr<Object> Fold(const std::string& name,
+                                 const std::vector<std::shared_ptr<Object>>& args);
+
+    std::vector<OptimizerChange> changes_;
+    // The lexical variables where the expression being rewritten is, innermost last
+    std::vector<std::string> bound_;
+};
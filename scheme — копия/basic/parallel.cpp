@@ -0,0 +1,139 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "budget.h"
+#include "printer.h"
+
+namespace {
+
+// A few ranges per worker, so the ones which are done early can steal the rest
+constexpr size_t kRangesPerWorker = 4;
+
+struct ParallelState {
+    explicit ParallelState(size_t ranges) : remaining(ranges), errors(ranges) {
+    }
+
+    std::atomic<size_t> remaining;
+    std::atomic<size_t> failed = std::numeric_limits<size_t>::max();
+    std::vector<std::exception_ptr> errors;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+// Runs the queued tasks of SharedPool, ours or not, until done() is true, and sleeps only when
+// there are none: then the tasks done() waits for are running already. done() is checked under
+// the mutex, cv is notified under it.
+template <class Done>
+void HelpUntil(std::mutex* mutex, std::condition_variable* cv, Done done) {
+    while (true) {
+        {
+            std::lock_guard lock(*mutex);
+            if (done()) {
+                return;
+            }
+        }
+        if (!SharedPool().RunPending()) {
+            std::unique_lock lock(*mutex);
+            cv->wait(lock, done);
+            return;
+        }
+    }
+}
+
+}  // namespace
+
+WorkStealingPool& SharedPool() {
+    static WorkStealingPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    return pool;
+}
+
+void ParallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    auto& pool = SharedPool();
+    grain = std::max<size_t>(grain, 1);
+    size_t ranges = std::min((size + grain - 1) / grain, pool.Size() * kRangesPerWorker);
+    if (ranges <= 1) {
+        if (size > 0) {
+            body(0, size);
+        }
+        return;
+    }
+
+    // the tasks may finish after ParallelFor has returned, so they share the state. They run
+    // under the limits of the caller: once it is interrupted, so are they.
+    auto state = std::make_shared<ParallelState>(ranges);
+    auto budget = BudgetScope::Current();
+    auto run = [state, budget, &body, size, ranges](size_t index) {
+        if (index < state->failed) {
+            try {
+                BudgetScope scope(budget);
+                body(size * index / ranges, size * (index + 1) / ranges);
+            } catch (...) {
+                state->errors[index] = std::current_exception();
+                size_t failed = state->failed;
+                while (index < failed && !state->failed.compare_exchange_weak(failed, index)) {
+                }
+            }
+        }
+        std::lock_guard lock(state->mutex);
+        if (--state->remaining == 0) {
+            state->done.notify_all();
+        }
+    };
+    for (size_t i = 1; i < ranges; ++i) {
+        pool.Submit([run, i](size_t) { run(i); });
+    }
+    run(0);
+    HelpUntil(&state->mutex, &state->done, [&state] { return state->remaining == 0; });
+    size_t failed = state->failed;
+    if (failed < ranges) {
+        std::rethrow_exception(state->errors[failed]);
+    }
+}
+
+std::shared_ptr<Future> Future::Spawn(std::shared_ptr<Object> thunk) {
+    if (dynamic_cast<Function*>(thunk.get()) == nullptr) {
+        throw RuntimeError("can not apply");
+    }
+    auto future = std::make_shared<Future>();
+    auto budget = BudgetScope::Current();
+    SharedPool().Submit([future, budget, thunk = std::move(thunk)](size_t) {
+        std::shared_ptr<Object> value;
+        std::exception_ptr error;
+        try {
+            BudgetScope scope(budget);
+            value = thunk->Apply({});
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard lock(future->mutex_);
+        future->value_ = std::move(value);
+        future->error_ = std::move(error);
+        future->ready_ = true;
+        future->done_.notify_all();
+    });
+    return future;
+}
+
+std::shared_ptr<Object> Future::Touch() {
+    HelpUntil(&mutex_, &done_, [this] { return ready_; });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    return value_;
+}
+
+std::string Future::Cerealize() {
+    std::string res;
+    Printer().Print(Touch(), &res);
+    return res;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "object.h"
+#include "work_stealing_pool.h"
+
+// The pool the parallel builtins run on, a worker per hardware thread. It is started when it is
+// first used.
+WorkStealingPool& SharedPool();
+
+// Calls body(begin, end) for consecutive ranges covering [0, size), each at least grain long
+// unless size is less, on the threads of SharedPool and on the calling one. Returns when all of
+// them are done. If body throws, the ranges after the one which failed are skipped and the error
+// of the first range which failed is rethrown, the same one every time. The ranges run under the
+// limits of the calling thread, see budget.h.
+void ParallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+// The value of (future expr) and (spawn thunk): the procedure is called as a task of SharedPool
+// and the caller goes on, under the limits of the caller (see budget.h). touch waits for the
+// result; a thread waiting runs the queued tasks meanwhile, so the futures touched by the tasks
+// of the pool can not deadlock it.
+class Future : public Object {
+public:
+    // Throws RuntimeError if thunk is not a procedure or a builtin
+    static std::shared_ptr<Future> Spawn(std::shared_ptr<Object> thunk);
+
+    // The value of the call. Rethrows its error, every time the future is touched.
+    std::shared_ptr<Object> Touch();
+
+    // A future prints as its value
+    std::string Cerealize() override;
+    std::shared_ptr<Object> Clone() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Calculate() override {
+        return shared_from_this();
+    }
+    std::shared_ptr<Object> Apply(Args) override {
+        throw SyntaxError("can not apply");
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable done_;
+    bool ready_ = false;
+    std::shared_ptr<Object> value_;
+    std::exception_ptr error_;
+};
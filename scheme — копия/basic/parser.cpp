@@ -44,16 +44,18 @@ std::shared_ptr<Object> Read(Tokenizer* tokenizer) {
 }
 
 std::shared_ptr<Object> ReadList(Tokenizer* tokenizer) {
-    auto token = tokenizer->GetToken();
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError("is end");
-    }
-    if (std::holds_alternative<BracketToken>(token) &&
-        std::get<BracketToken>(token) == BracketToken::CLOSE) {
-        tokenizer->Next();
-        return nullptr;
-    } else {
-        auto car = Read(tokenizer);
+    ListBuilder list;
+    while (true) {
+        auto token = tokenizer->GetToken();
+        if (tokenizer->IsEnd()) {
+            throw SyntaxError("is end");
+        }
+        if (std::holds_alternative<BracketToken>(token) &&
+            std::get<BracketToken>(token) == BracketToken::CLOSE) {
+            tokenizer->Next();
+            return list.Build();
+        }
+        list.Add(Read(tokenizer));
         token = tokenizer->GetToken();
         if (std::holds_alternative<DotToken>(token)) {
             tokenizer->Next();
@@ -62,13 +64,10 @@ std::shared_ptr<Object> ReadList(Tokenizer* tokenizer) {
             if (std::holds_alternative<BracketToken>(token) &&
                 std::get<BracketToken>(token) == BracketToken::CLOSE) {
                 tokenizer->Next();
-                return std::make_shared<Cell>(car, cdr);
+                return list.Build(cdr);
             } else {
                 throw SyntaxError("expected closing bracket");
             }
-        } else {
-            auto cdr = ReadList(tokenizer);
-            return std::make_shared<Cell>(car, cdr);
         }
     }
 }
@@ -0,0 +1,69 @@
+#include "printer.h"
+
+void Printer::Print(const std::shared_ptr<Object>& obj, std::string* out) {
+    Write(obj, out, nullptr);
+}
+
+void Printer::Print(const std::shared_ptr<Object>& obj, std::ostream* out) {
+    buffer_.clear();
+    Write(obj, &buffer_, out);
+    out->write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+void Printer::Write(const std::shared_ptr<Object>& obj, std::string* out, std::ostream* sink) {
+    stack_.clear();
+    auto cur = Unquote(obj);
+    while (true) {
+        // спускаемся по car-ам, открывая все списки, которые начинаются здесь
+        while (Is<Cell>(cur)) {
+            out->push_back('(');
+            stack_.emplace_back(std::move(cur));
+            cur = Unquote(stack_.back().Head());
+        }
+        if (cur == nullptr) {
+            out->append("()");
+        } else {
+            cur->CerealizeTo(out);
+        }
+        if (sink != nullptr && out->size() >= kFlushSize) {
+            sink->write(out->data(), out->size());
+            out->clear();
+        }
+
+        // закрываем законченные списки, пока не найдём следующий элемент
+        bool has_next = false;
+        while (!stack_.empty() && !has_next) {
+            auto& list = stack_.back();
+            list.Next();
+            if (list.AtCell()) {
+                out->push_back(' ');
+                cur = Unquote(list.Head());
+                has_next = true;
+                continue;
+            }
+            if (auto tail = list.Rest()) {
+                out->append(" . ");
+                tail->CerealizeTo(out);
+            }
+            out->push_back(')');
+            stack_.pop_back();
+        }
+        if (!has_next) {
+            return;
+        }
+    }
+}
+
+// Not shared_from_this(): the objects of a FrozenSegment have no owner
+std::string Quote::Cerealize() {
+    std::string res;
+    Printer().Print(std::shared_ptr<Object>(std::shared_ptr<Object>(), this), &res);
+    return res;
+}
+
+std::string Cell::Cerealize() {
+    std::string res;
+    Printer().Print(std::shared_ptr<Object>(std::shared_ptr<Object>(), this), &res);
+    return res;
+}
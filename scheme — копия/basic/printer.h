@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Iterative serializer: walks car/cdr with an explicit stack instead of recursion and appends
+// straight into the caller's buffer, so a list of n elements is printed in one linear pass.
+// The stack and the staging buffer are kept between calls, one Printer can be reused.
+class Printer {
+public:
+    // Appends the representation of obj to out.
+    void Print(const std::shared_ptr<Object>& obj, std::string* out);
+
+    // Streams the representation of obj to out in chunks of about kFlushSize bytes.
+    void Print(const std::shared_ptr<Object>& obj, std::ostream* out);
+
+    static constexpr size_t kFlushSize = 1 << 16;
+
+private:
+    void Write(const std::shared_ptr<Object>& obj, std::string* out, std::ostream* sink);
+
+    // positions in the lists which are printed right now, the innermost one on top
+    std::vector<ListWalker> stack_;
+    std::string buffer_;
+};
@@ -1,8 +1,16 @@
 #include "scheme.h"
 
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+#include "environment.h"
+#include "special_forms.h"
+
 std::shared_ptr<Object> Interpreter::GetTokens(const std::string& str) {
-    std::stringstream ss{str};
-    Tokenizer tokenizer{&ss};
+    input_.clear();
+    input_.str(str);
+    Tokenizer tokenizer{&input_};
     auto obj = Read(&tokenizer);
     if (!tokenizer.IsEnd()) {
         throw SyntaxError("not end");
@@ -10,118 +18,160 @@ std::shared_ptr<Object> Interpreter::GetTokens(const std::string& str) {
     return obj;
 }
 
-std::string Interpreter::Run(const std::string& str) {
-    if (!args_.empty()) {
-        args_.clear();
+std::shared_ptr<Node> Interpreter::Compile(const std::string& str) {
+    if (auto node = cache_.Find(str)) {
+        return node;
     }
     auto obj = Interpreter::GetTokens(str);
-    std::shared_ptr<Object> res_ast;
     if (obj == nullptr) {
         throw RuntimeError("can not calculate");
     }
-    res_ast = MakeCalculation(obj);
+    auto node = CompileObject(obj);
+    cache_.Insert(str, node);
+    return node;
+}
+
+namespace {
+
+bool IsPlaceholder(const std::shared_ptr<Object>& obj) {
+    auto symbol = As<Symbol>(obj);
+    return symbol != nullptr && symbol->GetName().size() > 1 && symbol->GetName()[0] == '?';
+}
+
+// Quoted data is not looked into, a placeholder there is a symbol
+void FindPlaceholders(const std::shared_ptr<Object>& obj, std::vector<std::string>* params) {
+    if (auto cell = As<Cell>(obj)) {
+        FindPlaceholders(cell->GetFirst(), params);
+        FindPlaceholders(cell->GetSecond(), params);
+    } else if (IsPlaceholder(obj)) {
+        const auto& name = As<Symbol>(obj)->GetName();
+        if (std::find(params->begin(), params->end(), name) == params->end()) {
+            params->push_back(name);
+        }
+    }
+}
+
+}  // namespace
+
+PreparedExpression Interpreter::Prepare(std::string_view str) {
+    auto obj = GetTokens(std::string(str));
+    if (obj == nullptr) {
+        throw SyntaxError("can not prepare the empty list");
+    }
+    std::string name;
+    if (FindDefinition(obj, &name)) {
+        throw SyntaxError("define can not be prepared");
+    }
+    PreparedExpression res;
+    FindPlaceholders(obj, &res.params_);
+    ListBuilder params;
+    for (const auto& param : res.params_) {
+        params.Add(std::make_shared<Symbol>(param));
+    }
+    // (lambda (?a ?b) obj)
+    auto lambda = std::make_shared<Cell>(
+        std::make_shared<Symbol>("lambda"),
+        std::make_shared<Cell>(params.Build(), std::make_shared<Cell>(obj, nullptr)));
+    res.procedure_ = CompileObject(lambda)->Execute();
+    return res;
+}
+
+std::shared_ptr<Object> Interpreter::Execute(const PreparedExpression& expression, Args params) {
+    BudgetScope budget(budget_);
+    return Invoke(expression.procedure_, params);
+}
+
+std::string Evaluation::Result() const {
     std::string res;
-    if (res_ast == nullptr) {
-        res_ast = std::make_shared<Quote>(res_ast);
-    } else if (Is<Cell>(res_ast)) {
-        res_ast = std::make_shared<Quote>(res_ast);
+    Printer().Print(program_.Result(), &res);
+    return res;
+}
+
+Evaluation Interpreter::Start(const std::string& str) {
+    auto obj = GetTokens(str);
+    if (obj == nullptr) {
+        throw RuntimeError("can not calculate");
+    }
+    const auto& ast = optimize_ ? optimizer_.Optimize(obj) : obj;
+    return Evaluation(ResumableProgram(bytecode_compiler_.Compile(ast)));
+}
+
+void Interpreter::Define(const std::string& name, std::shared_ptr<Object> value) {
+    globals_->Define(name)->Store(std::move(value));
+}
+
+void Interpreter::DefineConstant(const std::string& name,
+                                 std::shared_ptr<const FrozenSegment> segment) {
+    Define(name, segment->Root());
+    segments_.push_back(std::move(segment));
+}
+
+std::shared_ptr<Node> Interpreter::CompileObject(const std::shared_ptr<Object>& obj) {
+    const auto& ast = optimize_ ? optimizer_.Optimize(obj) : obj;
+    if (engine_ == Engine::kBytecode) {
+        return bytecode_compiler_.Compile(ast);
     }
-    res = res_ast->Cerealize();
+    return compiler_.Compile(ast);
+}
+
+std::shared_ptr<Object> Interpreter::Evaluate(const std::string& str) {
+    BudgetScope budget(budget_);
+    return Compile(str)->Execute();
+}
+
+std::string Interpreter::Run(const std::string& str) {
+    std::string res;
+    Run(str, &res);
     return res;
 }
 
-std::shared_ptr<Object> Interpreter::MakeCalculation(std::shared_ptr<Object> obj) {
-    if (Is<Boolean>(obj) || Is<Number>(obj) || Is<Quote>(obj) || Is<Symbol>(obj)) {
-        return obj->Calculate();
-    } else if (Is<Cell>(obj)) {
-        auto first = As<Cell>(obj)->GetFirst();
-        auto second = As<Cell>(obj)->GetSecond();
-        if (Is<Symbol>(first)) {
-            auto functor = functions_[As<Symbol>(first)->GetName()];
-            if (functor == nullptr) {
-                functions_[As<Symbol>(first)->GetName()] = FindFunc(As<Symbol>(first)->GetName());
-                if (functions_[As<Symbol>(first)->GetName()] == nullptr) {
-                    return first->Calculate();
-                }
-            }
-            functor = functions_[As<Symbol>(first)->GetName()];
-            std::vector<std::shared_ptr<Object>> a;
-            while (second && Is<Cell>(second)) {  // разворачиваем в вектор
-                if (Is<Cell>(As<Cell>(second)->GetFirst())) {
-                    a.push_back(MakeCalculation(As<Cell>(second)->GetFirst()));
-                } else {
-                    a.push_back(As<Cell>(second)->GetFirst());
-                }
-                second = As<Cell>(second)->GetSecond();
-            }
-            auto res = functor->Apply(a);
-            return res;
-        } else if (Is<Quote>(first)) {
-            auto el = first->Calculate();
-            if (second != nullptr) {
-                throw RuntimeError("hehe");
-            }
-            return el;
-        } else {
-            throw RuntimeError("hehe");
+void Interpreter::Run(const std::string& str, std::string* out) {
+    printer_.Print(Evaluate(str), out);
+}
+
+void Interpreter::Run(const std::string& str, std::ostream* out) {
+    printer_.Print(Evaluate(str), out);
+}
+
+void Interpreter::RunBatch(std::span<const std::string> expressions, BatchResults* results) {
+    results->output_.clear();
+    results->items_.clear();
+    results->items_.reserve(expressions.size());
+    auto& output = results->output_;
+    for (const auto& expression : expressions) {
+        size_t begin = output.size();
+        auto status = BatchResults::Status::kOk;
+        try {
+            printer_.Print(Evaluate(expression), &output);
+        } catch (const SyntaxError& e) {
+            status = BatchResults::Status::kSyntaxError;
+            output.resize(begin);
+            output += e.what();
+        } catch (const RuntimeError& e) {
+            status = BatchResults::Status::kRuntimeError;
+            output.resize(begin);
+            output += e.what();
+        } catch (const NameError& e) {
+            status = BatchResults::Status::kNameError;
+            output.resize(begin);
+            output += e.what();
+        } catch (const Interrupted& e) {
+            status = BatchResults::Status::kInterrupted;
+            output.resize(begin);
+            output += e.what();
+        } catch (const std::exception& e) {
+            status = BatchResults::Status::kFailed;
+            output.resize(begin);
+            output += e.what();
         }
+        results->items_.push_back({status, begin, output.size()});
     }
 }
 
-std::shared_ptr<Object> Interpreter::FindFunc(std::string functor) {
-    if (functor == "+") {
-        return std::make_shared<AddFunction>();
-    } else if (functor == "-") {
-        return std::make_shared<DecreaseFunction>();
-    } else if (functor == "*") {
-        return std::make_shared<MultiplyFunction>();
-    } else if (functor == "/") {
-        return std::make_shared<DivedeFunction>();
-    } else if (functor == "max") {
-        return std::make_shared<MaxFunction>();
-    } else if (functor == "min") {
-        return std::make_shared<MinFunction>();
-    } else if (functor == "abs") {
-        return std::make_shared<IntAbsFunction>();
-    } else if (functor == "<") {
-        return std::make_shared<LessFunction>();
-    } else if (functor == "<=") {
-        return std::make_shared<LessEqFunction>();
-    } else if (functor == ">") {
-        return std::make_shared<GreaterFunction>();
-    } else if (functor == ">=") {
-        return std::make_shared<GreaterEqFunction>();
-    } else if (functor == "number?") {
-        return std::make_shared<IsNumber>();
-    } else if (functor == "=") {
-        return std::make_shared<EqualFunction>();
-    } else if (functor == "boolean?") {
-        return std::make_shared<IsBool>();
-    } else if (functor == "not") {
-        return std::make_shared<NotFunction>();
-    } else if (functor == "and") {
-        return std::make_shared<AndFunction>();
-    } else if (functor == "or") {
-        return std::make_shared<OrFunction>();
-    } else if (functor == "pair?") {
-        return std::make_shared<IsPair>();
-    } else if (functor == "null?") {
-        return std::make_shared<IsNull>();
-    } else if (functor == "list?") {
-        return std::make_shared<IsList>();
-    } else if (functor == "cons") {
-        return std::make_shared<MakePair>();
-    } else if (functor == "car") {
-        return std::make_shared<GetFirst>();
-    } else if (functor == "cdr") {
-        return std::make_shared<GetSecond>();
-    } else if (functor == "list") {
-        return std::make_shared<MakeList>();
-    } else if (functor == "list-ref") {
-        return std::make_shared<GetListElem>();
-    } else if (functor == "list-tail") {
-        return std::make_shared<GetListTail>();
-    } else {
-        return nullptr;
-    }
+std::shared_ptr<Object> Interpreter::MakeCalculation(std::shared_ptr<Object> obj) {
+    return CompileObject(obj)->Execute();
+}
+
+std::shared_ptr<Object> Interpreter::FindFunc(std::string_view functor) {
+    return FindBuiltin(functor);
 }
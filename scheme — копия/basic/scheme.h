@@ -1,18 +1,198 @@
 #pragma once
 
+#include <ostream>
+#include <span>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 #include "tokenizer.h"
 #include "parser.h"
 #include "object.h"
+#include "printer.h"
+#include "budget.h"
+#include "builtins.h"
+#include "compiler.h"
+#include "expression_cache.h"
+#include "frozen.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "vm.h"
+
+// Which engine executes expressions: the tree of nodes built by Compiler or the bytecode VM.
+enum class Engine { kTree, kBytecode };
+
+// An expression compiled once by Interpreter::Prepare. Its placeholders, symbols starting with
+// '?', are parameters: each Interpreter::Execute binds values to them and evaluates it, with no
+// text to build or parse.
+class PreparedExpression {
+public:
+    // The placeholders in the order of their first appearance, the values are bound in this order
+    const std::vector<std::string>& Params() const {
+        return params_;
+    }
+
+private:
+    friend class Interpreter;
+
+    std::vector<std::string> params_;
+    std::shared_ptr<Object> procedure_;
+};
+
+// The results of Interpreter::RunBatch, by the index of the expression. The outputs are kept in
+// one buffer, which is reused by the next batch along with the rest.
+class BatchResults {
+public:
+    // kFailed is any other exception, such as std::bad_alloc: the interpreter could not evaluate
+    // the expression, which is not an error of the program
+    enum class Status : uint8_t {
+        kOk,
+        kSyntaxError,
+        kRuntimeError,
+        kNameError,
+        kInterrupted,
+        kFailed,
+    };
+
+    size_t Size() const {
+        return items_.size();
+    }
+    Status GetStatus(size_t index) const {
+        return items_[index].status;
+    }
+    // The printed value, or the message of the error. Valid until the next batch.
+    std::string_view Output(size_t index) const {
+        const auto& item = items_[index];
+        return std::string_view(output_).substr(item.begin, item.end - item.begin);
+    }
+
+private:
+    friend class Interpreter;
+
+    struct Item {
+        Status status;
+        size_t begin;
+        size_t end;
+    };
+
+    std::string output_;
+    std::vector<Item> items_;
+};
+
+// An expression started by Interpreter::Start, evaluated a slice at a time as a ResumableProgram.
+// It uses the variables of the interpreter, so the interpreter has to outlive it, and it is not
+// resumed while the interpreter runs something else.
+class Evaluation {
+public:
+    // Evaluates the expression until it is done or passed steps safe points, calls of builtins and
+    // procedures. Returns true when it is done, throws its error.
+    bool Resume(uint64_t steps) {
+        return program_.Resume(steps);
+    }
+    bool IsDone() const {
+        return program_.IsDone();
+    }
+    // The printed value, once it is done
+    std::string Result() const;
+
+private:
+    friend class Interpreter;
+
+    explicit Evaluation(ResumableProgram program) : program_(std::move(program)) {
+    }
+
+    ResumableProgram program_;
+};
 
 class Interpreter {
 public:
+    explicit Interpreter(Engine engine = Engine::kTree) : engine_(engine) {
+    }
+
     std::string Run(const std::string& str);
-    std::vector<std::shared_ptr<Object>> args_;
-    std::unordered_map<std::string, std::shared_ptr<Object>> functions_;
+    // Same as above, but the result is appended to the caller's buffer or written to the stream.
+    void Run(const std::string& str, std::string* out);
+    void Run(const std::string& str, std::ostream* out);
+    // Runs each expression as Run does and stores its result or its error. Errors of the
+    // expressions are not thrown, the ones after a failed expression are still run, the ones
+    // after an interrupted one too.
+    void RunBatch(std::span<const std::string> expressions, BatchResults* results);
     std::shared_ptr<Object> MakeCalculation(std::shared_ptr<Object> obj);
-    std::shared_ptr<Object> FindFunc(std::string);
+    std::shared_ptr<Object> FindFunc(std::string_view);
     std::shared_ptr<Object> GetTokens(const std::string& str);
+    // Parses and compiles str once, the result can be executed any number of times. Run does
+    // the same, so the results are kept in a cache of the expressions seen last.
+    std::shared_ptr<Node> Compile(const std::string& str);
+    // The expression becomes the body of a procedure with the placeholders as parameters.
+    // Throws SyntaxError if it can not be parsed or compiled, or is a definition.
+    PreparedExpression Prepare(std::string_view str);
+    // Throws RuntimeError if the number of values is not the number of placeholders. The result
+    // may be a part of a constant, valid only as long as the interpreter is, see FrozenSegment.
+    std::shared_ptr<Object> Execute(const PreparedExpression& expression, Args params);
+    // Compiles the expression for the VM, whatever the engine, to be evaluated a slice at a time:
+    // an event loop can take turns between many evaluations on a few threads, and a slow one does
+    // not hold a thread. Procedures compiled by the tree engine run to the end within a slice.
+    // Throws the errors of Compile.
+    Evaluation Start(const std::string& str);
+    // Defines a global variable holding value, such as a Channel shared with the interpreters of
+    // other threads. Throws SyntaxError for the names of builtins.
+    void Define(const std::string& name, std::shared_ptr<Object> value);
+    // Same, for the value of the segment, which is kept as long as the interpreter is.
+    void DefineConstant(const std::string& name, std::shared_ptr<const FrozenSegment> segment);
+
+    // Each Run, expression of RunBatch and Execute gets the budget afresh: it throws Interrupted
+    // once it took budget.fuel steps or the token was cancelled, from any thread. See budget.h.
+    void SetBudget(Budget budget) {
+        budget_ = std::move(budget);
+    }
+
+    Engine GetEngine() const {
+        return engine_;
+    }
+    void SetEngine(Engine engine) {
+        engine_ = engine;
+        cache_.Clear();
+    }
+    // Hot numeric expressions of the tree engine are compiled to machine code, see jit.h.
+    void EnableJit(uint32_t threshold = JitNode::kDefaultThreshold) {
+        compiler_.EnableJit(threshold);
+        cache_.Clear();
+    }
+    // Arguments of pure builtins which are big expressions of pure builtins are evaluated in
+    // parallel by the tree engine, see Compiler::EnableParallelArguments.
+    void EnableParallelArguments(size_t threshold = Compiler::kDefaultParallelThreshold) {
+        compiler_.EnableParallelArguments(threshold);
+        cache_.Clear();
+    }
+    // Expressions are rewritten by Optimizer before they are compiled.
+    void EnableOptimizer(bool enabled = true) {
+        optimize_ = enabled;
+        cache_.Clear();
+    }
+    // The number of compiled expressions kept, 0 disables the cache.
+    void SetCacheCapacity(size_t capacity) {
+        cache_.SetCapacity(capacity);
+    }
+    ExpressionCache::Stats GetCacheStats() const {
+        return cache_.GetStats();
+    }
+
+private:
+    std::shared_ptr<Object> Evaluate(const std::string& str);
+    std::shared_ptr<Node> CompileObject(const std::shared_ptr<Object>& obj);
+
+    Engine engine_;
+    bool optimize_ = false;
+    Budget budget_;
+
+    std::vector<std::shared_ptr<const FrozenSegment>> segments_;
+    // shared by the engines, so a variable defined by one is seen by the other
+    std::shared_ptr<Globals> globals_ = std::make_shared<Globals>();
+    Compiler compiler_{globals_};
+    BytecodeCompiler bytecode_compiler_{globals_};
+    ExpressionCache cache_;
+    Optimizer optimizer_;
+    Printer printer_;
+    // the text being parsed, its buffer is reused
+    std::stringstream input_;
 };
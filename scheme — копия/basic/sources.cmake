@@ -2,6 +2,22 @@ add_library(scheme_basic
     tokenizer.cpp
     parser.cpp
     scheme.cpp
+    printer.cpp
+    builtins.cpp
+    compiler.cpp
+    vm.cpp
+    jit.cpp
+    transpiler.cpp
+    optimizer.cpp
+    special_forms.cpp
+    environment.cpp
+    expression_cache.cpp
+    work_stealing_pool.cpp
+    interpreter_pool.cpp
+    parallel.cpp
+    frozen.cpp
+    channel.cpp
+    budget.cpp
     
     # maybe more .cpp files here
 )
@@ -0,0 +1,291 @@
+#include "special_forms.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "error.h"
+
+namespace {
+
+constexpr std::pair<std::string_view, SpecialForm> kSpecialForms[] = {
+    {"and", SpecialForm::kAnd},       {"or", SpecialForm::kOr},
+    {"if", SpecialForm::kIf},         {"cond", SpecialForm::kCond},
+    {"when", SpecialForm::kWhen},     {"define", SpecialForm::kDefine},
+    {"lambda", SpecialForm::kLambda}, {"let", SpecialForm::kLet},
+    {"future", SpecialForm::kFuture},
+};
+
+// The elements of a proper list
+std::vector<std::shared_ptr<Object>> Elements(const std::shared_ptr<Object>& list,
+                                              const char* form) {
+    std::vector<std::shared_ptr<Object>> res;
+    ListWalker it(list);
+    for (; it.AtCell(); it.Next()) {
+        res.push_back(it.Head());
+    }
+    if (it.Rest() != nullptr) {
+        throw SyntaxError(std::string("improper list in ") + form);
+    }
+    return res;
+}
+
+bool IsElse(const std::shared_ptr<Object>& obj) {
+    auto symbol = As<Symbol>(obj);
+    return symbol != nullptr && symbol->GetName() == "else";
+}
+
+// Special forms are keywords, they can not be variables
+std::string VariableName(const std::shared_ptr<Object>& obj, const char* form) {
+    auto symbol = As<Symbol>(obj);
+    if (symbol == nullptr) {
+        throw SyntaxError(std::string("variable of ") + form + " is not a symbol");
+    }
+    SpecialForm keyword;
+    if (FindSpecialForm(symbol->GetName(), &keyword)) {
+        throw SyntaxError(symbol->GetName() + " can not be a variable");
+    }
+    return symbol->GetName();
+}
+
+void AddParam(std::string name, std::vector<std::string>* params, const char* form) {
+    for (const auto& param : *params) {
+        if (param == name) {
+            throw SyntaxError(name + " is bound twice in " + form);
+        }
+    }
+    params->push_back(std::move(name));
+}
+
+// formals is the list after lambda, or after the name of the procedure in define
+LambdaSyntax ParseLambda(const std::shared_ptr<Object>& formals,
+                         std::vector<std::shared_ptr<Object>> body, const char* form) {
+    if (body.empty()) {
+        throw SyntaxError(std::string(form) + " has no body");
+    }
+    LambdaSyntax res;
+    ListWalker it(formals);
+    for (; it.AtCell(); it.Next()) {
+        AddParam(VariableName(it.Head(), form), &res.params, form);
+    }
+    if (it.Rest() != nullptr) {
+        AddParam(VariableName(it.Rest(), form), &res.params, form);
+        res.variadic = true;
+    }
+    res.body = std::move(body);
+    return res;
+}
+
+// Is name anywhere in obj, a conservative test for the use of a variable
+bool Mentions(const std::shared_ptr<Object>& obj, const std::string& name) {
+    if (auto symbol = As<Symbol>(obj)) {
+        return symbol->GetName() == name;
+    }
+    if (!Is<Cell>(obj)) {
+        return false;
+    }
+    ListWalker it(obj);
+    for (; it.AtCell(); it.Next()) {
+        if (Mentions(it.Head(), name)) {
+            return true;
+        }
+    }
+    return Mentions(it.Rest(), name);
+}
+
+}  // namespace
+
+bool FindSpecialForm(std::string_view name, SpecialForm* form) {
+    for (const auto& [form_name, value] : kSpecialForms) {
+        if (form_name == name) {
+            *form = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StopsAnd(const std::shared_ptr<Object>& value) {
+    if (auto boolean = As<Boolean>(value)) {
+        return !boolean->GetValue();
+    }
+    auto quote = As<Quote>(value);
+    return quote != nullptr && quote->GetObject() == nullptr;
+}
+
+bool StopsOr(const std::shared_ptr<Object>& value) {
+    if (auto boolean = As<Boolean>(value)) {
+        return boolean->GetValue();
+    }
+    auto quote = As<Quote>(value);
+    return quote != nullptr && quote->GetObject() != nullptr;
+}
+
+bool IsTrue(const std::shared_ptr<Object>& value) {
+    auto boolean = As<Boolean>(value);
+    return boolean == nullptr || boolean->GetValue();
+}
+
+SpecialFormSyntax ParseSpecialForm(SpecialForm form, const std::shared_ptr<Object>& operands) {
+    SpecialFormSyntax res;
+    res.form = form;
+    switch (form) {
+        case SpecialForm::kAnd:
+            res.operands = Elements(operands, "and");
+            break;
+        case SpecialForm::kOr:
+            res.operands = Elements(operands, "or");
+            break;
+        case SpecialForm::kIf: {
+            auto args = Elements(operands, "if");
+            if (args.size() != 2 && args.size() != 3) {
+                throw SyntaxError("if takes a test, a consequent and an optional alternative");
+            }
+            res.clauses.push_back({false, args[0], {args[1]}});
+            if (args.size() == 3) {
+                res.clauses.push_back({true, nullptr, {args[2]}});
+            }
+            break;
+        }
+        case SpecialForm::kWhen: {
+            auto args = Elements(operands, "when");
+            if (args.size() < 2) {
+                throw SyntaxError("when takes a test and a body");
+            }
+            res.clauses.push_back({false, args[0], {args.begin() + 1, args.end()}});
+            break;
+        }
+        case SpecialForm::kCond:
+            for (const auto& clause : Elements(operands, "cond")) {
+                if (!Is<Cell>(clause)) {
+                    throw SyntaxError("cond clause is not a list");
+                }
+                if (!res.clauses.empty() && res.clauses.back().is_else) {
+                    throw SyntaxError("else is not the last cond clause");
+                }
+                auto items = Elements(clause, "cond");
+                if (IsElse(items[0])) {
+                    if (items.size() == 1) {
+                        throw SyntaxError("else clause has no body");
+                    }
+                    res.clauses.push_back({true, nullptr, {items.begin() + 1, items.end()}});
+                } else {
+                    res.clauses.push_back({false, items[0], {items.begin() + 1, items.end()}});
+                }
+            }
+            break;
+        case SpecialForm::kDefine: {
+            auto args = Elements(operands, "define");
+            if (args.size() < 2) {
+                throw SyntaxError("define takes a name and a value");
+            }
+            if (auto signature = As<Cell>(args[0])) {
+                res.name = VariableName(signature->GetFirst(), "define");
+                res.lambda = ParseLambda(signature->GetSecond(), {args.begin() + 1, args.end()},
+                                         "define");
+                break;
+            }
+            if (args.size() != 2) {
+                throw SyntaxError("define takes a name and a value");
+            }
+            res.name = VariableName(args[0], "define");
+            // a procedure defined with lambda is the same as one defined with a signature
+            auto value = As<Cell>(args[1]);
+            auto head = value ? As<Symbol>(value->GetFirst()) : nullptr;
+            if (head != nullptr && head->GetName() == "lambda") {
+                res.lambda = ParseSpecialForm(SpecialForm::kLambda, value->GetSecond()).lambda;
+            } else {
+                res.operands.push_back(args[1]);
+            }
+            break;
+        }
+        case SpecialForm::kLambda: {
+            auto args = Elements(operands, "lambda");
+            if (args.empty()) {
+                throw SyntaxError("lambda takes parameters and a body");
+            }
+            res.lambda = ParseLambda(args[0], {args.begin() + 1, args.end()}, "lambda");
+            break;
+        }
+        case SpecialForm::kLet: {
+            auto args = Elements(operands, "let");
+            size_t first = 0;
+            if (!args.empty() && Is<Symbol>(args[0])) {
+                res.name = VariableName(args[0], "let");
+                first = 1;
+            }
+            if (args.size() <= first) {
+                throw SyntaxError("let takes bindings and a body");
+            }
+            res.lambda.emplace();
+            for (const auto& binding : Elements(args[first], "let")) {
+                auto pair = Elements(binding, "let");
+                if (pair.size() != 2) {
+                    throw SyntaxError("let binding is not a name and a value");
+                }
+                AddParam(VariableName(pair[0], "let"), &res.lambda->params, "let");
+                res.operands.push_back(pair[1]);
+            }
+            res.lambda->body.assign(args.begin() + first + 1, args.end());
+            if (res.lambda->body.empty()) {
+                throw SyntaxError("let has no body");
+            }
+            break;
+        }
+        case SpecialForm::kFuture: {
+            auto args = Elements(operands, "future");
+            if (args.size() != 1) {
+                throw SyntaxError("future takes one expression");
+            }
+            res.lambda.emplace();
+            res.lambda->body = std::move(args);
+            break;
+        }
+    }
+    return res;
+}
+
+bool FindDefinition(const std::shared_ptr<Object>& expression, std::string* name) {
+    auto cell = As<Cell>(expression);
+    auto symbol = cell ? As<Symbol>(cell->GetFirst()) : nullptr;
+    if (symbol == nullptr || symbol->GetName() != "define") {
+        return false;
+    }
+    *name = ParseSpecialForm(SpecialForm::kDefine, cell->GetSecond()).name;
+    return true;
+}
+
+std::vector<std::string> BodyDefinitions(const std::vector<std::shared_ptr<Object>>& body) {
+    std::vector<std::string> res(body.size());
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (!FindDefinition(body[i], &res[i])) {
+            continue;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (res[j] == res[i]) {
+                throw SyntaxError(res[i] + " is defined twice");
+            }
+        }
+    }
+    return res;
+}
+
+std::vector<bool> BodyGroup(const std::vector<std::string>& names,
+                            const std::vector<SpecialFormSyntax>& definitions) {
+    std::vector<bool> res(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i].empty()) {
+            continue;
+        }
+        res[i] = definitions[i].lambda.has_value();
+        for (size_t j = 0; j < i && !res[i]; ++j) {
+            if (!names[j].empty() && definitions[j].lambda) {
+                const auto& body = definitions[j].lambda->body;
+                res[i] = std::any_of(body.begin(), body.end(), [&](const auto& expression) {
+                    return Mentions(expression, names[i]);
+                });
+            }
+        }
+    }
+    return res;
+}
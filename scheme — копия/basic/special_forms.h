@@ -0,0 +1,87 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+// and, or, if, cond and when are special forms: they get their operands unevaluated and evaluate
+// only those which decide the result, left to right. define, lambda and let bind variables, see
+// environment.h. future evaluates its operand on another thread, see Future. The syntax is
+// checked here, once for the engines, the transpiler and the optimizer. Operands are evaluated
+// the way arguments of calls are: lists are calls, symbols are variables, anything else is its
+// own value.
+enum class SpecialForm {
+    kAnd,
+    kOr,
+    kIf,
+    kCond,
+    kWhen,
+    kDefine,
+    kLambda,
+    kLet,
+    kFuture,
+};
+
+// Returns false if name is not a special form.
+bool FindSpecialForm(std::string_view name, SpecialForm* form);
+
+// and stops at #f and '() with #f, or stops at #t and a quoted non-empty list with #t. Other
+// values do not decide anything, the value of the last operand is the result then.
+bool StopsAnd(const std::shared_ptr<Object>& value);
+bool StopsOr(const std::shared_ptr<Object>& value);
+// Tests of the conditionals: everything but #f is true
+bool IsTrue(const std::shared_ptr<Object>& value);
+
+// The body is evaluated if the test is true, and the result is the value of its last expression,
+// or of the test when the body is empty.
+struct CondClause {
+    bool is_else = false;
+    std::shared_ptr<Object> test;
+    std::vector<std::shared_ptr<Object>> body;
+};
+
+// A procedure: (lambda (a b) body), (lambda (a . rest) body) or (lambda args body). A variadic
+// procedure gets the arguments after the fixed ones as a list in its last parameter.
+struct LambdaSyntax {
+    std::vector<std::string> params;
+    bool variadic = false;
+    std::vector<std::shared_ptr<Object>> body;
+};
+
+// if and when are conditionals too:
+//     (if c a b)   = (cond (c a) (else b))
+//     (when c a b) = (cond (c a b))
+// A conditional which takes none of its clauses gives the empty list.
+//
+// The binding forms are procedures:
+//     (define (f a) body)          = (define f (lambda (a) body))
+//     (let ((a 1)) body)           = ((lambda (a) body) 1)
+//     (let loop ((a 1)) body)      = ((lambda (a) body) 1), where loop is the lambda in its body
+//     (future expr)                = (spawn (lambda () expr))
+struct SpecialFormSyntax {
+    SpecialForm form;
+    std::vector<std::shared_ptr<Object>> operands;  // and, or; define: the value; let: the values
+    std::vector<CondClause> clauses;                // if, cond, when
+    std::string name;                               // define; the loop of a named let
+    std::optional<LambdaSyntax> lambda;             // lambda, let, future; define of a procedure
+};
+
+// Throws SyntaxError if the operands do not fit the form.
+SpecialFormSyntax ParseSpecialForm(SpecialForm form, const std::shared_ptr<Object>& operands);
+
+// Returns false if expression is not a definition, throws SyntaxError if it is a malformed one.
+bool FindDefinition(const std::shared_ptr<Object>& expression, std::string* name);
+// Definitions in the body of a lambda or let bind variables of the whole body. Returns the names
+// they define, by the index of the definition, and empty names for the other expressions.
+// Throws SyntaxError if a name is defined twice.
+std::vector<std::string> BodyDefinitions(const std::vector<std::shared_ptr<Object>>& body);
+// The definitions of a body which the procedures defined in it may use before they are evaluated:
+// the procedures, and the variables which a procedure defined before them mentions. definitions
+// are the parsed ones, by the index of the definition. If there are two or more, they get their
+// values from a ProcedureGroup in the procedures, see environment.h.
+std::vector<bool> BodyGroup(const std::vector<std::string>& names,
+                            const std::vector<SpecialFormSyntax>& definitions);
@@ -5,8 +5,24 @@
 #include <error.h>
 #include <scheme.h>
 
+// The same tests are built once per execution engine, and once more for the tree engine with
+// the JIT compiling every numeric expression on its first execution (SCHEME_TEST_JIT) and with
+// the optimizer (SCHEME_TEST_OPTIMIZE)
+#ifndef SCHEME_TEST_ENGINE
+#define SCHEME_TEST_ENGINE Engine::kTree
+#endif
+
 class SchemeTest {
 public:
+    SchemeTest() {
+#ifdef SCHEME_TEST_JIT
+        interpreter_.EnableJit(0);
+#endif
+#ifdef SCHEME_TEST_OPTIMIZE
+        interpreter_.EnableOptimizer();
+#endif
+    }
+
     void ExpectEq(std::string expression, const std::string& result) {
         REQUIRE(interpreter_.Run(expression) == result);
     }
@@ -28,5 +44,5 @@ public:
     }
 
 private:
-    Interpreter interpreter_;
+    Interpreter interpreter_{SCHEME_TEST_ENGINE};
 };
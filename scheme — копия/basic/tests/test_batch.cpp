@@ -0,0 +1,72 @@
+#include <catch.hpp>
+
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <scheme.h>
+
+TEST_CASE("BatchRunsEveryExpression") {
+    Interpreter interpreter;
+    std::vector<std::string> expressions = {"(+ 1 2)", "(car 1)",   "(define x 5)", "(+ x",
+                                            "(* x x)", "undefined", "max",          "'(1 2)"};
+    BatchResults results;
+    interpreter.RunBatch(expressions, &results);
+    REQUIRE(results.Size() == expressions.size());
+
+    using Status = BatchResults::Status;
+    REQUIRE(results.GetStatus(0) == Status::kOk);
+    REQUIRE(results.Output(0) == "3");
+    REQUIRE(results.GetStatus(1) == Status::kRuntimeError);
+    REQUIRE(!results.Output(1).empty());
+    REQUIRE(results.GetStatus(2) == Status::kOk);
+    REQUIRE(results.Output(2) == "()");
+    REQUIRE(results.GetStatus(3) == Status::kSyntaxError);
+    REQUIRE(results.GetStatus(4) == Status::kOk);
+    REQUIRE(results.Output(4) == "25");
+    REQUIRE(results.GetStatus(5) == Status::kNameError);
+    REQUIRE(results.Output(5) == "unbound variable undefined");
+    // the builtin can not be printed, nothing of it is left in the output
+    REQUIRE(results.GetStatus(6) == Status::kSyntaxError);
+    REQUIRE(results.Output(7) == "(1 2)");
+
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        if (results.GetStatus(i) == Status::kOk) {
+            REQUIRE(results.Output(i) == interpreter.Run(expressions[i]));
+        }
+    }
+}
+
+TEST_CASE("BatchResultsAreReused") {
+    Interpreter interpreter(Engine::kBytecode);
+    BatchResults results;
+    std::vector<std::string> first = {"1", "2", "3"};
+    interpreter.RunBatch(first, &results);
+    REQUIRE(results.Size() == 3);
+    std::vector<std::string> second = {"(list 4)"};
+    interpreter.RunBatch(second, &results);
+    REQUIRE(results.Size() == 1);
+    REQUIRE(results.Output(0) == "(4)");
+    interpreter.RunBatch({}, &results);
+    REQUIRE(results.Size() == 0);
+}
+
+TEST_CASE("BatchReportsOtherExceptions") {
+    struct Exhausting : Function {
+        std::shared_ptr<Object> Apply(Args) override {
+            throw std::bad_alloc();
+        }
+    };
+    Interpreter interpreter;
+    interpreter.Define("exhaust", std::make_shared<Exhausting>());
+    std::vector<std::string> expressions = {"(+ 1 2)", "(exhaust)", "(* 2 3)"};
+    BatchResults results;
+    interpreter.RunBatch(expressions, &results);
+    using Status = BatchResults::Status;
+    REQUIRE(results.GetStatus(0) == Status::kOk);
+    REQUIRE(results.GetStatus(1) == Status::kFailed);
+    REQUIRE(results.Output(1) == std::bad_alloc().what());
+    REQUIRE(results.GetStatus(2) == Status::kOk);
+    REQUIRE(results.Output(2) == "6");
+}
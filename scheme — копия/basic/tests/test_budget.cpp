@@ -0,0 +1,190 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <budget.h>
+#include <error.h>
+#include <scheme.h>
+
+namespace {
+
+Interrupted::Reason RunInterrupted(Interpreter* interpreter, const std::string& expression) {
+    try {
+        interpreter->Run(expression);
+    } catch (const Interrupted& e) {
+        return e.reason;
+    }
+    FAIL("not interrupted: " << expression);
+    return Interrupted::Reason::kOutOfFuel;
+}
+
+}  // namespace
+
+TEST_CASE("FuelIsCounted") {
+    BudgetScope scope(Budget{10});
+    REQUIRE(scope.FuelLeft() == 10);
+    for (int i = 0; i < 10; ++i) {
+        SpendFuel();
+    }
+    REQUIRE(scope.FuelLeft() == 0);
+    REQUIRE_THROWS_AS(SpendFuel(), Interrupted);
+    REQUIRE_THROWS_AS(SpendFuel(), Interrupted);
+
+    {
+        // a scope hides the one it is in, the steps taken in it are its own
+        BudgetScope inner(Budget{});
+        SpendFuel(1000);
+        ListBuilder builder;
+        for (int64_t i = 0; i < 1000; ++i) {
+            builder.Add(std::make_shared<Number>(i));
+        }
+        for (ListWalker walker(builder.Build()); walker.AtCell(); walker.Next()) {
+        }
+        REQUIRE(inner.FuelLeft() == Budget::kUnlimited - 2000);
+    }
+    {
+        // skipping costs the same on pairs and on unrolled lists
+        BudgetScope inner(Budget{});
+        std::shared_ptr<Object> pairs;
+        ListBuilder builder;
+        for (int64_t i = 0; i < 100; ++i) {
+            pairs = std::make_shared<Cell>(std::make_shared<Number>(i), pairs);
+            builder.Add(std::make_shared<Number>(i));
+        }
+        ListWalker walker(pairs);
+        REQUIRE(walker.Skip(90));
+        REQUIRE(inner.FuelLeft() == Budget::kUnlimited - 90);
+        ListWalker unrolled(builder.Build());
+        REQUIRE(unrolled.Skip(90));
+        REQUIRE(inner.FuelLeft() == Budget::kUnlimited - 180);
+    }
+    REQUIRE_THROWS_AS(SpendFuel(), Interrupted);
+}
+
+TEST_CASE("FuelEndsEvaluations") {
+    for (auto engine : {Engine::kTree, Engine::kBytecode}) {
+        Interpreter interpreter(engine);
+        interpreter.SetBudget({2000});
+        interpreter.Run("(define (loop) (loop))");
+        interpreter.Run("(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))");
+        interpreter.Run("(define (count n acc) (if (= n 0) acc (count (- n 1) (+ acc 1))))");
+
+        REQUIRE(RunInterrupted(&interpreter, "(loop)") == Interrupted::Reason::kOutOfFuel);
+        REQUIRE(RunInterrupted(&interpreter, "(count 1000000 0)") ==
+                Interrupted::Reason::kOutOfFuel);
+        REQUIRE(RunInterrupted(&interpreter, "(depth 1000000)") ==
+                Interrupted::Reason::kOutOfFuel);
+        // every Run gets the fuel afresh
+        REQUIRE(interpreter.Run("(count 100 0)") == "100");
+        REQUIRE(interpreter.Run("(depth 100)") == "100");
+
+        // the steps of list traversals count
+        interpreter.SetBudget({});
+        interpreter.Run("(define l (parallel-map (lambda (x) x) (list 1 2 3 4 5 6 7 8 9 10)))");
+        interpreter.SetBudget({5});
+        REQUIRE(RunInterrupted(&interpreter, "(list-ref l 9)") ==
+                Interrupted::Reason::kOutOfFuel);
+        REQUIRE(interpreter.Run("(list-ref l 1)") == "2");
+
+        auto prepared = interpreter.Prepare("(count ?n 0)");
+        const std::shared_ptr<Object> params[] = {std::make_shared<Number>(100)};
+        REQUIRE_THROWS_AS(interpreter.Execute(prepared, params), Interrupted);
+    }
+}
+
+TEST_CASE("CompiledExpressionsSpendFuel") {
+    // five builtin applications, whether they are interpreted or run as native code
+    const std::string expression = "(+ (* x 2) (* x 3) (- x 1) (* x x) 5)";
+    for (bool jit : {false, true}) {
+        Interpreter interpreter;
+        if (jit) {
+            interpreter.EnableJit(0);
+        }
+        interpreter.Run("(define x 7)");
+        REQUIRE(interpreter.Run(expression) == "95");
+        interpreter.SetBudget({4});
+        REQUIRE(RunInterrupted(&interpreter, expression) == Interrupted::Reason::kOutOfFuel);
+        interpreter.SetBudget({5});
+        REQUIRE(interpreter.Run(expression) == "95");
+    }
+}
+
+TEST_CASE("EvaluationsAreCancelled") {
+    for (auto engine : {Engine::kTree, Engine::kBytecode}) {
+        Interpreter interpreter(engine);
+        interpreter.Run("(define (loop) (loop))");
+        auto token = std::make_shared<CancellationToken>();
+        interpreter.SetBudget(Budget(token));
+        std::thread canceller([token] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            token->Cancel();
+        });
+        REQUIRE(RunInterrupted(&interpreter, "(loop)") == Interrupted::Reason::kCancelled);
+        canceller.join();
+        // a cancelled token ends the evaluations started after it
+        REQUIRE(RunInterrupted(&interpreter, "(+ 1 2)") == Interrupted::Reason::kCancelled);
+
+        interpreter.SetBudget({});
+        REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    }
+}
+
+TEST_CASE("PoolTasksRunUnderTheBudget") {
+    const std::string parallel =
+        "(parallel-map (lambda (x) (spin)) "
+        "(list 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 26 27 28 29 30 "
+        "31 32 33 34))";
+    const std::string future = "(touch (future (spin)))";
+    for (auto engine : {Engine::kTree, Engine::kBytecode}) {
+        Interpreter interpreter(engine);
+        interpreter.Run("(define (spin) (spin))");
+        interpreter.SetBudget({100000});
+        REQUIRE(RunInterrupted(&interpreter, parallel) == Interrupted::Reason::kOutOfFuel);
+        REQUIRE(RunInterrupted(&interpreter, future) == Interrupted::Reason::kOutOfFuel);
+
+        for (const auto& expression : {parallel, future}) {
+            auto token = std::make_shared<CancellationToken>();
+            interpreter.SetBudget(Budget(token));
+            std::thread canceller([token] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                token->Cancel();
+            });
+            REQUIRE(RunInterrupted(&interpreter, expression) == Interrupted::Reason::kCancelled);
+            canceller.join();
+        }
+        interpreter.SetBudget({});
+        REQUIRE(interpreter.Run("(parallel-map (lambda (x) (* x x)) '(1 2 3))") == "(1 4 9)");
+    }
+}
+
+TEST_CASE("WaitsAreCancelled") {
+    Interpreter interpreter;
+    interpreter.Run("(define c (make-channel 4))");
+    auto token = std::make_shared<CancellationToken>();
+    interpreter.SetBudget(Budget(token));
+    std::thread canceller([token] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        token->Cancel();
+    });
+    REQUIRE(RunInterrupted(&interpreter, "(channel-receive c)") ==
+            Interrupted::Reason::kCancelled);
+    canceller.join();
+}
+
+TEST_CASE("BatchesReportInterruptions") {
+    Interpreter interpreter;
+    interpreter.Run("(define (loop) (loop))");
+    interpreter.SetBudget({1000});
+    std::vector<std::string> expressions = {"(+ 1 2)", "(loop)", "(* 2 3)"};
+    BatchResults results;
+    interpreter.RunBatch(expressions, &results);
+    using Status = BatchResults::Status;
+    REQUIRE(results.GetStatus(0) == Status::kOk);
+    REQUIRE(results.GetStatus(1) == Status::kInterrupted);
+    REQUIRE(results.Output(1) == "out of fuel");
+    REQUIRE(results.Output(2) == "6");
+}
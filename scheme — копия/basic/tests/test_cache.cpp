@@ -0,0 +1,62 @@
+#include <catch.hpp>
+
+#include <error.h>
+#include <scheme.h>
+
+TEST_CASE("CacheCountsHitsAndMisses") {
+    Interpreter interpreter;
+    REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    REQUIRE(interpreter.Run("(list 1 2)") == "(1 2)");
+    REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    auto stats = interpreter.GetCacheStats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.size == 2);
+    REQUIRE(stats.capacity == ExpressionCache::kDefaultCapacity);
+    // the same node is executed again
+    REQUIRE(interpreter.Compile("(+ 1 2)") == interpreter.Compile("(+ 1 2)"));
+}
+
+TEST_CASE("CacheDropsLeastRecentlyUsed") {
+    Interpreter interpreter;
+    interpreter.SetCacheCapacity(2);
+    interpreter.Run("1");
+    interpreter.Run("2");
+    interpreter.Run("1");
+    interpreter.Run("3");
+    REQUIRE(interpreter.GetCacheStats().size == 2);
+    REQUIRE(interpreter.GetCacheStats().misses == 3);
+    interpreter.Run("1");
+    REQUIRE(interpreter.GetCacheStats().hits == 2);
+    interpreter.Run("2");
+    REQUIRE(interpreter.GetCacheStats().misses == 4);
+
+    interpreter.SetCacheCapacity(1);
+    REQUIRE(interpreter.GetCacheStats().size == 1);
+    interpreter.SetCacheCapacity(0);
+    REQUIRE(interpreter.GetCacheStats().size == 0);
+    REQUIRE(interpreter.Run("(+ 2 2)") == "4");
+    REQUIRE(interpreter.GetCacheStats().size == 0);
+}
+
+TEST_CASE("CachedExpressionsSeeCurrentState") {
+    Interpreter interpreter;
+    interpreter.Run("(define x 1)");
+    REQUIRE(interpreter.Run("(+ x 1)") == "2");
+    interpreter.Run("(define x 5)");
+    REQUIRE(interpreter.Run("(+ x 1)") == "6");
+    REQUIRE(interpreter.GetCacheStats().hits == 1);
+
+    // syntax errors are raised every time and nothing is cached for them, (car 1) compiles
+    REQUIRE_THROWS_AS(interpreter.Run("(+ 1"), SyntaxError);
+    REQUIRE_THROWS_AS(interpreter.Run("(+ 1"), SyntaxError);
+    REQUIRE_THROWS_AS(interpreter.Run("(car 1)"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(car 1)"), RuntimeError);
+    REQUIRE(interpreter.GetCacheStats().size == 4);
+
+    // the code depends on the engine
+    interpreter.SetEngine(Engine::kBytecode);
+    REQUIRE(interpreter.GetCacheStats().size == 0);
+    REQUIRE(interpreter.Run("(+ x 1)") == "6");
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "scheme_test.h"
+#include "typed_function.h"
+
+// The sanitizers bring their own allocator, which can not be replaced
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SCHEME_TEST_NO_ALLOCATOR
+#endif
+#endif
+#ifdef __SANITIZE_ADDRESS__
+#define SCHEME_TEST_NO_ALLOCATOR
+#endif
+
+TEST_CASE("BuiltinArity") {
+    REQUIRE(FindBuiltin("car")->GetArity() == Arity::kUnary);
+    REQUIRE(FindBuiltin("abs")->GetArity() == Arity::kUnary);
+    REQUIRE(FindBuiltin("list-ref")->GetArity() == Arity::kBinary);
+    REQUIRE(FindBuiltin("+")->GetArity() == Arity::kVariadic);
+    REQUIRE(FindBuiltin("<")->GetArity() == Arity::kVariadic);
+
+    std::shared_ptr<Object> one = std::make_shared<Number>(1);
+    REQUIRE_THROWS_AS(FindBuiltin("car")->ApplyBinary(one, one), RuntimeError);
+    REQUIRE_THROWS_AS(FindBuiltin("list-ref")->ApplyUnary(one), RuntimeError);
+    REQUIRE(As<Number>(FindBuiltin("-")->ApplyUnary(one))->GetValue() == 1);
+}
+
+TEST_CASE("BuiltinsAreFound") {
+    auto names = BuiltinNames();
+    std::set<std::string_view> known(names.begin(), names.end());
+    std::set<const Object*> instances;
+    for (auto name : names) {
+        INFO(name);
+        const auto& builtin = FindBuiltin(name);
+        REQUIRE(builtin != nullptr);
+        REQUIRE(&FindBuiltin(std::string(name)) == &builtin);
+        instances.insert(builtin.get());
+    }
+    REQUIRE(known.size() == names.size());
+    REQUIRE(instances.size() == names.size());
+
+    // near misses of every name, and so many other names that thousands of them share a slot of
+    // the table with a builtin
+    std::vector<std::string> unknown = {"", " ", "CAR", "car ", std::string("car\0", 4)};
+    for (auto name : names) {
+        std::string str(name);
+        unknown.push_back(str + "x");
+        unknown.push_back("x" + str);
+        unknown.push_back(str.substr(0, str.size() - 1));
+        unknown.push_back(str.substr(1));
+        str.back() ^= 1;
+        unknown.push_back(str);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        unknown.push_back("f" + std::to_string(i));
+    }
+    for (const auto& name : unknown) {
+        if (!known.contains(name)) {
+            INFO(name);
+            REQUIRE(FindBuiltin(name) == nullptr);
+            REQUIRE(!IsPureBuiltin(name));
+        }
+    }
+    // the lookups of unknown names add nothing
+    REQUIRE(BuiltinNames() == names);
+    for (auto name : names) {
+        REQUIRE(instances.contains(FindBuiltin(name).get()));
+    }
+    for (const auto& name : unknown) {
+        REQUIRE((FindBuiltin(name) == nullptr) != known.contains(name));
+    }
+}
+
+namespace {
+
+struct Clamp : TypedFunction<Clamp> {
+    static int64_t Run(int64_t x, ListView bounds) {
+        if (bounds.Length() != 2) {
+            throw RuntimeError("two bounds expected");
+        }
+        auto lo = As<Number>(bounds.GetCell()->GetFirst())->GetValue();
+        return std::max(x, lo);
+    }
+};
+
+struct Sum : TypedFunction<Sum> {
+    static int64_t Run(Numbers args) {
+        int64_t sum = 0;
+        for (int64_t x : args) {
+            sum += x;
+        }
+        return sum;
+    }
+    static int64_t RunBinary(int64_t a, int64_t b) {
+        return a + b + 1000;
+    }
+};
+
+struct IsEmpty : TypedFunction<IsEmpty> {
+    static bool Run(ListView list) {
+        return list.IsEmpty();
+    }
+};
+
+}  // namespace
+
+TEST_CASE("TypedBuiltins") {
+    auto number = [](int64_t value) -> std::shared_ptr<Object> {
+        return std::make_shared<Number>(value);
+    };
+    auto value = [](const std::shared_ptr<Object>& obj) {
+        return As<Number>(obj)->GetValue();
+    };
+    std::shared_ptr<Object> bounds = std::make_shared<Quote>(
+        std::make_shared<Cell>(number(3), std::make_shared<Cell>(number(9), nullptr)));
+
+    Clamp clamp;
+    REQUIRE(clamp.GetArity() == Arity::kBinary);
+    REQUIRE(value(clamp.ApplyBinary(number(1), bounds)) == 3);
+    const std::shared_ptr<Object> args[] = {number(5), bounds};
+    REQUIRE(value(clamp.Apply(args)) == 5);
+    REQUIRE_THROWS_AS(clamp.ApplyBinary(bounds, bounds), RuntimeError);
+    REQUIRE_THROWS_AS(clamp.ApplyBinary(number(1), number(1)), RuntimeError);
+    REQUIRE_THROWS_AS(clamp.ApplyUnary(number(1)), RuntimeError);
+    REQUIRE_THROWS_AS(clamp.Apply(Args(args, 1)), RuntimeError);
+
+    Sum sum;
+    REQUIRE(sum.GetArity() == Arity::kVariadic);
+    REQUIRE(value(sum.Apply({})) == 0);
+    REQUIRE(value(sum.ApplyUnary(number(4))) == 4);
+    REQUIRE(value(sum.ApplyBinary(number(1), number(2))) == 1003);
+    REQUIRE_THROWS_AS(sum.ApplyBinary(number(1), bounds), RuntimeError);
+
+    IsEmpty is_empty;
+    REQUIRE(is_empty.GetArity() == Arity::kUnary);
+    REQUIRE(is_empty.ApplyUnary(std::make_shared<Quote>(nullptr)) == MakeBool(true));
+    REQUIRE(is_empty.ApplyUnary(nullptr) == MakeBool(true));
+    REQUIRE(is_empty.ApplyUnary(bounds) == MakeBool(false));
+    REQUIRE_THROWS_AS(is_empty.ApplyUnary(number(1)), RuntimeError);
+}
+
+TEST_CASE_METHOD(SchemeTest, "CallsByArity") {
+    ExpectEq("(car '(1 2))", "1");
+    ExpectEq("(list-ref '(1 2 3) 1)", "2");
+    ExpectEq("(list-tail '(1 2 3) 1)", "(2 3)");
+    ExpectEq("(+ 1 2)", "3");
+    ExpectEq("(- 1 2)", "-1");
+    ExpectEq("(* (car '(4)) 2)", "8");
+    ExpectEq("(/ 7 2)", "3");
+    ExpectEq("(< 1 2)", "#t");
+    ExpectEq("(>= 1 2)", "#f");
+    ExpectEq("(= 2 (+ 1 1))", "#t");
+    ExpectEq("(+ 1 2 3 4 5 6 7 8 9 10)", "55");
+
+    ExpectRuntimeError("(car)");
+    ExpectRuntimeError("(car '(1) '(2))");
+    ExpectRuntimeError("(list-ref '(1 2))");
+    ExpectRuntimeError("(list-ref '(1 2) 0 1)");
+    ExpectRuntimeError("(< 1 (car '(#t)))");
+    ExpectRuntimeError("(- 1 (car '(#t)) 2)");
+    ExpectRuntimeError("(length 1)");
+    ExpectRuntimeError("(list-ref 1 0)");
+    // the arguments are checked as they are used
+    ExpectEq("(< 2 1 (car '(#t)))", "#f");
+    ExpectEq("(list-tail 1 0)", "1");
+    ExpectRuntimeError("(+ 9223372036854775807 1)");
+    ExpectRuntimeError("(/ 1 0)");
+}
+
+#ifndef SCHEME_TEST_NO_ALLOCATOR
+
+namespace {
+
+// The allocations made by this thread while counting is on
+thread_local bool counting = false;
+thread_local size_t allocations = 0;
+
+void* Allocate(size_t size) {
+    if (counting) {
+        ++allocations;
+    }
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// Allocations made by the second execution of the expression, the first one may compile it
+size_t CountAllocations(const std::string& expression) {
+    Interpreter interpreter{SCHEME_TEST_ENGINE};
+#ifdef SCHEME_TEST_JIT
+    interpreter.EnableJit(0);
+#endif
+#ifdef SCHEME_TEST_OPTIMIZE
+    interpreter.EnableOptimizer();
+#endif
+    auto node = interpreter.Compile(expression);
+    node->Execute();
+    allocations = 0;
+    counting = true;
+    auto res = node->Execute();
+    counting = false;
+    return allocations;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+TEST_CASE("CallsDoNotAllocateArguments") {
+    // comparisons return the shared booleans, arithmetic allocates only its result
+    REQUIRE(CountAllocations("(< 1 2)") == 0);
+    REQUIRE(CountAllocations("(= (car '(1 2)) 1)") == 0);
+    REQUIRE(CountAllocations("(not (car '(#f)))") == 0);
+    REQUIRE(CountAllocations("(+ 1 2)") <= 1);
+    REQUIRE(CountAllocations("(list-ref '(1 2 3) (- 3 1))") <= 1);
+    REQUIRE(CountAllocations("(+ (* 2 (car '(3))) (- 4 1))") <= 3);
+    REQUIRE(CountAllocations("(max 1 2 3 4 5 6 7 8)") <= 1);
+}
+
+#endif
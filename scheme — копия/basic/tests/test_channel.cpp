@@ -0,0 +1,114 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <channel.h>
+#include <error.h>
+#include <scheme.h>
+
+TEST_CASE("RingsAreBounded") {
+    SpscRing<int> spsc(3);
+    MpmcRing<int> mpmc(3);
+    REQUIRE(spsc.Capacity() == 4);
+    REQUIRE(mpmc.Capacity() == 4);
+    int value = 0;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(spsc.TryPush(int(i)));
+            REQUIRE(mpmc.TryPush(int(i)));
+        }
+        REQUIRE(!spsc.TryPush(4));
+        REQUIRE(!mpmc.TryPush(4));
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(spsc.TryPop(&value));
+            REQUIRE(value == i);
+            REQUIRE(mpmc.TryPop(&value));
+            REQUIRE(value == i);
+        }
+        REQUIRE(!spsc.TryPop(&value));
+        REQUIRE(!mpmc.TryPop(&value));
+    }
+}
+
+TEST_CASE("MpmcRingLosesNothing") {
+    constexpr int kThreads = 4;
+    constexpr int64_t kCount = 20000;
+    MpmcRing<int64_t> ring(64);
+    std::atomic<int64_t> sum = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&ring] {
+            for (int64_t i = 1; i <= kCount; ++i) {
+                while (!ring.TryPush(int64_t(i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&ring, &sum] {
+            int64_t value;
+            for (int64_t i = 0; i < kCount; ++i) {
+                while (!ring.TryPop(&value)) {
+                    std::this_thread::yield();
+                }
+                sum += value;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(sum == kThreads * kCount * (kCount + 1) / 2);
+}
+
+TEST_CASE("ChannelsPassValues") {
+    for (auto kind : {Channel::Kind::kSpsc, Channel::Kind::kMpmc}) {
+        auto channel = std::make_shared<Channel>(kind, 16);
+        Interpreter producer;
+        Interpreter consumer(Engine::kBytecode);
+        producer.Define("out", channel);
+        consumer.Define("in", channel);
+        std::thread thread([&producer] {
+            producer.Run(
+                "(let loop ((i 0)) (when (< i 1000) (channel-send out (list i)) (loop (+ i 1))))");
+        });
+        REQUIRE(consumer.Run("(let loop ((i 0) (sum 0)) (if (= i 1000) sum"
+                             "  (loop (+ i 1) (+ sum (car (channel-receive in))))))") == "499500");
+        thread.join();
+
+        // the receiver gets the object which was sent
+        channel = std::make_shared<Channel>(kind, 1);
+        auto value = producer.GetTokens("(1 2 3)");
+        auto sent = value;
+        REQUIRE(!channel->TryReceive(&sent));
+        REQUIRE(channel->TrySend(std::move(sent)));
+        std::shared_ptr<Object> received;
+        REQUIRE(channel->TryReceive(&received));
+        REQUIRE(received == value);
+    }
+}
+
+TEST_CASE("ChannelErrors") {
+    Interpreter interpreter;
+    REQUIRE_THROWS_AS(interpreter.Run("(make-channel 0)"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(make-channel -1)"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(make-channel 100000000000)"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(make-channel 65537)"), RuntimeError);
+    REQUIRE(interpreter.Run("(let ((c (make-channel 65536))) (channel-send c 1) 2)") == "2");
+    REQUIRE_THROWS_AS(interpreter.Run("(channel-send 1 2)"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(channel-receive '(1))"), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Run("(make-channel 1)"), SyntaxError);
+    REQUIRE(interpreter.Run("(let ((c (make-channel 2)))"
+                            "  (channel-send c 5) (channel-receive c))") == "5");
+
+    // the sender of an spsc channel may move to another thread
+    auto channel = std::make_shared<Channel>(Channel::Kind::kSpsc, 2);
+    interpreter.Define("c", channel);
+    interpreter.Run("(channel-send c 1)");
+    std::thread([&channel] { channel->Send(std::make_shared<Number>(2)); }).join();
+    REQUIRE(interpreter.Run("(list (channel-receive c) (channel-receive c))") == "(1 2)");
+    REQUIRE_THROWS_AS(interpreter.Define("car", channel), SyntaxError);
+}
@@ -11,3 +11,26 @@ TEST_CASE_METHOD(SchemeTest, "Be careful") {
     ExpectRuntimeError("('() ())");
     ExpectEq("'(())", "(())");
 }
+
+TEST_CASE("RunIntoBuffer") {
+    Interpreter interpreter{SCHEME_TEST_ENGINE};
+    std::string out = "> ";
+    interpreter.Run("'(1 (2 #t) -3)", &out);
+    REQUIRE(out == "> (1 (2 #t) -3)");
+
+    std::stringstream ss;
+    interpreter.Run("(+ 1 2)", &ss);
+    REQUIRE(ss.str() == "3");
+}
+
+TEST_CASE("CompiledExpressionRunsManyTimes") {
+    Interpreter interpreter{SCHEME_TEST_ENGINE};
+    auto node = interpreter.Compile("(+ 1 (* 2 3) (max 4 5))");
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(node->Execute()->Cerealize() == "12");
+    }
+
+    auto bad = interpreter.Compile("(+ 1 (1 2))");
+    REQUIRE_THROWS_AS(bad->Execute(), RuntimeError);
+    REQUIRE_THROWS_AS(bad->Execute(), RuntimeError);
+}
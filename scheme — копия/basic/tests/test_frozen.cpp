@@ -0,0 +1,126 @@
+#include <catch.hpp>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <channel.h>
+#include <error.h>
+#include <frozen.h>
+#include <interpreter_pool.h>
+#include <printer.h>
+#include <scheme.h>
+
+namespace {
+
+std::string Show(const std::shared_ptr<Object>& obj) {
+    std::string res;
+    Printer().Print(obj, &res);
+    return res;
+}
+
+}  // namespace
+
+TEST_CASE("FrozenValuesAreCopies") {
+    Interpreter interpreter;
+    std::string text = "(";
+    for (int i = 0; i < 1000; ++i) {
+        text += "(" + std::to_string(i) + " x" + std::to_string(i) + ") ";
+    }
+    text += "#t (quote q) (1 . 2) ())";
+    auto value = interpreter.GetTokens(text);
+    auto segment = FrozenSegment::Freeze(value);
+    REQUIRE(Show(segment->Root()) == Show(value));
+    // nothing is counted
+    REQUIRE(segment->Root().use_count() == 0);
+    REQUIRE(As<Cell>(segment->Root())->Length() == 1004);
+    REQUIRE(segment->Objects() > 3000);
+    REQUIRE(segment->Bytes() > 0);
+
+    // the parts shared in the value are shared in the copy
+    auto shared = interpreter.GetTokens("(1 2)");
+    auto pair = FrozenSegment::Freeze(std::make_shared<Cell>(shared, shared));
+    auto root = As<Cell>(pair->Root());
+    REQUIRE(root->GetFirst() == root->GetSecond());
+    REQUIRE(Show(root) == "((1 2) 1 2)");
+
+    REQUIRE(FrozenSegment::Freeze(nullptr)->Root() == nullptr);
+    REQUIRE_THROWS_AS(FrozenSegment::Freeze(FindBuiltin("car")), RuntimeError);
+}
+
+TEST_CASE("FrozenValuesAreConstants") {
+    auto segment = FrozenSegment::Freeze(Interpreter().GetTokens("(1 2 3)"));
+    Interpreter interpreter;
+    interpreter.DefineConstant("table", segment);
+    REQUIRE(interpreter.Run("(cons 0 table)") == "(0 1 2 3)");
+    REQUIRE(interpreter.Run("(cdr table)") == "(2 3)");
+    REQUIRE(interpreter.Run("table") == "(1 2 3)");
+    REQUIRE_THROWS_AS(interpreter.DefineConstant("car", segment), SyntaxError);
+
+    // the interpreter keeps the segment
+    std::weak_ptr<const FrozenSegment> weak = segment;
+    segment.reset();
+    REQUIRE(!weak.expired());
+    REQUIRE(interpreter.Run("(length table)") == "3");
+}
+
+TEST_CASE("FrozenValuesAreSharedByThreads") {
+    std::string text = "(";
+    for (int i = 0; i < 5000; ++i) {
+        text += std::to_string(i) + " ";
+    }
+    text += ")";
+    auto segment = FrozenSegment::Freeze(Interpreter().GetTokens(text));
+    InterpreterPool pool(4, Engine::kBytecode, [&segment](Interpreter* interpreter) {
+        interpreter->DefineConstant("table", segment);
+    });
+    std::vector<std::future<std::string>> results;
+    for (int i = 0; i < 500; ++i) {
+        auto index = std::to_string(i * 10);
+        results.push_back(pool.Submit("(+ (list-ref table " + index + ") (length table) (car " +
+                                      "(list-tail table " + index + ")))"));
+    }
+    for (int i = 0; i < 500; ++i) {
+        REQUIRE(results[i].get() == std::to_string(i * 20 + 5000));
+    }
+}
+
+TEST_CASE("FrozenCellsAreNeverChanged") {
+    Interpreter interpreter;
+    auto segment = FrozenSegment::Freeze(interpreter.GetTokens("(1 2)"));
+    auto root = As<Cell>(segment->Root());
+    // nobody owns the cells of a segment, they count as shared
+    auto first = root->ChangeFirst(std::make_shared<Number>(3));
+    REQUIRE(first != root);
+    REQUIRE(Show(first) == "(3 2)");
+    auto second = root->ChangeSecond(nullptr);
+    REQUIRE(second != root);
+    REQUIRE(Show(second) == "(1)");
+    REQUIRE(Show(segment->Root()) == "(1 2)");
+}
+
+TEST_CASE("FrozenValuesLiveWithTheInterpreter") {
+    auto channel = std::make_shared<Channel>(Channel::Kind::kMpmc, 4);
+    auto interpreter = std::make_unique<Interpreter>();
+    interpreter->Define("c", channel);
+    std::weak_ptr<const FrozenSegment> weak;
+    {
+        auto segment = FrozenSegment::Freeze(interpreter->GetTokens("(1 (2 3) four)"));
+        weak = segment;
+        interpreter->DefineConstant("data", std::move(segment));
+    }
+    // the values the interpreter hands out are still there with no other owner of the segment
+    REQUIRE(!weak.expired());
+    auto prepared = interpreter->Prepare("(list-ref data ?i)");
+    const std::shared_ptr<Object> params[] = {std::make_shared<Number>(1)};
+    auto result = interpreter->Execute(prepared, params);
+    interpreter->Run("(channel-send c (cdr data))");
+    interpreter->Run("(define data 0)");
+    REQUIRE(!weak.expired());
+    REQUIRE(Show(result) == "(2 3)");
+    REQUIRE(Show(channel->Receive()) == "((2 3) four)");
+    result = nullptr;
+    interpreter.reset();
+    REQUIRE(weak.expired());
+}
@@ -0,0 +1,45 @@
+#include "scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "FuturesGiveValues") {
+    ExpectEq("(touch (future (+ 1 2)))", "3");
+    ExpectEq("(future (list 1 2))", "(1 2)");
+    ExpectEq("(touch 5)", "5");
+    ExpectEq("(touch (spawn (lambda () (* 6 7))))", "42");
+
+    ExpectNoError("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    ExpectNoError(
+        "(define (pfib n) (if (< n 15) (fib n)"
+        "  (let ((a (future (pfib (- n 1)))) (b (pfib (- n 2)))) (+ (touch a) b))))");
+    ExpectEq("(pfib 20)", "6765");
+    // a future is evaluated once, it can be touched any number of times
+    ExpectEq("(let ((f (future (fib 10)))) (list (touch f) (touch f)))", "(55 55)");
+    ExpectEq("(let ((x 5)) (touch (future (let ((y 2)) (* x y)))))", "10");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FuturesReadGlobalsBeingDefined") {
+    // the future runs on after the define which spawned it, reading spin and y on its thread
+    // while they are defined again on this one
+    ExpectNoError("(define (spin n acc) (if (= n 0) acc (spin (- n 1) (+ acc y))))");
+    ExpectNoError("(define y 1)");
+    ExpectNoError("(define f (future (spin 200000 0)))");
+    for (int i = 0; i < 1000; ++i) {
+        ExpectNoError("(define y 1)");
+        ExpectNoError("(define (spin n acc) (if (= n 0) acc (spin (- n 1) (+ acc y))))");
+    }
+    ExpectEq("(touch f)", "200000");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FuturesReportErrors") {
+    ExpectSyntaxError("(future)");
+    ExpectSyntaxError("(future 1 2)");
+    ExpectSyntaxError("(define (future) 1)");
+    ExpectRuntimeError("(spawn 1)");
+    ExpectRuntimeError("(touch (spawn (lambda (x) x)))");
+
+    // the error is raised by touch, not by future
+    ExpectNoError("(define f (future (car 1)))");
+    ExpectRuntimeError("(touch f)");
+    ExpectRuntimeError("(touch f)");
+    ExpectNameError("(touch (future undefined))");
+    ExpectRuntimeError("(+ 1 (future 2))");
+}
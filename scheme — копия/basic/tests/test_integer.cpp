@@ -112,3 +112,15 @@ TEST_CASE_METHOD(SchemeTest, "IntegerAbsEdgeCases") {
     ExpectRuntimeError("(abs #t)");
     ExpectRuntimeError("(abs 1 2)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "IntegerOverflow") {
+    ExpectEq("(+ 9223372036854775806 1)", "9223372036854775807");
+    ExpectEq("(- -9223372036854775807 1)", "-9223372036854775808");
+    ExpectRuntimeError("(+ 9223372036854775807 1)");
+    ExpectRuntimeError("(- -9223372036854775807 2)");
+    ExpectRuntimeError("(* 4294967296 4294967296)");
+    ExpectRuntimeError("(/ -9223372036854775808 -1)");
+    ExpectRuntimeError("(abs -9223372036854775808)");
+    ExpectRuntimeError("(/ 1 0)");
+    ExpectSyntaxError("9223372036854775808");
+}
@@ -0,0 +1,128 @@
+#include <catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <error.h>
+#include <scheme.h>
+
+namespace {
+
+// The result or the type of the error
+std::string Evaluate(Interpreter* interpreter, const std::string& expression) {
+    try {
+        return interpreter->Run(expression);
+    } catch (const RuntimeError&) {
+        return "RuntimeError";
+    } catch (const SyntaxError&) {
+        return "SyntaxError";
+    }
+}
+
+}  // namespace
+
+TEST_CASE("JitMatchesInterpreter") {
+    Interpreter interpreter;
+    Interpreter jit;
+    jit.EnableJit(0);
+
+    const std::vector<std::string> expressions = {
+        "(+ 1 2 3)",
+        "(- 10 (* 2 3) 1)",
+        "(- 5)",
+        "(/ 100 7 2)",
+        "(/ -7 2)",
+        "(+)",
+        "(*)",
+        "(max 3 -8 11 2)",
+        "(min 3 -8 (abs -11) 2)",
+        "(abs (- 3 10))",
+        "(< 1 2 3)",
+        "(< 1 3 2)",
+        "(<= 1 1 2)",
+        "(> 3 (+ 1 1) 1)",
+        "(>= 3 3 4)",
+        "(= (* 2 2) 4 (+ 2 2))",
+        "(=)",
+        "(< 1)",
+        // inputs
+        "(+ (length '(1 2 3)) (* 2 (car '(5 6))))",
+        "(< (length '(1 2)) (length '(1 2 3)))",
+        "(+ 1 (< 1 2))",
+        "(< 2 1 (car '(#t)))",
+        "(< 1 2 (car '(#t)))",
+        "(+ (cdr '(1)) 1)",
+        // guards
+        "(+ 9223372036854775807 1)",
+        "(* (length '(1 2)) 4611686018427387904)",
+        "(+ (* 4611686018427387904 2) (car '()))",
+        "(+ 1 (car '()))",
+        "(/ 1 (- 2 2))",
+        "(/ -9223372036854775808 (- 1 2))",
+        "(abs -9223372036854775808)",
+        "(- (abs (- 0 9223372036854775807)) 1)",
+    };
+    for (const auto& expression : expressions) {
+        INFO(expression);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(Evaluate(&jit, expression) == Evaluate(&interpreter, expression));
+        }
+    }
+}
+
+TEST_CASE("JitCompilesHotExpressions") {
+    if (!JitAvailable()) {
+        return;
+    }
+    Interpreter interpreter;
+    interpreter.EnableJit(3);
+    auto node = interpreter.Compile("(< (+ 1 (* 2 (length '(1 2)))) (max 4 7) 10)");
+    auto jit = std::dynamic_pointer_cast<JitNode>(node);
+    REQUIRE(jit != nullptr);
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(jit->IsCompiled() == (i >= 3));
+        REQUIRE(node->Execute()->Cerealize() == "#t");
+    }
+
+    auto plain = Interpreter().Compile("(+ 1 2)");
+    REQUIRE(std::dynamic_pointer_cast<JitNode>(plain) == nullptr);
+    REQUIRE(std::dynamic_pointer_cast<JitNode>(interpreter.Compile("(+ 1 #t)")) == nullptr);
+}
+
+TEST_CASE("JitKeepsSideEffectsInOrder") {
+    Interpreter interpreter;
+    interpreter.EnableJit(0);
+    interpreter.Run("(define ch (make-channel 4))");
+    interpreter.Run("(define (f) (channel-send ch 1) 1)");
+    // the input with a side effect is evaluated only if the operation before it succeeds
+    REQUIRE_THROWS_AS(interpreter.Run("(+ (* 9223372036854775807 2) (f))"), RuntimeError);
+    interpreter.Run("(channel-send ch 2)");
+    REQUIRE(interpreter.Run("(channel-receive ch)") == "2");
+    // before all the operations it is
+    REQUIRE(interpreter.Run("(+ (f) (* 2 3))") == "7");
+    REQUIRE(interpreter.Run("(channel-receive ch)") == "1");
+    REQUIRE(interpreter.Run("(- (* 2 3) (length (list 1 2)))") == "4");
+}
+
+TEST_CASE("JitCodeSharesPages") {
+    if (!JitAvailable()) {
+        return;
+    }
+    Interpreter interpreter;
+    interpreter.EnableJit(0);
+    // the code of many expressions fills many chunks, which are freed with the nodes and taken
+    // again
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::shared_ptr<JitNode>> nodes;
+        for (int i = 0; i < 70000; ++i) {
+            auto expression = "(+ " + std::to_string(i) + " (* 2 (length '(1 2))))";
+            auto node = interpreter.Compile(expression);
+            REQUIRE(node->Execute()->Cerealize() == std::to_string(i + 4));
+            nodes.push_back(std::dynamic_pointer_cast<JitNode>(node));
+        }
+        for (const auto& node : nodes) {
+            REQUIRE(node->IsCompiled());
+        }
+    }
+}
@@ -77,3 +77,104 @@ TEST_CASE_METHOD(SchemeTest, "ListOperations") {
     ExpectRuntimeError("(list-ref '(1 2 3) 10)");
     ExpectRuntimeError("(list-tail '(1 2 3) 10)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "NestedListSerialization") {
+    ExpectEq("'((1 2) 3)", "((1 2) 3)");
+    ExpectEq("'(() 1)", "(() 1)");
+    ExpectEq("'(1 (2 (3 . 4)) . 5)", "(1 (2 (3 . 4)) . 5)");
+    ExpectEq("(cons 1 '(2 3))", "(1 2 3)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ListsShareElements") {
+    ExpectEq("(list 1 '(2 3) #t)", "(1 (2 3) #t)");
+    ExpectEq("(list-ref '(1 (2 3)) 1)", "(2 3)");
+    ExpectEq("(and 1 (list 1 2))", "(1 2)");
+    ExpectEq("(list 1 2)", "(1 2)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "LongLists") {
+    std::string elems;
+    for (int i = 0; i < 100; ++i) {
+        elems += std::to_string(i) + " ";
+    }
+    elems.pop_back();
+
+    ExpectEq("'(" + elems + ")", "(" + elems + ")");
+    ExpectEq("(list " + elems + ")", "(" + elems + ")");
+    ExpectEq("(list-ref '(" + elems + ") 0)", "0");
+    ExpectEq("(list-ref '(" + elems + ") 77)", "77");
+    ExpectEq("(list-ref (list " + elems + ") 99)", "99");
+    ExpectEq("(list-tail '(" + elems + ") 97)", "(97 98 99)");
+    ExpectEq("(list-tail '(" + elems + " . 100) 99)", "(99 . 100)");
+    ExpectEq("(car (cdr (cdr '(" + elems + "))))", "2");
+    ExpectEq("(+ " + elems + ")", "4950");
+
+    ExpectRuntimeError("(list-ref '(" + elems + ") 100)");
+    ExpectRuntimeError("(list-tail '(" + elems + ") 101)");
+
+    ExpectEq("(length '(" + elems + "))", "100");
+    ExpectEq("(length (list-tail '(" + elems + ") 33))", "67");
+    ExpectEq("(list? '(" + elems + "))", "#t");
+    ExpectEq("(list? '(" + elems + " . 100))", "#f");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ListLength") {
+    ExpectEq("(length '())", "0");
+    ExpectEq("(length '(1 2 3))", "3");
+    ExpectEq("(length (cons 1 '(2 3)))", "3");
+    ExpectEq("(length (list-tail '(1 2 3) 1))", "2");
+
+    ExpectEq("(list? '(1))", "#t");
+    ExpectEq("(list? (cons 1 2))", "#f");
+    ExpectEq("(list? (cdr '(1 2 . 3)))", "#f");
+    ExpectEq("(list? (cons 1 '(2)))", "#t");
+
+    ExpectRuntimeError("(length '(1 2 . 3))");
+    ExpectRuntimeError("(length 1)");
+}
+
+TEST_CASE("CellsChangeOnlyWhenUnshared") {
+    auto number = [](int64_t value) { return std::make_shared<Number>(value); };
+    auto value = [](const std::shared_ptr<Object>& obj) { return As<Number>(obj)->GetValue(); };
+
+    // the sole reference: the cell is changed in place, its length follows the new tail
+    auto cell = std::make_shared<Cell>(number(1), nullptr);
+    const Cell* address = cell.get();
+    cell = cell->ChangeFirst(number(2));
+    REQUIRE(cell.get() == address);
+    cell = cell->ChangeSecond(std::make_shared<Cell>(number(3), nullptr));
+    REQUIRE(cell.get() == address);
+    REQUIRE(value(cell->GetFirst()) == 2);
+    REQUIRE(cell->Length() == 2);
+    REQUIRE(cell->IsProperList());
+
+    // a shared cell is left alone, the change is a copy
+    auto holder = cell;
+    auto first = cell->ChangeFirst(number(4));
+    REQUIRE(first != cell);
+    REQUIRE(value(first->GetFirst()) == 4);
+    REQUIRE(first->GetSecond() == cell->GetSecond());
+    auto second = cell->ChangeSecond(number(5));
+    REQUIRE(second != cell);
+    REQUIRE(value(second->GetSecond()) == 5);
+    REQUIRE(!second->IsProperList());
+    REQUIRE(value(cell->GetFirst()) == 2);
+    REQUIRE(cell->Length() == 2);
+
+    // a view into an unrolled list shares the chunk with the list
+    ListBuilder builder;
+    for (int64_t i = 0; i < 100; ++i) {
+        builder.Add(number(i));
+    }
+    auto list = As<Cell>(builder.Build());
+    auto view = As<Cell>(list->GetSecond());
+    auto changed = view->ChangeFirst(number(-1));
+    REQUIRE(changed != view);
+    REQUIRE(value(changed->GetFirst()) == -1);
+    REQUIRE(changed->Length() == 99);
+    REQUIRE(value(view->GetFirst()) == 1);
+    REQUIRE(value(As<Cell>(list->GetSecond())->GetFirst()) == 1);
+    changed = view->ChangeSecond(nullptr);
+    REQUIRE(changed->Length() == 1);
+    REQUIRE(view->Length() == 99);
+}
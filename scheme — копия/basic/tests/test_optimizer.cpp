@@ -0,0 +1,124 @@
+#include <catch.hpp>
+
+#include <exception>
+#include <string>
+
+#include <optimizer.h>
+#include <printer.h>
+#include <scheme.h>
+
+namespace {
+
+std::string Optimized(Optimizer* optimizer, const std::string& expression) {
+    std::string res;
+    Printer().Print(optimizer->Optimize(Interpreter().GetTokens(expression)), &res);
+    return res;
+}
+
+}  // namespace
+
+TEST_CASE("OptimizerFoldsConstants") {
+    Optimizer optimizer;
+    REQUIRE(Optimized(&optimizer, "(+ 1 2 (* 3 4))") == "15");
+    REQUIRE(optimizer.Changes().size() == 2);
+    REQUIRE(optimizer.Changes()[0].kind == OptimizerChange::kFold);
+    REQUIRE(optimizer.Changes()[0].before == "(* 3 4)");
+    REQUIRE(optimizer.Changes()[0].after == "12");
+    REQUIRE(optimizer.Changes()[1].before == "(+ 1 2 12)");
+
+    REQUIRE(Optimized(&optimizer, "(not (< 2 1))") == "#t");
+    REQUIRE(Optimized(&optimizer, "(+ 1 (length '(1 2)))") == "3");
+    REQUIRE(Optimized(&optimizer, "(list 1 (+ 1 1))") == "(list 1 2)");
+    REQUIRE(optimizer.Changes().size() == 1);
+
+    // errors are left for the execution
+    REQUIRE(Optimized(&optimizer, "(+ 1 (/ 1 0))") == "(+ 1 (/ 1 0))");
+    REQUIRE(Optimized(&optimizer, "(+ 1 #t)") == "(+ 1 #t)");
+    REQUIRE(optimizer.Changes().empty());
+}
+
+TEST_CASE("OptimizerDropsOperands") {
+    Optimizer optimizer;
+    REQUIRE(Optimized(&optimizer, "(and #t (< 1 2) x)") == "(and x)");
+    REQUIRE(optimizer.Changes().back().kind == OptimizerChange::kDropOperands);
+    REQUIRE(Optimized(&optimizer, "(and x #f 1 (cdr '(1)) 2)") == "(and x #f)");
+    REQUIRE(Optimized(&optimizer, "(or #f 0 x)") == "(or x)");
+    REQUIRE(Optimized(&optimizer, "(or x #t 5)") == "(or x #t)");
+    REQUIRE(Optimized(&optimizer, "(and #f (car '()))") == "#f");
+    REQUIRE(Optimized(&optimizer, "(and 1 (length '(1 2)))") == "2");
+}
+
+TEST_CASE("OptimizerSelectsBranches") {
+    Optimizer optimizer;
+    REQUIRE(Optimized(&optimizer, "(if (< 1 2) x (car 1))") == "x");
+    REQUIRE(optimizer.Changes().back().kind == OptimizerChange::kBranch);
+    REQUIRE(Optimized(&optimizer, "(if '() (+ 1 2) y)") == "3");
+    REQUIRE(Optimized(&optimizer, "(if x 1 (+ 1 2))") == "(if x 1 3)");
+    REQUIRE(Optimized(&optimizer, "(cond ((< x 1) (+ 1 1)) (else x))") == "(cond ((< x 1) 2) (else x))");
+    // the empty list can not be put back as a literal
+    REQUIRE(Optimized(&optimizer, "(if #f 1)") == "(if #f 1)");
+    REQUIRE(Optimized(&optimizer, "(if 1 2 3 4)") == "(if 1 2 3 4)");
+    // a definition is a syntax error in a branch, it is not taken out of the if
+    REQUIRE(Optimized(&optimizer, "(if #t (define x 5) 1)") == "(if #t (define x 5) 1)");
+}
+
+TEST_CASE("OptimizerFlattensArithmetic") {
+    Optimizer optimizer;
+    REQUIRE(Optimized(&optimizer, "(+ (+ x 2) 3)") == "(+ x 2 3)");
+    REQUIRE(optimizer.Changes().back().kind == OptimizerChange::kFlatten);
+    REQUIRE(Optimized(&optimizer, "(- (- (- x 1) 2) 3)") == "(- x 1 2 3)");
+    REQUIRE(Optimized(&optimizer, "(max (max x 1) (min 3 (min 4)))") == "(max x 1 3)");
+    // other operands would change the order of the operations, or the errors
+    REQUIRE(Optimized(&optimizer, "(+ 1 (+ x 2))") == "(+ 1 (+ x 2))");
+    REQUIRE(Optimized(&optimizer, "(max 1 (max x 2))") == "(max 1 (max x 2))");
+    REQUIRE(Optimized(&optimizer, "(* (* x 2) y)") == "(* (* x 2) y)");
+    REQUIRE(Optimized(&optimizer, "(min (min x 2) #t)") == "(min (min x 2) #t)");
+    REQUIRE(Optimized(&optimizer, "(max (max) x)") == "(max (max) x)");
+}
+
+TEST_CASE("OptimizerKeepsErrors") {
+    const std::string expressions[] = {
+        "(max 1 (max 2 #t))", "(+ (+ 1 #t) 2)",    "(+ (+ 1 2 #t) 3)", "(- (- 1 (car 1)) #t)",
+        "(* (* 2 x) 3 #f)",   "(min (min 1 2 x) #f)", "(/ (/ 1 0) 2)",    "(max (max 1 y) 2)",
+        "(if #t (define y 5) 1)", "(if #f 1 (define y))"};
+    for (const auto& expression : expressions) {
+        std::string errors[2];
+        for (bool optimize : {false, true}) {
+            Interpreter interpreter;
+            interpreter.EnableOptimizer(optimize);
+            interpreter.Run("(define x #t)");
+            try {
+                interpreter.Run(expression);
+                FAIL("no error: " << expression);
+            } catch (const std::exception& e) {
+                errors[optimize] = e.what();
+            }
+        }
+        INFO(expression);
+        REQUIRE(errors[0] == errors[1]);
+    }
+}
+
+TEST_CASE("OptimizerKeepsUnchangedExpressions") {
+    Optimizer optimizer;
+    auto ast = Interpreter().GetTokens("(list x '(2 3) (cdr '(1 2)))");
+    REQUIRE(optimizer.Optimize(ast) == ast);
+    REQUIRE(optimizer.Changes().empty());
+}
+
+TEST_CASE("OptimizerRespectsVariables") {
+    Optimizer optimizer;
+    REQUIRE(Optimized(&optimizer, "(let ((x (+ 1 2))) (* x (+ 2 2)))") == "(let ((x 3)) (* x 4))");
+    REQUIRE(Optimized(&optimizer, "(define (f x) (+ x (* 2 3)))") == "(define (f x) (+ x 6))");
+    REQUIRE(Optimized(&optimizer, "(f (+ 1 2) (abs -4))") == "(f 3 4)");
+    REQUIRE(Optimized(&optimizer, "((lambda (y) y) (* 2 5))") == "((lambda (y) y) 10)");
+    // calls through variables which shadow builtins are not folded
+    REQUIRE(Optimized(&optimizer, "(lambda (max) (max 1 2))") == "(lambda (max) (max 1 2))");
+    REQUIRE(Optimized(&optimizer, "(let ((+ *)) (+ 2 3))") == "(let ((+ *)) (+ 2 3))");
+    REQUIRE(Optimized(&optimizer, "(let ((x 1)) (define (abs y) y) (abs -1))") ==
+            "(let ((x 1)) (define (abs y) y) (abs -1))");
+    REQUIRE(Optimized(&optimizer, "(let loop ((max 1)) (max 1 2))") ==
+            "(let loop ((max 1)) (max 1 2))");
+    REQUIRE(Optimized(&optimizer, "(list (let ((max 1)) max) (max 1 2))") ==
+            "(list (let ((max 1)) max) 2)");
+}
@@ -0,0 +1,90 @@
+#include "scheme_test.h"
+
+namespace {
+
+const char* const kRange =
+    "(define (range n) (let loop ((i (- n 1)) (acc '()))"
+    "  (if (< i 0) acc (loop (- i 1) (cons i acc)))))";
+
+}  // namespace
+
+TEST_CASE_METHOD(SchemeTest, "ParallelMap") {
+    ExpectNoError(kRange);
+    ExpectEq("(parallel-map (lambda (x) (* x x)) (range 5))", "(0 1 4 9 16)");
+    ExpectEq("(parallel-map abs '(-1 2 -3))", "(1 2 3)");
+    ExpectEq("(parallel-map abs '())", "()");
+    ExpectEq("(length (parallel-map abs (range 1000)))", "1000");
+    ExpectEq("(list-ref (parallel-map (lambda (x) (* x 2)) (range 1000)) 999)", "1998");
+    ExpectEq("(list-ref (parallel-map (lambda (x) (* x 2)) (range 1000)) 517)", "1034");
+
+    ExpectNoError("(define k 3)");
+    ExpectEq("(parallel-map (lambda (x) (+ x k)) '(1 2))", "(4 5)");
+    ExpectEq("(parallel-for-each abs (range 100))", "()");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ParallelReduce") {
+    ExpectNoError(kRange);
+    ExpectEq("(parallel-reduce + 0 (parallel-map (lambda (x) (* x x)) (range 1000)))",
+             "332833500");
+    ExpectEq("(parallel-reduce max 0 (range 1000))", "999");
+    ExpectEq("(parallel-reduce min 5 (range 1000))", "0");
+    ExpectEq("(parallel-reduce * 1 '(1 2 3 4))", "24");
+    ExpectEq("(parallel-reduce + 7 '())", "7");
+
+    // other functions are folded from the left
+    ExpectEq("(parallel-reduce - 0 (range 100))", "-4950");
+    ExpectEq("(parallel-reduce (lambda (acc x) (cons x acc)) '() '(1 2 3))", "(3 2 1)");
+
+    // the parallel builtins call each other
+    ExpectEq("(parallel-reduce + 0 (parallel-map (lambda (x) (parallel-reduce + 0 (range x)))"
+             " (range 40)))",
+             "9880");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ParallelErrors") {
+    ExpectNoError(kRange);
+    ExpectRuntimeError("(parallel-map car (range 100))");
+    ExpectRuntimeError("(parallel-map (lambda (x) (/ 1 (- x 500))) (range 1000))");
+    ExpectRuntimeError("(parallel-reduce + 0 (list 1 2 #t))");
+    ExpectRuntimeError("(parallel-map 1 '(1))");
+    ExpectRuntimeError("(parallel-map abs '(1 . 2))");
+    ExpectRuntimeError("(parallel-map abs 1)");
+    ExpectRuntimeError("(parallel-reduce + 0)");
+    ExpectRuntimeError("(parallel-for-each abs)");
+}
+
+namespace {
+
+// (op (op ... x ...) ...) of the given depth, every call has two arguments
+std::string Formula(int depth, int seed) {
+    if (depth == 0) {
+        return std::to_string(seed % 7 + 1);
+    }
+    static const char* const kOps[] = {"+", "max", "-", "min"};
+    return std::string("(") + kOps[seed % 4] + " " + Formula(depth - 1, seed * 3 + 1) + " " +
+           Formula(depth - 1, seed * 5 + 2) + ")";
+}
+
+}  // namespace
+
+TEST_CASE("ParallelArguments") {
+    Interpreter sequential;
+    Interpreter parallel;
+    parallel.EnableParallelArguments(16);
+    for (int seed = 0; seed < 5; ++seed) {
+        auto formula = Formula(10, seed);
+        REQUIRE(parallel.Run(formula) == sequential.Run(formula));
+    }
+    auto list = "(list " + Formula(8, 1) + " " + Formula(8, 2) + " x)";
+    parallel.Run("(define x 5)");
+    sequential.Run("(define x 5)");
+    REQUIRE(parallel.Run(list) == sequential.Run(list));
+    REQUIRE(parallel.Run("(let ((x 3)) " + list + ")") ==
+            sequential.Run("(let ((x 3)) " + list + ")"));
+
+    // the first argument which fails decides the error
+    auto failing = "(+ " + Formula(8, 1) + " (car " + Formula(8, 2) + ") undefined)";
+    REQUIRE_THROWS_AS(parallel.Run(failing), RuntimeError);
+    failing = "(+ " + Formula(8, 1) + " undefined (car " + Formula(8, 2) + "))";
+    REQUIRE_THROWS_AS(parallel.Run(failing), NameError);
+}
@@ -0,0 +1,94 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <error.h>
+#include <interpreter_pool.h>
+
+namespace {
+
+void Fork(WorkStealingPool* pool, int depth, std::atomic<int>* count) {
+    ++*count;
+    if (depth > 0) {
+        for (int i = 0; i < 2; ++i) {
+            pool->Submit([pool, depth, count](size_t) { Fork(pool, depth - 1, count); });
+        }
+    }
+}
+
+}  // namespace
+
+TEST_CASE("PoolRunsExpressions") {
+    for (auto engine : {Engine::kTree, Engine::kBytecode}) {
+        InterpreterPool pool(4, engine, [](Interpreter* interpreter) {
+            interpreter->Run("(define (square x) (* x x))");
+        });
+        REQUIRE(pool.Size() == 4);
+        std::vector<std::future<std::string>> results;
+        for (int i = 0; i < 200; ++i) {
+            results.push_back(pool.Submit("(+ (square " + std::to_string(i) + ") 1)"));
+        }
+        for (int i = 0; i < 200; ++i) {
+            REQUIRE(results[i].get() == std::to_string(i * i + 1));
+        }
+        REQUIRE(pool.QueueDepth() == 0);
+
+        uint64_t tasks = 0;
+        for (const auto& stats : pool.GetStats()) {
+            tasks += stats.tasks;
+            REQUIRE(stats.utilization >= 0);
+            REQUIRE(stats.utilization <= 1);
+        }
+        REQUIRE(tasks == 200);
+    }
+}
+
+TEST_CASE("PoolReportsErrors") {
+    InterpreterPool pool(2);
+    auto syntax = pool.Submit("(+ 1");
+    auto runtime = pool.Submit("(car 1)");
+    auto name = pool.Submit("undefined");
+    auto fine = pool.Submit("'(1 2)");
+    REQUIRE_THROWS_AS(syntax.get(), SyntaxError);
+    REQUIRE_THROWS_AS(runtime.get(), RuntimeError);
+    REQUIRE_THROWS_AS(name.get(), NameError);
+    REQUIRE(fine.get() == "(1 2)");
+}
+
+TEST_CASE("WorkersStealNestedTasks") {
+    std::atomic<int> count = 0;
+    std::atomic<bool> current = false;
+    {
+        WorkStealingPool pool(4);
+        REQUIRE(WorkStealingPool::Current() == nullptr);
+        pool.Submit([&pool, &count, &current](size_t) {
+            current = WorkStealingPool::Current() == &pool;
+            Fork(&pool, 10, &count);
+        });
+        // the destructor runs everything queued
+    }
+    REQUIRE(current);
+    REQUIRE(count == (1 << 11) - 1);
+
+    WorkStealingPool pool(1);
+    std::atomic<bool> release = false;
+    pool.Submit([&release](size_t) {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (pool.QueueDepth() != 0) {
+        std::this_thread::yield();
+    }
+    pool.Submit([&count](size_t) { count = 0; });
+    // the worker is busy, a waiting thread runs the queued task itself
+    while (!pool.RunPending()) {
+        std::this_thread::yield();
+    }
+    REQUIRE(count == 0);
+    release = true;
+}
@@ -0,0 +1,69 @@
+#include <catch.hpp>
+
+#include <memory>
+
+#include <error.h>
+#include <printer.h>
+#include <scheme.h>
+
+namespace {
+
+std::string Show(const std::shared_ptr<Object>& obj) {
+    std::string res;
+    Printer().Print(obj, &res);
+    return res;
+}
+
+std::shared_ptr<Object> Num(int64_t value) {
+    return std::make_shared<Number>(value);
+}
+
+}  // namespace
+
+TEST_CASE("PreparedExpressionsBindPlaceholders") {
+    for (auto engine : {Engine::kTree, Engine::kBytecode}) {
+        Interpreter interpreter(engine);
+        auto prepared = interpreter.Prepare("(+ ?a (* ?b 2) ?a)");
+        REQUIRE(prepared.Params() == std::vector<std::string>{"?a", "?b"});
+        for (int64_t i = 0; i < 10; ++i) {
+            const std::shared_ptr<Object> params[] = {Num(i), Num(10)};
+            REQUIRE(Show(interpreter.Execute(prepared, params)) == std::to_string(2 * i + 20));
+        }
+
+        auto test = interpreter.Prepare("(if ?flag (car ?list) (length ?list))");
+        ListBuilder list;
+        list.Add(Num(7));
+        list.Add(Num(8));
+        const std::shared_ptr<Object> yes[] = {MakeBool(true), list.Build()};
+        REQUIRE(Show(interpreter.Execute(test, yes)) == "7");
+        const std::shared_ptr<Object> no[] = {MakeBool(false), yes[1]};
+        REQUIRE(Show(interpreter.Execute(test, no)) == "2");
+    }
+}
+
+TEST_CASE("PreparedExpressionsUseTheInterpreter") {
+    Interpreter interpreter;
+    interpreter.Run("(define scale 3)");
+    auto prepared = interpreter.Prepare("(* ?x scale)");
+    const std::shared_ptr<Object> params[] = {Num(5)};
+    REQUIRE(Show(interpreter.Execute(prepared, params)) == "15");
+    interpreter.Run("(define scale 4)");
+    REQUIRE(Show(interpreter.Execute(prepared, params)) == "20");
+
+    // quoted placeholders are data, and no placeholders is fine
+    REQUIRE(interpreter.Prepare("'(?x)").Params().empty());
+    REQUIRE(Show(interpreter.Execute(interpreter.Prepare("(+ 1 2)"), {})) == "3");
+}
+
+TEST_CASE("PreparedExpressionsErrors") {
+    Interpreter interpreter;
+    REQUIRE_THROWS_AS(interpreter.Prepare("(+ ?x"), SyntaxError);
+    REQUIRE_THROWS_AS(interpreter.Prepare("(if ?x)"), SyntaxError);
+    REQUIRE_THROWS_AS(interpreter.Prepare("(define ?x 1)"), SyntaxError);
+
+    auto prepared = interpreter.Prepare("(car ?x)");
+    REQUIRE_THROWS_AS(interpreter.Execute(prepared, {}), RuntimeError);
+    const std::shared_ptr<Object> params[] = {Num(1)};
+    REQUIRE_THROWS_AS(interpreter.Execute(prepared, params), RuntimeError);
+    REQUIRE_THROWS_AS(interpreter.Execute(interpreter.Prepare("(+ ?x y)"), params), NameError);
+}
@@ -0,0 +1,146 @@
+#include <catch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <error.h>
+#include <scheme.h>
+
+namespace {
+
+void Define(Interpreter* interpreter) {
+    interpreter->Run("(define (count n acc) (if (= n 0) acc (count (- n 1) (+ acc 1))))");
+    interpreter->Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    interpreter->Run("(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))");
+}
+
+}  // namespace
+
+TEST_CASE("EvaluationsTakeTurns") {
+    Interpreter interpreter(Engine::kBytecode);
+    Define(&interpreter);
+    std::vector<std::string> expressions = {"(count 100000 0)", "(fib 15)", "(+ 1 2)",
+                                            "(depth 1000)",
+                                            "(parallel-map (lambda (x) (* x x)) '(1 2 3))"};
+    std::vector<Evaluation> evaluations;
+    for (const auto& expression : expressions) {
+        evaluations.push_back(interpreter.Start(expression));
+    }
+
+    // an event loop of one thread: the slow evaluation does not hold the quick ones
+    std::vector<size_t> slices(evaluations.size());
+    size_t left = evaluations.size();
+    while (left > 0) {
+        for (size_t i = 0; i < evaluations.size(); ++i) {
+            if (!evaluations[i].IsDone()) {
+                ++slices[i];
+                left -= evaluations[i].Resume(100);
+            }
+        }
+    }
+    REQUIRE(evaluations[0].Result() == "100000");
+    REQUIRE(evaluations[1].Result() == "610");
+    REQUIRE(evaluations[2].Result() == "3");
+    REQUIRE(evaluations[3].Result() == "1000");
+    REQUIRE(evaluations[4].Result() == "(1 4 9)");
+    REQUIRE(slices[0] > 1000);
+    REQUIRE(slices[2] == 1);
+    REQUIRE(slices[4] == 1);
+}
+
+TEST_CASE("EvaluationsStopAtEverySafePoint") {
+    Interpreter interpreter(Engine::kBytecode);
+    Define(&interpreter);
+    const std::string expressions[] = {
+        "(fib 10)",
+        "(let ((x 2)) (define (f y) (* x y)) (f (f 3)))",
+        "((lambda (x . rest) (list x rest)) 1 2 3)",
+        "(and 1 (car '(2)) (list 3))",
+        "(let loop ((i 0) (acc '())) (if (= i 5) acc (loop (+ i 1) (cons i acc))))",
+        "(define x (fib 5))",
+        "x"};
+    for (const auto& expression : expressions) {
+        auto evaluation = interpreter.Start(expression);
+        while (!evaluation.Resume(1)) {
+        }
+        REQUIRE(evaluation.Result() == interpreter.Run(expression));
+    }
+}
+
+TEST_CASE("EvaluationsUseEveryEngine") {
+    Interpreter interpreter;
+    Define(&interpreter);
+    // the procedures of the tree engine run to the end within the slice
+    auto evaluation = interpreter.Start("(+ (fib 12) (count 10 0))");
+    REQUIRE(!evaluation.Resume(1));
+    REQUIRE(evaluation.Resume(1000));
+    REQUIRE(evaluation.Result() == "154");
+}
+
+TEST_CASE("EvaluationsMoveBetweenThreads") {
+    Interpreter interpreter(Engine::kBytecode);
+    Define(&interpreter);
+    // the recursion is deep: its frames are in the evaluation, not on a thread
+    auto evaluation = interpreter.Start("(depth 100000)");
+    REQUIRE(!evaluation.Resume(1000));
+    bool done = true;
+    std::thread([&evaluation, &done] { done = evaluation.Resume(50000); }).join();
+    REQUIRE(!done);
+    while (!evaluation.Resume(1000)) {
+    }
+    REQUIRE(evaluation.Result() == "100000");
+    REQUIRE(interpreter.Run("(depth 100000)") == "100000");
+}
+
+TEST_CASE("EvaluationsWaitForChannels") {
+    Interpreter interpreter(Engine::kBytecode);
+    interpreter.Run("(define c (make-channel 2))");
+    interpreter.Run(
+        "(define (produce i n)"
+        "  (cond ((< i n) (channel-send c i) (produce (+ i 1) n)) (else 'sent)))");
+    interpreter.Run(
+        "(define (consume n acc)"
+        "  (if (= n 0) acc (consume (- n 1) (+ acc (channel-receive c)))))");
+    // the consumer starts first and the channel is too small for all the values: each of them
+    // waits for the other in turn on one thread
+    auto consumer = interpreter.Start("(consume 100 0)");
+    auto producer = interpreter.Start("(produce 0 100)");
+    size_t turns = 0;
+    while (!consumer.IsDone() || !producer.IsDone()) {
+        consumer.Resume(10);
+        producer.Resume(10);
+        ++turns;
+    }
+    REQUIRE(consumer.Result() == "4950");
+    REQUIRE(producer.Result() == "sent");
+    REQUIRE(turns > 10);
+
+    // a stopped receive takes the value sent later, outside of evaluations too
+    auto receiver = interpreter.Start("(+ 1 (channel-receive c))");
+    REQUIRE(!receiver.Resume(100));
+    REQUIRE(!receiver.Resume(100));
+    interpreter.Run("(channel-send c 41)");
+    REQUIRE(receiver.Resume(100));
+    REQUIRE(receiver.Result() == "42");
+    auto wrong = interpreter.Start("(channel-receive 1)");
+    REQUIRE_THROWS_AS(wrong.Resume(100), RuntimeError);
+}
+
+TEST_CASE("EvaluationsReportErrors") {
+    Interpreter interpreter(Engine::kBytecode);
+    Define(&interpreter);
+    REQUIRE_THROWS_AS(interpreter.Start("(+ 1"), SyntaxError);
+    REQUIRE_THROWS_AS(interpreter.Start("(if)"), SyntaxError);
+
+    auto evaluation = interpreter.Start("(+ (fib 8) (car (count 10 0)))");
+    REQUIRE(!evaluation.Resume(10));
+    REQUIRE_THROWS_AS(evaluation.Resume(1000), RuntimeError);
+    REQUIRE(evaluation.IsDone());
+    REQUIRE(evaluation.Resume(1));
+
+    auto unbound = interpreter.Start("(count 3 undefined)");
+    REQUIRE_THROWS_AS(unbound.Resume(10), NameError);
+    // the interpreter is fine after the failed evaluations
+    REQUIRE(interpreter.Run("(count 3 0)") == "3");
+}
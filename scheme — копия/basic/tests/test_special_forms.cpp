@@ -0,0 +1,50 @@
+#include "scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "IfSyntax") {
+    ExpectEq("(if (< 1 2) 1 2)", "1");
+    ExpectEq("(if (> 1 2) 1 2)", "2");
+    // everything but #f is true
+    ExpectEq("(if '() 1 2)", "1");
+    ExpectEq("(if 0 1 2)", "1");
+    ExpectEq("(if #f 1)", "()");
+    ExpectEq("(if (not #f) (+ 1 2))", "3");
+}
+
+TEST_CASE_METHOD(SchemeTest, "CondSyntax") {
+    ExpectEq("(cond (#f 1) ((< 1 2) 2 3) (else 4))", "3");
+    ExpectEq("(cond (#f 1) (else 2 4))", "4");
+    ExpectEq("(cond (#f 1))", "()");
+    ExpectEq("(cond)", "()");
+    // a clause without a body gives the value of its test
+    ExpectEq("(cond (#f) ((+ 1 2)))", "3");
+}
+
+TEST_CASE_METHOD(SchemeTest, "WhenSyntax") {
+    ExpectEq("(when (> 2 1) 1 2)", "2");
+    ExpectEq("(when (< 2 1) 1 2)", "()");
+}
+
+TEST_CASE_METHOD(SchemeTest, "SpecialFormsEvaluateOnlyWhatTheyNeed") {
+    ExpectEq("(if #t 1 (car 1))", "1");
+    ExpectEq("(if #f (car 1) 2)", "2");
+    ExpectEq("(cond ((= 1 1) 1) ((car 1) 2) (else (car 1)))", "1");
+    ExpectEq("(when #f (car 1))", "()");
+    ExpectEq("(and #f (car 1))", "#f");
+    ExpectEq("(or '(1) (car 1))", "#t");
+    ExpectEq("(+ 1 (if (and 1 (or #f 2)) 2 (car 1)))", "3");
+
+    ExpectRuntimeError("(if #f 1 (car 1))");
+    ExpectRuntimeError("(and 1 (car 1))");
+    ExpectRuntimeError("(cond ((car 1) 1))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "SpecialFormsInvalidSyntax") {
+    ExpectSyntaxError("(if)");
+    ExpectSyntaxError("(if 1)");
+    ExpectSyntaxError("(if 1 2 3 4)");
+    ExpectSyntaxError("(when 1)");
+    ExpectSyntaxError("(cond 1)");
+    ExpectSyntaxError("(cond (else 1) (#t 2))");
+    ExpectSyntaxError("(cond (else))");
+    ExpectSyntaxError("(and 1 . 2)");
+}
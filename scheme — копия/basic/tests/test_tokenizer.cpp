@@ -68,6 +68,13 @@ TEST_CASE("Symbol names") {
     tokenizer.Next();
     REQUIRE(!tokenizer.IsEnd());
     REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"Am1good?"}});
+
+    // placeholders of prepared expressions
+    std::stringstream placeholders{"?x ?"};
+    Tokenizer other{&placeholders};
+    REQUIRE(other.GetToken() == Token{SymbolToken{"?x"}});
+    other.Next();
+    REQUIRE(other.GetToken() == Token{SymbolToken{"?"}});
 }
 
 TEST_CASE("GetToken is not moving") {
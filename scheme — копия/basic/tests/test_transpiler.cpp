@@ -0,0 +1,52 @@
+#include <catch.hpp>
+
+#include <span>
+
+#include <error.h>
+#include <scheme.h>
+#include <transpiler.h>
+
+// tests/transpiler_corpus.scm, translated at build time
+std::span<const TranspiledExpression> TranspiledCorpus();
+
+namespace {
+
+// The result or the type of the error
+template <class F>
+std::string Evaluate(F&& run) {
+    try {
+        return run();
+    } catch (const RuntimeError&) {
+        return "RuntimeError";
+    } catch (const SyntaxError&) {
+        return "SyntaxError";
+    } catch (const NameError&) {
+        return "NameError";
+    }
+}
+
+}  // namespace
+
+TEST_CASE("TranspiledMatchesInterpreter") {
+    Interpreter interpreter;
+    REQUIRE(TranspiledCorpus().size() == 45);
+    for (const auto& expression : TranspiledCorpus()) {
+        std::string source(expression.source);
+        INFO(source);
+        auto expected = Evaluate([&] { return interpreter.Run(source); });
+        for (int i = 0; i < 2; ++i) {
+            REQUIRE(Evaluate([&] { return Run(expression); }) == expected);
+        }
+    }
+}
+
+TEST_CASE("TranspilerSpecializesNumbers") {
+    auto code = Transpiler().Translate({"(+ 1 (* 2 3))", "(+ 1 (car '(2)))"}, "Program");
+    // the first one is plain arithmetic, the second one calls the builtins
+    REQUIRE(code.find("CheckedAdd(int64_t{1}, t0)") != std::string::npos);
+    REQUIRE(code.find("FindBuiltin(\"car\")") != std::string::npos);
+    REQUIRE(code.find("FindBuiltin(\"*\")") == std::string::npos);
+    REQUIRE_THROWS_AS(Transpiler().Translate({"(+ 1"}, "Program"), SyntaxError);
+    REQUIRE_THROWS_AS(Transpiler().Translate({"(lambda (x) x)"}, "Program"), SyntaxError);
+    REQUIRE_THROWS_AS(Transpiler().Translate({"(define x 1)"}, "Program"), SyntaxError);
+}
@@ -0,0 +1,205 @@
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "DefineGlobals") {
+    ExpectEq("(define x 10)", "()");
+    ExpectEq("x", "10");
+    ExpectEq("(+ x 1)", "11");
+    ExpectEq("(define x (* x 2))", "()");
+    ExpectEq("x", "20");
+    ExpectEq("(define (square n) (* n n))", "()");
+    ExpectEq("(square x)", "400");
+    // a procedure sees the globals defined after it
+    ExpectEq("(define (twice-y) (* 2 y))", "()");
+    ExpectNameError("(twice-y)");
+    ExpectEq("(define y 4)", "()");
+    ExpectEq("(twice-y)", "8");
+}
+
+TEST_CASE_METHOD(SchemeTest, "UnboundVariables") {
+    ExpectNameError("x");
+    ExpectNameError("(+ 1 x)");
+    ExpectNameError("(foo 1 2)");
+    ExpectNameError("(let ((y x)) y)");
+    // the builtins are values, which can not be printed
+    ExpectSyntaxError("max");
+    ExpectEq("((if #t max min) 1 2)", "2");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Lambda") {
+    ExpectEq("((lambda (x y) (+ x y)) 1 2)", "3");
+    ExpectEq("((lambda () 5))", "5");
+    ExpectEq("((lambda (x) (+ x 1) (* x 2)) 3)", "6");
+    ExpectEq("(define add (lambda (a b) (+ a b)))", "()");
+    ExpectEq("(add 2 3)", "5");
+    ExpectRuntimeError("(add 1)");
+    ExpectRuntimeError("(add 1 2 3)");
+    ExpectRuntimeError("(1 2)");
+    ExpectRuntimeError("((car '(1)) 2)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VariadicLambda") {
+    ExpectEq("((lambda args args) 1 2 3)", "(1 2 3)");
+    ExpectEq("((lambda args args))", "()");
+    ExpectEq("((lambda (a . rest) (list a rest)) 1 2 3)", "(1 (2 3))");
+    ExpectEq("(define (count first . rest) (+ 1 (length rest)))", "()");
+    ExpectEq("(count 1 2 3 4)", "4");
+    ExpectRuntimeError("(count)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Closures") {
+    ExpectEq("(define (make-adder n) (lambda (x) (+ x n)))", "()");
+    ExpectEq("(define add5 (make-adder 5))", "()");
+    ExpectEq("(add5 10)", "15");
+    ExpectEq("((make-adder 1) 2)", "3");
+    // captured through a lambda which does not use the variable itself
+    ExpectEq("((((lambda (a) (lambda (b) (lambda (c) (list a b c)))) 1) 2) 3)", "(1 2 3)");
+    ExpectEq("(define (compose f g) (lambda (x) (f (g x))))", "()");
+    ExpectEq("((compose abs -) 5)", "5");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Let") {
+    ExpectEq("(let ((x 1) (y 2)) (+ x y))", "3");
+    ExpectEq("(let () 5)", "5");
+    // the values are evaluated outside of the scope of the variables
+    ExpectEq("(let ((x 1)) (let ((x 2) (y x)) (list x y)))", "(2 1)");
+    ExpectEq("(let ((x (let ((y 2)) (* y y))) (y (let ((z 3)) z))) (list x y))", "(4 3)");
+    ExpectEq("(let ((f (lambda (n) (* n 10)))) (f 4))", "40");
+    ExpectEq("(let ((x 1)) (define y 2) (define (z) (+ x y)) (z))", "3");
+}
+
+TEST_CASE_METHOD(SchemeTest, "NamedLet") {
+    ExpectEq("(let loop ((i 0) (acc '())) (if (= i 3) acc (loop (+ i 1) (cons i acc))))",
+             "(2 1 0)");
+    ExpectEq("(define (fact n)"
+             "  (let loop ((n n) (acc 1)) (if (= n 0) acc (loop (- n 1) (* acc n)))))",
+             "()");
+    ExpectEq("(fact 20)", "2432902008176640000");
+}
+
+TEST_CASE_METHOD(SchemeTest, "InternalDefinitions") {
+    ExpectEq("(define (f x) (define y (* x 2)) (define (g z) (+ y z)) (g 1))", "()");
+    ExpectEq("(f 5)", "11");
+    // a procedure defined in a body can call itself
+    ExpectEq("(define (sum n)"
+             "  (define (go i acc) (if (> i n) acc (go (+ i 1) (+ acc i))))"
+             "  (go 0 0))",
+             "()");
+    ExpectEq("(sum 100)", "5050");
+    // a definition is a variable of the whole body, but it has no value before it is evaluated
+    ExpectNameError("((lambda () (define a b) (define b 1) a))");
+    // the procedures defined in a body can call each other
+    ExpectEq("(define (parity n)"
+             "  (define (ev? n) (if (= n 0) #t (od? (- n 1))))"
+             "  (define (od? n) (if (= n 0) #f (ev? (- n 1))))"
+             "  (list (ev? n) (od? n)))",
+             "()");
+    ExpectEq("(parity 10)", "(#t #f)");
+    ExpectEq("(parity 7)", "(#f #t)");
+    ExpectEq("(parity 100000)", "(#t #f)");
+    // also through the lambdas in them, and after they are returned
+    ExpectEq("(define (make-od)"
+             "  (define (ev? n) (if (= n 0) #t ((lambda () (od? (- n 1))))))"
+             "  (define (od? n) (if (= n 0) #f (ev? (- n 1))))"
+             "  od?)",
+             "()");
+    ExpectEq("((make-od) 9)", "#t");
+    ExpectNameError("((lambda () (define (a) (b)) (a) (define (b) 1) 2))");
+    ExpectEq("((lambda () (define (a) (b)) (define (b) 1) (a)))", "1");
+    // and the variables defined after them, once those are evaluated
+    ExpectEq("(define (f) (define (g) x) (define x 5) (g))", "()");
+    ExpectEq("(f)", "5");
+    ExpectEq("((lambda () (define (g) (lambda () (cons x y))) (define x 1) (define y 2) "
+             "(define (h) y) (list ((g)) (h))))",
+             "((1 . 2) 2)");
+    ExpectEq("((lambda () (define (g) (list x)) (define x '()) (g)))", "(())");
+    ExpectNameError("((lambda () (define (g) x) (define x (g)) x))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ShadowedBuiltins") {
+    ExpectEq("(let ((max 1)) (+ max 1))", "2");
+    ExpectEq("((lambda (+) (+ 2 3)) *)", "6");
+    ExpectEq("(let ((list (lambda args 0))) (list 1 2))", "0");
+    ExpectEq("(list 1 2)", "(1 2)");
+    // globals can not shadow them
+    ExpectSyntaxError("(define max 1)");
+    ExpectSyntaxError("(define (car x) x)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "BindingFormsInvalidSyntax") {
+    ExpectSyntaxError("(define)");
+    ExpectSyntaxError("(define x)");
+    ExpectSyntaxError("(define x 1 2)");
+    ExpectSyntaxError("(define 1 2)");
+    ExpectSyntaxError("(define (f))");
+    ExpectSyntaxError("(+ 1 (define x 1))");
+    ExpectSyntaxError("(lambda)");
+    ExpectSyntaxError("(lambda (x))");
+    ExpectSyntaxError("(lambda (x x) x)");
+    ExpectSyntaxError("(lambda (1) 1)");
+    ExpectSyntaxError("(lambda (if) 1)");
+    ExpectSyntaxError("(let ((x)) x)");
+    ExpectSyntaxError("(let ((x 1)))");
+    ExpectSyntaxError("(let x)");
+    ExpectSyntaxError("(let ((x 1) (x 2)) x)");
+    ExpectSyntaxError("(let () (define a 1) (define a 2) a)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ProperTailCalls") {
+    // each of these would need a million nested calls without tail call elimination
+    ExpectEq("(let loop ((i 0)) (if (< i 1000000) (loop (+ i 1)) i))", "1000000");
+    ExpectEq("(define (count-down n) (cond ((= n 0) 'done) (else (count-down (- n 1)))))", "()");
+    ExpectEq("(count-down 1000000)", "done");
+    ExpectEq("(define (even? n) (if (= n 0) #t (odd? (- n 1))))", "()");
+    ExpectEq("(define (odd? n) (if (= n 0) #f (even? (- n 1))))", "()");
+    ExpectEq("(even? 1000001)", "#f");
+    ExpectEq("(define (run n) (when (> n 0) (let ((m (- n 1))) (run m))))", "()");
+    ExpectEq("(run 1000000)", "()");
+    // the last operands of and and or are in tail position too
+    ExpectEq("(define (all n) (and (>= n 0) (or (= n 0) (all (- n 1)))))", "()");
+    ExpectEq("(all 1000000)", "#t");
+    ExpectEq("(define (none n) (or (< n 0) (and (> n 0) (none (- n 1)))))", "()");
+    ExpectEq("(none 1000000)", "#f");
+    ExpectEq("(define (skip n)"
+             "  (cond ((= n 0) 'done) ((> n 5) (skip (- n 2))) (else (skip (- n 1)))))",
+             "()");
+    ExpectEq("(skip 1000000)", "done");
+    // and their values are still checked by and and or
+    ExpectEq("(define (quoted) '(1))", "()");
+    ExpectEq("(define (empty) '())", "()");
+    ExpectEq("(define (first-or) (or #f (quoted)))", "()");
+    ExpectEq("(first-or)", "#t");
+    ExpectEq("(define (first-and) (and 1 (empty)))", "()");
+    ExpectEq("(first-and)", "#f");
+    ExpectEq("(define (nested) (and 1 (first-or)))", "()");
+    ExpectEq("(nested)", "#t");
+}
+
+TEST_CASE("DeepRecursion") {
+    const std::string depth = "(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))";
+    // the tree engine recurses on the stack of the thread, it ends the recursion with an error
+    // when the stack is about to run out
+    Interpreter tree(Engine::kTree);
+    tree.Run(depth);
+    REQUIRE(tree.Run("(depth 1000)") == "1000");
+    REQUIRE_THROWS_AS(tree.Run("(depth 1000000)"), RuntimeError);
+    REQUIRE_THROWS_AS(tree.Run("(touch (future (depth 1000000)))"), RuntimeError);
+    REQUIRE(tree.Run("(depth 1000)") == "1000");
+    // the frames of the VM are not on the stack, but the calls through builtins are
+    Interpreter bytecode(Engine::kBytecode);
+    bytecode.Run(depth);
+    REQUIRE(bytecode.Run("(depth 1000000)") == "1000000");
+    // they are on the heap, which a recursion without an end must not take all of
+    bytecode.Run("(define (endless n) (+ 1 (endless n)))");
+    REQUIRE_THROWS_AS(bytecode.Run("(endless 1)"), RuntimeError);
+    auto evaluation = bytecode.Start("(endless 1)");
+    REQUIRE_THROWS_AS(evaluation.Resume(std::numeric_limits<uint64_t>::max()), RuntimeError);
+    REQUIRE(bytecode.Run("(depth 1000)") == "1000");
+    bytecode.Run("(define (f n) (if (= n 0) 0 (+ 1 (car (parallel-map f (list (- n 1)))))))");
+    REQUIRE(bytecode.Run("(f 100)") == "100");
+    REQUIRE_THROWS_AS(bytecode.Run("(f 1000000)"), RuntimeError);
+    REQUIRE(bytecode.Run("(f 100)") == "100");
+}
@@ -0,0 +1,46 @@
+; Expressions translated by scheme_basic_transpile for test_transpiler.cpp
+(+ 1 2 3)
+(- 10 (* 2 3) 1)
+(- 5)
+(/ 100 7 2)
+(max 3 -8 (abs -11) 2)
+(min 3 -8 11 2)
+(< 1 3 2)
+(>= 3 3 4)
+(= (* 2 2) 4 (+ 2 2))
+(<)
+(+)
+(*)
+42
+#t
+'(1 (2 #t) . x)
+'()
+(quote symbol)
+(list 1 (+ 1 1) '(3 4))
+(cons (car '(1 2)) (cdr '(3 4 5)))
+(list-ref (list 1 2 3) (- 3 1))
+(length (list 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 26 27 28 29 30 31 32 33))
+(and 1 2 (or #f 3))
+(not (pair? '()))
+(foo 1 2)
+(+ (length '(1 2 3)) (* 2 (car '(5 6))))
+(< (length '(1 2)) (length '(1 2 3)))
+(+ 1 (< 1 2))
+(< 2 1 (car '(#t)))
+(+ 9223372036854775807 1)
+(- -9223372036854775807 1)
+(abs -9223372036854775808)
+(/ 1 (- 2 2))
+(/ -9223372036854775808 -1)
+(+ 1 (car '()))
+(1 2)
+('(1) 2)
+(+ ())
+(cdr '(1 . 2))
+(if (< 1 2) (+ 1 1) (car 1))
+(cond (#f 1) ((car '(#f)) 2) (else (when (= 1 1) 3 (and 4 (or #f 5)))))
+(if #f 1)
+(let ((x 2) (y (+ 1 2))) (* x y))
+(let ((max 1) (x (max 1 2))) (let ((x (+ x max))) x))
+(let ((f max)) (f 1 (abs -5)))
+(+ 1 x)
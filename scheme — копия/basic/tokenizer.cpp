@@ -1,6 +1,20 @@
 #include <tokenizer.h>
+#include <charconv>
 #include "error.h"
 
+namespace {
+
+int64_t ParseNumber(const std::string& str) {
+    int64_t value = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end != str.data() + str.size()) {
+        throw SyntaxError("number is out of range");
+    }
+    return value;
+}
+
+}  // namespace
+
 bool operator==(BracketToken lhs, BracketToken rhs) {
     return static_cast<int>(lhs) == static_cast<int>(rhs);
 }
@@ -54,7 +68,7 @@ void Tokenizer::Next() {
                 break;
             }
         }
-        int value = std::stoi(num_str);
+        int64_t value = ParseNumber(num_str);
         curr_token_ = ConstantToken{value};
         return;
     } else if (ch == '-' && input_->peek() == ' ') {
@@ -70,7 +84,7 @@ void Tokenizer::Next() {
             ch = input_->get();
             num_str += ch;
         }
-        int value = std::stoi(num_str);
+        int64_t value = ParseNumber(num_str);
         curr_token_ = ConstantToken{value};
         return;
     } else if (ch == '+' && std::isdigit(input_->peek())) {
@@ -79,7 +93,7 @@ void Tokenizer::Next() {
             ch = input_->get();
             num_str += ch;
         }
-        int value = std::stoi(num_str);
+        int64_t value = ParseNumber(num_str);
         curr_token_ = ConstantToken{value};
         return;
     } else if (ch == '+' && input_->peek() == ' ') {
@@ -101,7 +115,8 @@ void Tokenizer::Next() {
             return;
         }
     } else if ((ch >= 65 && ch <= 90) || (ch >= 97 && ch <= 122) || ch == '=' || ch == '*' ||
-               ch == '#' || ch == '-' || ch == '+' || ch == '/' || ch == '>' || ch == '<') {
+               ch == '#' || ch == '-' || ch == '+' || ch == '/' || ch == '>' || ch == '<' ||
+               ch == '?') {
         std::string symbol;
         symbol += ch;
         while ((std::isalnum(input_->peek()) || input_->peek() == '<' || input_->peek() == '>' ||
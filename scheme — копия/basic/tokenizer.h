@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <variant>
 #include <optional>
 #include <istream>
@@ -51,13 +52,13 @@ struct DotToken {
 enum class BracketToken { OPEN, CLOSE };
 
 struct ConstantToken {
-    int value;
+    int64_t value;
     // ConstantToken(int val) : value(val) {}
     bool operator==(const ConstantToken& other) const {
         return value == other.value;
     };
 
-    int GetValue() {
+    int64_t GetValue() {
         return value;
     }
 };
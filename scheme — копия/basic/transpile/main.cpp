@@ -0,0 +1,47 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "transpiler.h"
+
+// Translates a file of Scheme expressions, one per line, into C++:
+//     scheme_basic_transpile <input.scm> <output.cpp> <function name>
+// Blank lines and lines starting with ; are skipped.
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        std::cerr << "usage: " << argv[0] << " <input.scm> <output.cpp> <function name>\n";
+        return 2;
+    }
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "can not read " << argv[1] << "\n";
+        return 1;
+    }
+    std::vector<std::string> expressions;
+    std::string line;
+    while (std::getline(input, line)) {
+        auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == ';') {
+            continue;
+        }
+        auto end = line.find_last_not_of(" \t\r");
+        expressions.push_back(line.substr(begin, end - begin + 1));
+    }
+
+    std::string code;
+    try {
+        code = Transpiler().Translate(expressions, argv[3]);
+    } catch (const SyntaxError& e) {
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+    std::ofstream output(argv[2]);
+    output << code;
+    if (!output) {
+        std::cerr << "can not write " << argv[2] << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,474 @@
+#include "transpiler.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "builtins.h"
+#include "jit.h"
+#include "parser.h"
+#include "printer.h"
+#include "special_forms.h"
+#include "tokenizer.h"
+
+namespace {
+
+std::string Quoted(std::string_view str) {
+    std::string res = "\"";
+    for (char c : str) {
+        switch (c) {
+            case '"':
+            case '\\':
+                res += '\\';
+                res += c;
+                break;
+            case '\n':
+                res += "\\n";
+                break;
+            case '\r':
+                res += "\\r";
+                break;
+            case '\t':
+                res += "\\t";
+                break;
+            default:
+                res += c;
+        }
+    }
+    res += '"';
+    return res;
+}
+
+std::string Literal(int64_t value) {
+    if (value == std::numeric_limits<int64_t>::min()) {
+        return "std::numeric_limits<int64_t>::min()";
+    }
+    return "int64_t{" + std::to_string(value) + "}";
+}
+
+// A subexpression in the generated code: an int64_t if it is statically known to be a number,
+// a std::shared_ptr<Object> otherwise. literal is the parsed object for literals.
+struct Value {
+    std::string code;
+    bool fixnum = false;
+    std::shared_ptr<Object> literal;
+};
+
+// Writes the functions of one program, the constants and builtins they use are shared.
+// Mirrors Compiler::Compile.
+class Writer {
+public:
+    std::string Function(const std::shared_ptr<Object>& obj, const std::string& name) {
+        body_.clear();
+        indent_ = "    ";
+        temps_ = 0;
+        Value res = obj == nullptr ? Fail("can not calculate") : Expression(obj);
+        std::string boxed = Boxed(res);
+        return "std::shared_ptr<Object> " + name + "() {\n" + body_ + "    return " + boxed +
+               ";\n}\n";
+    }
+
+    const std::string& Globals() const {
+        return globals_;
+    }
+
+private:
+    Value Expression(const std::shared_ptr<Object>& obj) {
+        if (auto cell = As<Cell>(obj)) {
+            return Call(cell);
+        }
+        if (auto symbol = As<Symbol>(obj)) {
+            return Variable(symbol->GetName());
+        }
+        if (auto number = As<Number>(obj)) {
+            return {Literal(number->GetValue()), true, obj};
+        }
+        return {Constant(obj), false, obj};
+    }
+
+    Value Call(const std::shared_ptr<Cell>& cell) {
+        auto first = cell->GetFirst();
+        if (auto symbol = As<Symbol>(first)) {
+            SpecialForm form;
+            if (FindSpecialForm(symbol->GetName(), &form)) {
+                return SpecialFormCode(ParseSpecialForm(form, cell->GetSecond()));
+            }
+            if (FindBuiltin(symbol->GetName()) == nullptr || FindLocal(symbol->GetName())) {
+                return Apply(cell);
+            }
+            // вложенные списки вычисляются, символы это переменные, остальное вычисляется в себя
+            std::vector<Value> args;
+            bool fixnums = true;
+            for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next()) {
+                args.push_back(Expression(it.Head()));
+                fixnums = fixnums && args.back().fixnum;
+            }
+            NumericOp op;
+            if (fixnums && FindNumericOp(symbol->GetName(), &op) && AcceptsArgs(op, args.size())) {
+                return Numeric(op, args);
+            }
+            return {Temp("std::shared_ptr<Object>", Generic(symbol->GetName(), args)), false,
+                    nullptr};
+        }
+        if (Is<Quote>(first)) {
+            if (cell->GetSecond() != nullptr) {
+                return Fail("quote takes one argument");
+            }
+            return {Constant(first), false, first};
+        }
+        if (Is<Cell>(first)) {
+            return Apply(cell);
+        }
+        return Fail("can not apply");
+    }
+
+    // A call of something which is not known until it is evaluated, Invoke does the checks
+    Value Apply(const std::shared_ptr<Cell>& cell) {
+        std::string callee = Boxed(Expression(cell->GetFirst()));
+        std::string items;
+        size_t count = 0;
+        for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next(), ++count) {
+            items += (count == 0 ? "" : ", ") + Boxed(Expression(it.Head()));
+        }
+        if (count == 0) {
+            return {Temp("std::shared_ptr<Object>", "Invoke(" + callee + ", {})"), false, nullptr};
+        }
+        std::string array = "t" + std::to_string(temps_++);
+        body_ += indent_ + "const std::shared_ptr<Object> " + array + "[] = {" + items + "};\n";
+        return {Temp("std::shared_ptr<Object>", "Invoke(" + callee + ", " + array + ")"), false,
+                nullptr};
+    }
+
+    // The variables of let are the values they are bound to. There are no globals: the
+    // expressions are translated one by one, so a name which is not bound here is unbound.
+    Value Variable(const std::string& name) {
+        if (const Value* local = FindLocal(name)) {
+            return *local;
+        }
+        if (FindBuiltin(name) != nullptr) {
+            return {Builtin(name), false, nullptr};
+        }
+        body_ += indent_ + "throw NameError(" + Quoted("unbound variable " + name) + ");\n";
+        return {"nullptr", false, nullptr};
+    }
+
+    const Value* FindLocal(const std::string& name) const {
+        for (auto it = locals_.rbegin(); it != locals_.rend(); ++it) {
+            if (it->first == name) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    // Plain let, without definitions in its body. The values are computed once, in temporaries
+    // which stay in scope for the body.
+    Value Let(const SpecialFormSyntax& syntax) {
+        if (syntax.form != SpecialForm::kLet || !syntax.name.empty()) {
+            throw SyntaxError("procedures are not supported by the transpiler");
+        }
+        for (const auto& name : BodyDefinitions(syntax.lambda->body)) {
+            if (!name.empty()) {
+                throw SyntaxError("define is not supported by the transpiler");
+            }
+        }
+        std::vector<Value> values;
+        for (const auto& value : syntax.operands) {
+            values.push_back(Expression(value));
+        }
+        size_t mark = locals_.size();
+        for (size_t i = 0; i < values.size(); ++i) {
+            locals_.emplace_back(syntax.lambda->params[i], std::move(values[i]));
+        }
+        Value res;
+        for (const auto& expression : syntax.lambda->body) {
+            res = Expression(expression);
+        }
+        locals_.resize(mark);
+        return res;
+    }
+
+    // The operands are evaluated in nested blocks, each one only if the ones before did not
+    // decide the result
+    Value SpecialFormCode(const SpecialFormSyntax& syntax) {
+        if (syntax.form == SpecialForm::kDefine) {
+            throw SyntaxError("define is not supported by the transpiler");
+        }
+        if (syntax.lambda) {
+            return Let(syntax);
+        }
+        std::string res = "t" + std::to_string(temps_++);
+        body_ += indent_ + "std::shared_ptr<Object> " + res + ";\n";
+        size_t depth = 0;
+        if (syntax.form == SpecialForm::kAnd || syntax.form == SpecialForm::kOr) {
+            bool is_and = syntax.form == SpecialForm::kAnd;
+            std::string empty = is_and ? "MakeBool(true)" : "MakeBool(false)";
+            std::string decided = is_and ? "MakeBool(false)" : "MakeBool(true)";
+            if (syntax.operands.empty()) {
+                body_ += indent_ + res + " = " + empty + ";\n";
+            }
+            for (size_t i = 0; i < syntax.operands.size(); ++i) {
+                Value value = Expression(syntax.operands[i]);
+                body_ += indent_ + res + " = " + Boxed(value) + ";\n";
+                body_ += indent_ + (is_and ? "if (StopsAnd(" : "if (StopsOr(") + res + ")) {\n";
+                indent_ += "    ";
+                body_ += indent_ + res + " = " + decided + ";\n";
+                if (i + 1 < syntax.operands.size()) {
+                    Else();
+                }
+                ++depth;
+            }
+        } else {
+            bool has_else = false;
+            for (const auto& clause : syntax.clauses) {
+                if (clause.is_else) {
+                    Sequence(clause.body, res);
+                    has_else = true;
+                    break;
+                }
+                Value test = Expression(clause.test);
+                if (clause.body.empty()) {
+                    body_ += indent_ + res + " = " + Boxed(test) + ";\n";
+                    body_ += indent_ + "if (!IsTrue(" + res + ")) {\n";
+                    indent_ += "    ";
+                } else {
+                    body_ += indent_ + "if (IsTrue(" + Boxed(test) + ")) {\n";
+                    indent_ += "    ";
+                    Sequence(clause.body, res);
+                    Else();
+                }
+                ++depth;
+            }
+            if (!has_else) {
+                body_ += indent_ + res + " = nullptr;\n";
+            }
+        }
+        for (; depth > 0; --depth) {
+            indent_.resize(indent_.size() - 4);
+            body_ += indent_ + "}\n";
+        }
+        return {res, false, nullptr};
+    }
+
+    // Closes the block of the then branch and opens the one of the else branch
+    void Else() {
+        indent_.resize(indent_.size() - 4);
+        body_ += indent_ + "} else {\n";
+        indent_ += "    ";
+    }
+
+    void Sequence(const std::vector<std::shared_ptr<Object>>& body, const std::string& res) {
+        for (size_t i = 0; i < body.size(); ++i) {
+            Value value = Expression(body[i]);
+            if (i + 1 == body.size()) {
+                body_ += indent_ + res + " = " + Boxed(value) + ";\n";
+            }
+        }
+    }
+
+    // Calls with one or two arguments use the fast entry points, the others get an array.
+    std::string Generic(const std::string& name, const std::vector<Value>& args) {
+        std::string functor = Builtin(name);
+        if (args.empty()) {
+            return functor + "->Apply({})";
+        }
+        if (args.size() == 1) {
+            return functor + "->ApplyUnary(" + Boxed(args[0]) + ")";
+        }
+        if (args.size() == 2) {
+            return functor + "->ApplyBinary(" + Boxed(args[0]) + ", " + Boxed(args[1]) + ")";
+        }
+        std::string items;
+        for (size_t i = 0; i < args.size(); ++i) {
+            items += (i == 0 ? "" : ", ") + Boxed(args[i]);
+        }
+        std::string array = "t" + std::to_string(temps_++);
+        body_ += indent_ + "const std::shared_ptr<Object> " + array + "[] = {" + items + "};\n";
+        return functor + "->Apply(" + array + ")";
+    }
+
+    // Same results and errors as the builtins: the Checked* functions are theirs.
+    Value Numeric(NumericOp op, const std::vector<Value>& args) {
+        auto fold = [&args](const std::string& function) {
+            std::string res = args[0].code;
+            for (size_t i = 1; i < args.size(); ++i) {
+                res = function + "(" + res + ", " + args[i].code + ")";
+            }
+            return res;
+        };
+        switch (op) {
+            case NumericOp::kAdd:
+                return Fixnum(args.empty() ? Literal(0) : fold("CheckedAdd"));
+            case NumericOp::kSub:
+                return Fixnum(fold("CheckedSub"));
+            case NumericOp::kMul:
+                return Fixnum(args.empty() ? Literal(1) : fold("CheckedMul"));
+            case NumericOp::kDiv:
+                return Fixnum(fold("CheckedDiv"));
+            case NumericOp::kMax:
+                return Fixnum(fold("std::max"));
+            case NumericOp::kMin:
+                return Fixnum(fold("std::min"));
+            case NumericOp::kAbs: {
+                const auto& arg = args[0].code;
+                return Fixnum(arg + " < 0 ? CheckedSub(0, " + arg + ") : " + arg);
+            }
+            default:
+                break;
+        }
+        // the first argument is compared with each of the others
+        const char* compare = op == NumericOp::kLess      ? " < "
+                              : op == NumericOp::kLessEq  ? " <= "
+                              : op == NumericOp::kGreater ? " > "
+                              : op == NumericOp::kGreaterEq ? " >= "
+                                                            : " == ";
+        std::string condition = "true";
+        for (size_t i = 1; i < args.size(); ++i) {
+            condition = (i == 1 ? "" : condition + " && ") + args[0].code + compare + args[i].code;
+        }
+        return {Temp("std::shared_ptr<Object>", "MakeBool(" + condition + ")"), false, nullptr};
+    }
+
+    Value Fixnum(const std::string& code) {
+        return {Temp("int64_t", code), true, nullptr};
+    }
+
+    Value Fail(const std::string& message) {
+        body_ += indent_ + "throw RuntimeError(" + Quoted(message) + ");\n";
+        return {"nullptr", false, nullptr};
+    }
+
+    std::string Boxed(const Value& value) {
+        if (value.literal != nullptr && value.fixnum) {
+            return Constant(value.literal);
+        }
+        if (value.fixnum) {
+            return "std::make_shared<Number>(" + value.code + ")";
+        }
+        return value.code;
+    }
+
+    // Temporaries keep the order of evaluation of the interpreter.
+    std::string Temp(const std::string& type, const std::string& code) {
+        std::string name = "t" + std::to_string(temps_++);
+        body_ += indent_ + "const " + type + " " + name + " = " + code + ";\n";
+        return name;
+    }
+
+    // Literals are built once, when the program is loaded
+    std::string Constant(const std::shared_ptr<Object>& obj) {
+        std::string name = "constant" + std::to_string(constants_++);
+        globals_ += "const std::shared_ptr<Object> " + name + " = " + ObjectCode(obj) + ";\n";
+        return name;
+    }
+
+    std::string ObjectCode(const std::shared_ptr<Object>& obj) {
+        if (obj == nullptr) {
+            return "nullptr";
+        }
+        if (auto number = As<Number>(obj)) {
+            return "std::make_shared<Number>(" + Literal(number->GetValue()) + ")";
+        }
+        if (auto boolean = As<Boolean>(obj)) {
+            return boolean->GetValue() ? "MakeBool(true)" : "MakeBool(false)";
+        }
+        if (auto symbol = As<Symbol>(obj)) {
+            return "std::make_shared<Symbol>(" + Quoted(symbol->GetName()) + ")";
+        }
+        if (auto quote = As<Quote>(obj)) {
+            return "std::make_shared<Quote>(" + ObjectCode(quote->GetObject()) + ")";
+        }
+        std::string code = "transpiled::List({";
+        ListWalker it(obj);
+        for (bool first = true; it.AtCell(); it.Next(), first = false) {
+            code += (first ? "" : ", ") + ObjectCode(it.Head());
+        }
+        return code + "}, " + ObjectCode(it.Rest()) + ")";
+    }
+
+    std::string Builtin(const std::string& name) {
+        auto it = builtins_.find(name);
+        if (it == builtins_.end()) {
+            std::string variable = "builtin" + std::to_string(builtins_.size());
+            globals_ += "const std::shared_ptr<Object>& " + variable + " = FindBuiltin(" +
+                        Quoted(name) + ");\n";
+            it = builtins_.emplace(name, std::move(variable)).first;
+        }
+        return it->second;
+    }
+
+    std::string globals_;
+    std::map<std::string, std::string> builtins_;
+    size_t constants_ = 0;
+
+    std::string body_;
+    std::string indent_;
+    size_t temps_ = 0;
+    std::vector<std::pair<std::string, Value>> locals_;
+};
+
+std::shared_ptr<Object> Parse(const std::string& expression) {
+    std::stringstream ss{expression};
+    Tokenizer tokenizer{&ss};
+    auto obj = Read(&tokenizer);
+    if (!tokenizer.IsEnd()) {
+        throw SyntaxError("not end");
+    }
+    return obj;
+}
+
+}  // namespace
+
+std::string Run(const TranspiledExpression& expression) {
+    std::string res;
+    Printer().Print(expression.evaluate(), &res);
+    return res;
+}
+
+std::string Transpiler::Translate(const std::vector<std::string>& expressions,
+                                  const std::string& name) {
+    Writer writer;
+    std::string functions;
+    std::string table;
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        std::shared_ptr<Object> obj;
+        try {
+            obj = Parse(expressions[i]);
+        } catch (const SyntaxError& e) {
+            throw SyntaxError(std::string(e.what()) + " in " + expressions[i]);
+        }
+        std::string function = "Expression" + std::to_string(i);
+        try {
+            functions += "\n" + writer.Function(obj, function);
+        } catch (const SyntaxError& e) {
+            throw SyntaxError(std::string(e.what()) + " in " + expressions[i]);
+        }
+        table += "    {" + Quoted(expressions[i]) + ", " + function + "},\n";
+    }
+
+    std::string res =
+        "// Generated by scheme_basic_transpile, do not edit.\n"
+        "#include <algorithm>\n"
+        "#include <cstdint>\n"
+        "#include <limits>\n"
+        "#include <span>\n"
+        "\n"
+        "#include \"builtins.h\"\n"
+        "#include \"environment.h\"\n"
+        "#include \"error.h\"\n"
+        "#include \"special_forms.h\"\n"
+        "#include \"transpiler.h\"\n"
+        "\n"
+        "namespace {\n"
+        "\n";
+    res += writer.Globals() + functions;
+    if (!expressions.empty()) {
+        res += "\nconst TranspiledExpression kExpressions[] = {\n" + table + "};\n";
+    }
+    res += "\n}  // namespace\n\nstd::span<const TranspiledExpression> " + name + "() {\n";
+    res += expressions.empty() ? "    return {};\n}\n" : "    return kExpressions;\n}\n";
+    return res;
+}
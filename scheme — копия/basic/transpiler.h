@@ -0,0 +1,49 @@
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+
+// Ahead-of-time translation of Scheme expressions into C++ linked against scheme_basic.
+// Builtins are resolved at translation time, literals become constants built once at startup,
+// and arithmetic whose arguments are statically known to be numbers is done on int64_t directly,
+// so the generated code does no parsing or dispatch at all. Results and errors are the same as
+// those of Interpreter::Run for the source expression.
+// The variables of let are C++ values of the generated function. Procedures are not translated:
+// lambda, named let and define are rejected, and the expressions have no globals to share.
+
+// One expression of a translated program
+struct TranspiledExpression {
+    std::string_view source;
+    std::shared_ptr<Object> (*evaluate)();
+};
+
+// Same as Interpreter::Run(expression.source).
+std::string Run(const TranspiledExpression& expression);
+
+class Transpiler {
+public:
+    // Translates each expression into a function and defines
+    //     std::span<const TranspiledExpression> name();
+    // returning them in order. Throws SyntaxError if an expression can not be parsed or
+    // defines a procedure or a variable other than one of let.
+    std::string Translate(const std::vector<std::string>& expressions, const std::string& name);
+};
+
+// Support code for the generated sources
+namespace transpiled {
+
+inline std::shared_ptr<Object> List(std::initializer_list<std::shared_ptr<Object>> items,
+                                    std::shared_ptr<Object> tail) {
+    ListBuilder builder;
+    for (const auto& item : items) {
+        builder.Add(item);
+    }
+    return builder.Build(std::move(tail));
+}
+
+}  // namespace transpiled
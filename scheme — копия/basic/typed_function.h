@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "budget.h"
+#include "error.h"
+#include "object.h"
+
+// Builtins written as typed C++ functions. A builtin is declared as
+//
+//     struct Abs : TypedFunction<Abs> {
+//         static int64_t Run(int64_t x);
+//     };
+//
+// and everything else is generated from the signature of Run at compile time: the arity, the
+// checks of the argument types and their unboxing, which throw the same RuntimeError for every
+// builtin, and the boxing of the result. Run is called directly, without casts or virtual calls.
+//
+// Parameter types:
+//   int64_t                         a number
+//   bool                            a boolean
+//   std::shared_ptr<Cell>           a pair, quoted or not
+//   ListView                        a list, quoted or not: a pair or the empty list
+//   const std::shared_ptr<Object>&  any value, as is
+//   Numbers                         as the only parameter: any number of numbers
+//   Args                            as the only parameter: any number of values
+// Result types: int64_t, bool (the shared #t and #f) and std::shared_ptr to any object.
+//
+// Variadic builtins may also define a static RunBinary with two parameters of the value types
+// (int64_t, bool, Cell, ListView). Calls with two arguments of those types go straight to it,
+// the others to Run.
+
+// A list argument, the empty list or a pair
+class ListView {
+public:
+    ListView() = default;
+    explicit ListView(std::shared_ptr<Cell> cell) : cell_(std::move(cell)) {
+    }
+
+    bool IsEmpty() const {
+        return cell_ == nullptr;
+    }
+    // The number of pairs, see Cell::Length
+    size_t Length() const {
+        return cell_ ? cell_->Length() : 0;
+    }
+    bool IsProper() const {
+        return cell_ == nullptr || cell_->IsProperList();
+    }
+    // nullptr for the empty list
+    const std::shared_ptr<Cell>& GetCell() const {
+        return cell_;
+    }
+
+private:
+    std::shared_ptr<Cell> cell_;
+};
+
+[[noreturn]] inline void ThrowWrongType(size_t index, std::string_view expected) {
+    throw RuntimeError("argument " + std::to_string(index + 1) + " is not " +
+                       std::string(expected));
+}
+
+// Checks and unboxing of one parameter type
+template <class T>
+struct TypedArg;
+
+template <>
+struct TypedArg<int64_t> {
+    static constexpr std::string_view kExpected = "a number";
+    static bool TryUnbox(const std::shared_ptr<Object>& obj, int64_t* value) {
+        auto number = AsRaw<Number>(obj.get());
+        if (number == nullptr) {
+            return false;
+        }
+        *value = number->GetValue();
+        return true;
+    }
+};
+
+template <>
+struct TypedArg<bool> {
+    static constexpr std::string_view kExpected = "a boolean";
+    static bool TryUnbox(const std::shared_ptr<Object>& obj, bool* value) {
+        auto boolean = AsRaw<Boolean>(obj.get());
+        if (boolean == nullptr) {
+            return false;
+        }
+        *value = boolean->GetValue();
+        return true;
+    }
+};
+
+template <>
+struct TypedArg<std::shared_ptr<Cell>> {
+    static constexpr std::string_view kExpected = "a pair";
+    static bool TryUnbox(const std::shared_ptr<Object>& obj, std::shared_ptr<Cell>* value) {
+        *value = As<Cell>(Unquote(obj));
+        return *value != nullptr;
+    }
+};
+
+template <>
+struct TypedArg<ListView> {
+    static constexpr std::string_view kExpected = "a list";
+    static bool TryUnbox(const std::shared_ptr<Object>& obj, ListView* value) {
+        auto list = Unquote(obj);
+        auto cell = As<Cell>(list);
+        if (cell == nullptr && list != nullptr) {
+            return false;
+        }
+        *value = ListView(std::move(cell));
+        return true;
+    }
+};
+
+template <class T>
+T UnboxArg(const std::shared_ptr<Object>& obj, size_t index) {
+    T value{};
+    if (!TypedArg<T>::TryUnbox(obj, &value)) {
+        ThrowWrongType(index, TypedArg<T>::kExpected);
+    }
+    return value;
+}
+
+template <>
+inline const std::shared_ptr<Object>& UnboxArg<const std::shared_ptr<Object>&>(
+    const std::shared_ptr<Object>& obj, size_t) {
+    return obj;
+}
+
+// The arguments of a variadic numeric builtin. Each one is checked when it is read, so a builtin
+// which stops early does not look at the rest.
+class Numbers {
+public:
+    class Iterator {
+    public:
+        Iterator(Args args, size_t index) : args_(args), index_(index) {
+        }
+        int64_t operator*() const {
+            return UnboxArg<int64_t>(args_[index_], index_);
+        }
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        Args args_;
+        size_t index_;
+    };
+
+    explicit Numbers(Args args) : args_(args) {
+    }
+
+    size_t size() const {
+        return args_.size();
+    }
+    bool empty() const {
+        return args_.empty();
+    }
+    int64_t operator[](size_t index) const {
+        return UnboxArg<int64_t>(args_[index], index);
+    }
+    Iterator begin() const {
+        return {args_, 0};
+    }
+    Iterator end() const {
+        return {args_, args_.size()};
+    }
+
+private:
+    Args args_;
+};
+
+inline std::shared_ptr<Object> BoxResult(int64_t value) {
+    return std::make_shared<Number>(value);
+}
+
+inline const std::shared_ptr<Object>& BoxResult(bool value) {
+    return MakeBool(value);
+}
+
+template <class T>
+std::shared_ptr<Object> BoxResult(std::shared_ptr<T> value) {
+    return value;
+}
+
+template <class F>
+struct TypedSignature;
+
+template <class R, class... A>
+struct TypedSignature<R (*)(A...)> {
+    using Params = std::tuple<A...>;
+    static constexpr size_t kCount = sizeof...(A);
+};
+
+// What TypedFunction knows about Run. Derived is not complete yet while TypedFunction<Derived>
+// is, so this is only looked at from the member functions.
+template <class Derived>
+struct TypedTraits {
+    using Params = typename TypedSignature<decltype(&Derived::Run)>::Params;
+    static constexpr size_t kCount = std::tuple_size_v<Params>;
+
+    static constexpr bool IsVariadic() {
+        if constexpr (kCount == 1) {
+            using Param = std::tuple_element_t<0, Params>;
+            return std::is_same_v<Param, Numbers> || std::is_same_v<Param, Args>;
+        } else {
+            return false;
+        }
+    }
+    static constexpr bool kVariadic = IsVariadic();
+    static constexpr bool kUnary = !kVariadic && kCount == 1;
+    static constexpr bool kBinary = !kVariadic && kCount == 2;
+};
+
+template <class Derived>
+class TypedFunction : public Function {
+public:
+    // Each application is a step of the budget, see budget.h
+    std::shared_ptr<Object> Apply(Args args) final {
+        SpendFuel();
+        return Dispatch(args);
+    }
+
+    std::shared_ptr<Object> ApplyUnary(const std::shared_ptr<Object>& arg) final {
+        SpendFuel();
+        if constexpr (TypedTraits<Derived>::kUnary) {
+            return Call([&arg](size_t) -> const std::shared_ptr<Object>& { return arg; },
+                        std::make_index_sequence<1>());
+        } else {
+            return Dispatch(Args(&arg, 1));
+        }
+    }
+
+    std::shared_ptr<Object> ApplyBinary(const std::shared_ptr<Object>& lhs,
+                                        const std::shared_ptr<Object>& rhs) final {
+        SpendFuel();
+        if constexpr (TypedTraits<Derived>::kBinary) {
+            return Call([&lhs, &rhs](size_t i) -> const std::shared_ptr<Object>& {
+                return i == 0 ? lhs : rhs;
+            }, std::make_index_sequence<2>());
+        } else if constexpr (requires { &Derived::RunBinary; }) {
+            using BinaryParams = typename TypedSignature<decltype(&Derived::RunBinary)>::Params;
+            std::tuple_element_t<0, BinaryParams> a{};
+            std::tuple_element_t<1, BinaryParams> b{};
+            if (TypedArg<decltype(a)>::TryUnbox(lhs, &a) &&
+                TypedArg<decltype(b)>::TryUnbox(rhs, &b)) {
+                return BoxResult(Derived::RunBinary(std::move(a), std::move(b)));
+            }
+        }
+        const std::shared_ptr<Object> args[] = {lhs, rhs};
+        return Dispatch(args);
+    }
+
+    // Functions of other fixed arities are called through Apply
+    Arity GetArity() const final {
+        if constexpr (TypedTraits<Derived>::kUnary) {
+            return Arity::kUnary;
+        } else if constexpr (TypedTraits<Derived>::kBinary) {
+            return Arity::kBinary;
+        } else {
+            return Arity::kVariadic;
+        }
+    }
+
+private:
+    // All the entry points end up here, rather than in each other, so Run is called without
+    // going through the vtable again
+    static std::shared_ptr<Object> Dispatch(Args args) {
+        using Traits = TypedTraits<Derived>;
+        if constexpr (Traits::kVariadic) {
+            return BoxResult(Derived::Run(std::tuple_element_t<0, typename Traits::Params>(args)));
+        } else {
+            if (args.size() != Traits::kCount) {
+                throw RuntimeError("no or too many arguments");
+            }
+            return Call([args](size_t i) -> const std::shared_ptr<Object>& { return args[i]; },
+                        std::make_index_sequence<Traits::kCount>());
+        }
+    }
+
+    template <class Get, size_t... I>
+    static std::shared_ptr<Object> Call(Get get, std::index_sequence<I...>) {
+        // braced initialization unboxes, and so checks, the arguments left to right
+        using Params = typename TypedTraits<Derived>::Params;
+        std::tuple<std::tuple_element_t<I, Params>...> values{
+            UnboxArg<std::tuple_element_t<I, Params>>(get(I), I)...};
+        return BoxResult(std::apply(Derived::Run, std::move(values)));
+    }
+};
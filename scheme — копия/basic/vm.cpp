@@ -0,0 +1,1168 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "budget.h"
+#include "builtins.h"
+#include "channel.h"
+#include "environment.h"
+#include "error.h"
+#include "special_forms.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCHEME_VM_COMPUTED_GOTO
+#endif
+
+namespace {
+
+// Operands follow the opcode in the code array
+enum Op : uint32_t {
+    kPushConst,   // k: push constants[k]
+    kCall,        // f n: pop n arguments, push functors[f](arguments)
+    kCallUnary,   // f: pop a, push functors[f](a)
+    kCallBinary,  // f: pop b, pop a, push functors[f](a, b)
+    kSend,        // f: kCallBinary of channel-send, a program which can stop does not wait
+    kReceive,     // f: kCallUnary of channel-receive, same
+    kCallConsts,  // f n k: push functors[f](constants[k], .., constants[k + n - 1])
+    kArith,       // op f: pop b, pop a, push (a op b); functors[f] is the generic version of op
+    kArithConst,  // op f k: same with b = constants[k], which is not on the stack
+    kPop,         // pop a value nobody needs
+    kJump,        // t: continue at code[t]
+    kBranchFalse, // t: pop a, jump to t unless a is true (IsTrue)
+    kJumpIfTrue,  // t: jump to t if the top is true, keeping it
+    kAnd,         // t: if the top stops and (StopsAnd), replace it with #f and jump to t
+    kOr,          // t: if the top stops or (StopsOr), replace it with #t and jump to t
+    kLocal,       // i m: push slot i of the frame, NameError for variable messages[m] if unbound
+    kCaptured,    // i m: same with the captured value i of the closure being run
+    kSelf,        // push the closure being run
+    kSibling,     // i m: push member i of the group of the closure being run, NameError for
+                  // variable messages[m] if it is not defined yet
+    kGlobal,      // g: push globals[g], NameError if it is unbound
+    kSetLocal,    // i: pop into slot i
+    kUnbind,      // i: make slot i unbound
+    kGroup,       // i n: put a new ProcedureGroup of n members into slot i
+    kSetMember,   // i g j: pop into slot i and into variable j of the group in slot g
+    kDefine,      // g: pop into globals[g]
+    kClosure,     // p n: pop n captured values, push a closure of procedures[p]
+    kMember,      // p n g i: same, the closure is procedure i of the group in slot g
+    kApply,       // n: pop n arguments and the callee under them, push callee(arguments)
+    kTailApply,   // n: same, but return the result; a procedure of the VM takes the frame over
+    kFail,        // m: throw RuntimeError(messages[m])
+    kReturn,      // pop the result
+};
+
+// Calls with up to this many arguments take them from a buffer on the C++ stack
+constexpr size_t kInlineArgs = 8;
+
+enum ArithOp : uint32_t {
+    kAdd,
+    kSub,
+    kMul,
+    kDiv,
+    kLess,
+    kLessEq,
+    kGreater,
+    kGreaterEq,
+    kEqual,
+};
+
+constexpr std::pair<std::string_view, ArithOp> kArithOps[] = {
+    {"+", kAdd},     {"-", kSub},      {"*", kMul},         {"/", kDiv},    {"<", kLess},
+    {"<=", kLessEq}, {">", kGreater}, {">=", kGreaterEq}, {"=", kEqual},
+};
+
+// Binary op done inline on two numbers. Returns false if the generic builtin has to do it: the
+// arguments are not numbers, or the op fails and the builtin raises the error.
+bool TryArith(uint32_t op, const std::shared_ptr<Object>& lhs, const std::shared_ptr<Object>& rhs,
+              std::shared_ptr<Object>* res) {
+    auto a = AsRaw<Number>(lhs.get());
+    auto b = AsRaw<Number>(rhs.get());
+    if (a == nullptr || b == nullptr) {
+        return false;
+    }
+    int64_t x = a->GetValue();
+    int64_t y = b->GetValue();
+    int64_t value = 0;
+    switch (op) {
+        case kAdd:
+            if (__builtin_add_overflow(x, y, &value)) {
+                return false;
+            }
+            break;
+        case kSub:
+            if (__builtin_sub_overflow(x, y, &value)) {
+                return false;
+            }
+            break;
+        case kMul:
+            if (__builtin_mul_overflow(x, y, &value)) {
+                return false;
+            }
+            break;
+        case kDiv:
+            if (y == 0 || (y == -1 && x == std::numeric_limits<int64_t>::min())) {
+                return false;
+            }
+            value = x / y;
+            break;
+        case kLess:
+            *res = MakeBool(x < y);
+            return true;
+        case kLessEq:
+            *res = MakeBool(x <= y);
+            return true;
+        case kGreater:
+            *res = MakeBool(x > y);
+            return true;
+        case kGreaterEq:
+            *res = MakeBool(x >= y);
+            return true;
+        case kEqual:
+            *res = MakeBool(x == y);
+            return true;
+    }
+    *res = std::make_shared<Number>(value);
+    return true;
+}
+
+// A compiled top-level expression or lambda
+struct Code {
+    std::vector<uint32_t> code;
+    std::vector<std::shared_ptr<Object>> constants;
+    std::vector<std::shared_ptr<Object>> functors;
+    std::vector<std::string> messages;
+    std::vector<std::shared_ptr<Global>> globals;
+    std::vector<std::shared_ptr<ProcedureCode>> procedures;
+};
+
+// The operand stack is shared by all programs running on the thread. The frame of a program is
+// at the bottom of the part it works in, each program works above the part that was in use when
+// it started and gives it back on exit, exceptions included.
+std::vector<std::shared_ptr<Object>>& OperandStack() {
+    thread_local std::vector<std::shared_ptr<Object>> stack;
+    return stack;
+}
+
+class StackFrame {
+public:
+    explicit StackFrame(std::vector<std::shared_ptr<Object>>* stack)
+        : stack_(stack), base_(stack->size()) {
+    }
+    ~StackFrame() {
+        stack_->resize(base_);
+    }
+
+private:
+    std::vector<std::shared_ptr<Object>>* stack_;
+    size_t base_;
+};
+
+// Moves the top n values off the stack and gives them to call. They leave the operand stack
+// before the call: a builtin running a program on this thread may grow it.
+template <class F>
+std::shared_ptr<Object> PopArgs(std::vector<std::shared_ptr<Object>>* stack, size_t n, F call) {
+    auto first = stack->end() - n;
+    if (n <= kInlineArgs) {
+        std::shared_ptr<Object> args[kInlineArgs];
+        std::move(first, stack->end(), args);
+        stack->erase(first, stack->end());
+        return call(Args(args, n));
+    }
+    std::vector<std::shared_ptr<Object>> args(std::make_move_iterator(first),
+                                              std::make_move_iterator(stack->end()));
+    stack->erase(first, stack->end());
+    return call(Args(args));
+}
+
+using Stack = std::vector<std::shared_ptr<Object>>;
+
+class Procedure;
+
+// Where a procedure goes on when the one it called returns
+struct CallFrame {
+    const Code* code;
+    const uint32_t* pc;
+    size_t base;
+    Closure* closure;
+    std::shared_ptr<Object> callee;
+};
+
+// The frames a program may have, a call which needs more throws RuntimeError. A bound on the
+// memory of a recursion which never ends, which would take the heap otherwise.
+constexpr size_t kMaxFrames = 1 << 21;
+
+// A running program. Procedures of the VM called by it do not run in a loop of their own, their
+// callers wait in frames, so the whole state is here and the program can stop at any safe point
+// and go on later, see ResumableProgram.
+struct Machine {
+    Machine(Stack* stack, const Code* code, Closure* closure, size_t base)
+        : stack(stack), code(code), pc(code->code.data()), base(base), closure(closure) {
+    }
+
+    // Continues with the procedure in a frame at base
+    void Enter(const Procedure* procedure, std::shared_ptr<Object> target, size_t at);
+
+    Stack* stack;
+    const Code* code;
+    const uint32_t* pc;
+    size_t base;
+    // the closure being run, nullptr at the top level, and the one which keeps it alive when the
+    // program called it
+    Closure* closure;
+    std::shared_ptr<Object> callee;
+    std::vector<CallFrame> frames;
+    // the safe points the program passes before it stops
+    uint64_t steps = std::numeric_limits<uint64_t>::max();
+    // the program stops at a channel operation which would wait, rather than wait, and tries
+    // again when it goes on
+    bool resumable = false;
+    std::shared_ptr<Object> result;
+};
+
+// Returns false if the program stopped at a safe point, true when the result is there
+bool RunCode(Machine* m);
+
+class Procedure : public ProcedureCode {
+public:
+    Procedure(uint32_t params, bool variadic, uint32_t frame_size, Code code)
+        : ProcedureCode(params, variadic, frame_size), code_(std::move(code)) {
+    }
+
+    std::shared_ptr<Object> Call(Closure* closure, Args args) override {
+        CheckStack();
+        auto& stack = OperandStack();
+        StackFrame frame(&stack);
+        size_t base = stack.size();
+        stack.resize(base + FrameSize());
+        Bind(args, stack.data() + base);
+        Machine machine(&stack, &code_, closure, base);
+        RunCode(&machine);
+        return std::move(machine.result);
+    }
+
+    const Code* GetCode() const {
+        return &code_;
+    }
+
+private:
+    Code code_;
+};
+
+void Machine::Enter(const Procedure* procedure, std::shared_ptr<Object> target, size_t at) {
+    code = procedure->GetCode();
+    pc = code->code.data();
+    base = at;
+    closure = static_cast<Closure*>(target.get());
+    callee = std::move(target);
+}
+
+class Program : public Node {
+public:
+    std::shared_ptr<Object> Run(Frame*) override {
+        auto& stack = OperandStack();
+        StackFrame frame(&stack);
+        size_t base = stack.size();
+        stack.resize(base + frame_size);
+        Machine machine(&stack, &code, nullptr, base);
+        RunCode(&machine);
+        return std::move(machine.result);
+    }
+
+    Code code;
+    uint32_t frame_size = 0;
+};
+
+// The ops which keep values in locals are done by these functions: gcc does not run the
+// destructors of the locals in the scope a computed goto leaves.
+
+void CallUnary(Stack* stack, const std::shared_ptr<Object>& functor) {
+    auto arg = std::move(stack->back());
+    stack->back() = functor->ApplyUnary(arg);
+}
+
+void CallBinary(Stack* stack, const std::shared_ptr<Object>& functor) {
+    auto rhs = std::move(stack->back());
+    stack->pop_back();
+    auto lhs = std::move(stack->back());
+    stack->back() = functor->ApplyBinary(lhs, rhs);
+}
+
+// channel-send and channel-receive of a program which can stop. False if the channel is full or
+// empty, the arguments stay on the stack then. Anything but a channel goes to the builtin, which
+// reports the error.
+bool TrySend(Stack* stack, const std::shared_ptr<Object>& functor) {
+    auto* channel = dynamic_cast<Channel*>((stack->end() - 2)->get());
+    if (channel == nullptr) {
+        CallBinary(stack, functor);
+        return true;
+    }
+    if (!channel->TrySend(std::move(stack->back()))) {
+        return false;
+    }
+    // a step of the budget, as the call of the builtin would be
+    SpendFuel();
+    stack->pop_back();
+    stack->back() = nullptr;
+    return true;
+}
+
+bool TryReceive(Stack* stack, const std::shared_ptr<Object>& functor) {
+    auto* channel = dynamic_cast<Channel*>(stack->back().get());
+    if (channel == nullptr) {
+        CallUnary(stack, functor);
+        return true;
+    }
+    std::shared_ptr<Object> value;
+    if (!channel->TryReceive(&value)) {
+        return false;
+    }
+    SpendFuel();
+    stack->back() = std::move(value);
+    return true;
+}
+
+// Replaces the top a with (a op rhs)
+void ArithConst(Stack* stack, uint32_t op, const std::shared_ptr<Object>& functor,
+                const std::shared_ptr<Object>& rhs) {
+    std::shared_ptr<Object> res;
+    if (TryArith(op, stack->back(), rhs, &res)) {
+        // a step of the budget, as the call of the builtin would be
+        SpendFuel();
+    } else {
+        auto lhs = std::move(stack->back());
+        res = functor->ApplyBinary(lhs, rhs);
+    }
+    stack->back() = std::move(res);
+}
+
+void Arith(Stack* stack, uint32_t op, const std::shared_ptr<Object>& functor) {
+    auto rhs = std::move(stack->back());
+    stack->pop_back();
+    ArithConst(stack, op, functor, rhs);
+}
+
+// group is the ProcedureGroup the closure is procedure index of, nullptr for other closures
+void MakeClosure(Stack* stack, const std::shared_ptr<ProcedureCode>& procedure, size_t n,
+                 const std::shared_ptr<Object>& group = nullptr, uint32_t index = 0) {
+    std::vector<std::shared_ptr<Object>> captured(std::make_move_iterator(stack->end() - n),
+                                                  std::make_move_iterator(stack->end()));
+    stack->erase(stack->end() - n, stack->end());
+    if (group != nullptr) {
+        auto* procedures = static_cast<ProcedureGroup*>(group.get());
+        stack->push_back(procedures->Define(index, procedure, std::move(captured)));
+    } else {
+        stack->push_back(std::make_shared<Closure>(procedure, std::move(captured)));
+    }
+}
+
+void PushSibling(Stack* stack, Closure* closure, uint32_t index, const std::string& name) {
+    auto value = closure->Group()->Get(index);
+    if (value == Unbound()) {
+        ThrowUnbound(name);
+    }
+    stack->push_back(std::move(value));
+}
+
+Procedure* AsProcedure(const std::shared_ptr<Object>& obj) {
+    auto closure = dynamic_cast<Closure*>(obj.get());
+    return closure ? dynamic_cast<Procedure*>(closure->GetCode()) : nullptr;
+}
+
+// Calls the callee under the top n values and pushes the result. A procedure of the VM is
+// entered instead: the caller, as saved in m, waits in a frame and the frame of the procedure is
+// set up at the callee's slot. Returns true then.
+bool Apply(Machine* m, size_t n) {
+    auto& stack = *m->stack;
+    size_t slot = stack.size() - n - 1;
+    auto target = std::move(stack[slot]);
+    auto procedure = AsProcedure(target);
+    auto res = PopArgs(&stack, n, [&](Args args) -> std::shared_ptr<Object> {
+        stack.pop_back();
+        if (procedure == nullptr) {
+            return Invoke(target, args);
+        }
+        stack.resize(slot + procedure->FrameSize());
+        procedure->Bind(args, stack.data() + slot);
+        return nullptr;
+    });
+    if (procedure == nullptr) {
+        stack.push_back(std::move(res));
+        return false;
+    }
+    if (m->frames.size() == kMaxFrames) {
+        throw RuntimeError("recursion is too deep");
+    }
+    m->frames.push_back({m->code, m->pc, m->base, m->closure, std::move(m->callee)});
+    m->Enter(procedure, std::move(target), slot);
+    return true;
+}
+
+// Same in tail position: a procedure of the VM takes over the frame at m->base. Anything else is
+// called, the result goes to m->result and false is returned.
+bool TailApply(Machine* m, size_t n) {
+    auto& stack = *m->stack;
+    auto target = std::move(*(stack.end() - n - 1));
+    auto procedure = AsProcedure(target);
+    m->result = PopArgs(&stack, n, [&](Args args) -> std::shared_ptr<Object> {
+        stack.pop_back();
+        if (procedure == nullptr) {
+            return Invoke(target, args);
+        }
+        // the frame of the procedure being run is not needed any more
+        stack.resize(m->base);
+        stack.resize(m->base + procedure->FrameSize());
+        procedure->Bind(args, stack.data() + m->base);
+        return nullptr;
+    });
+    if (procedure == nullptr) {
+        return false;
+    }
+    m->Enter(procedure, std::move(target), m->base);
+    return true;
+}
+
+// Gives the value of the procedure at m->base to the caller waiting in the last frame
+void Return(Machine* m, std::shared_ptr<Object> value) {
+    auto& frame = m->frames.back();
+    m->stack->resize(m->base);
+    m->stack->push_back(std::move(value));
+    m->code = frame.code;
+    m->pc = frame.pc;
+    m->base = frame.base;
+    m->closure = frame.closure;
+    m->callee = std::move(frame.callee);
+    m->frames.pop_back();
+}
+
+// The frame of the code being run is stack[base, base + frame size). The registers live in
+// locals while the code runs and go back to m when it leaves for a call or a stop.
+bool RunCode(Machine* m) {
+    auto& stack = *m->stack;
+    const Code* code = m->code;
+    const uint32_t* pc = m->pc;
+    size_t base = m->base;
+    Closure* closure = m->closure;
+
+#ifdef SCHEME_VM_COMPUTED_GOTO
+    // порядок как в enum Op
+    static const void* const kLabels[] = {
+        &&op_kPushConst, &&op_kCall,        &&op_kCallUnary,  &&op_kCallBinary, &&op_kSend,
+        &&op_kReceive,   &&op_kCallConsts,  &&op_kArith,      &&op_kArithConst, &&op_kPop,
+        &&op_kJump,      &&op_kBranchFalse, &&op_kJumpIfTrue, &&op_kAnd,        &&op_kOr,
+        &&op_kLocal,     &&op_kCaptured,    &&op_kSelf,       &&op_kSibling,    &&op_kGlobal,
+        &&op_kSetLocal,  &&op_kUnbind,      &&op_kGroup,      &&op_kSetMember,  &&op_kDefine,
+        &&op_kClosure,   &&op_kMember,      &&op_kApply,      &&op_kTailApply,  &&op_kFail,
+        &&op_kReturn};
+#define VM_OP(op) op_##op:
+#define VM_NEXT goto* kLabels[*pc++]
+#else
+#define VM_OP(op) case op:
+#define VM_NEXT goto dispatch
+#endif
+#define VM_SAVE(at) m->code = code, m->pc = (at), m->base = base, m->closure = closure
+#define VM_LOAD code = m->code, pc = m->pc, base = m->base, closure = m->closure
+// Calls are the safe points: the program stops before the op, which is run when it goes on
+#define VM_SAFE_POINT          \
+    if (m->steps == 0) {       \
+        VM_SAVE(pc - 1);       \
+        return false;          \
+    }                          \
+    --m->steps
+
+#ifdef SCHEME_VM_COMPUTED_GOTO
+    VM_NEXT;
+#else
+dispatch:
+    switch (*pc++) {
+#endif
+
+    VM_OP(kPushConst) {
+        stack.push_back(code->constants[pc[0]]);
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kCall) {
+        VM_SAFE_POINT;
+        const auto& functor = code->functors[pc[0]];
+        size_t n = pc[1];
+        pc += 2;
+        stack.push_back(PopArgs(&stack, n, [&functor](Args args) { return functor->Apply(args); }));
+        VM_NEXT;
+    }
+    VM_OP(kCallUnary) {
+        VM_SAFE_POINT;
+        CallUnary(&stack, code->functors[pc[0]]);
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kCallBinary) {
+        VM_SAFE_POINT;
+        CallBinary(&stack, code->functors[pc[0]]);
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kSend) {
+        VM_SAFE_POINT;
+        if (!m->resumable) {
+            CallBinary(&stack, code->functors[pc[0]]);
+        } else if (!TrySend(&stack, code->functors[pc[0]])) {
+            VM_SAVE(pc - 1);
+            return false;
+        }
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kReceive) {
+        VM_SAFE_POINT;
+        if (!m->resumable) {
+            CallUnary(&stack, code->functors[pc[0]]);
+        } else if (!TryReceive(&stack, code->functors[pc[0]])) {
+            VM_SAVE(pc - 1);
+            return false;
+        }
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kCallConsts) {
+        VM_SAFE_POINT;
+        const auto& functor = code->functors[pc[0]];
+        size_t n = pc[1];
+        const auto* args = code->constants.data() + pc[2];
+        pc += 3;
+        stack.push_back(functor->Apply(Args(args, n)));
+        VM_NEXT;
+    }
+    VM_OP(kArith) {
+        VM_SAFE_POINT;
+        Arith(&stack, pc[0], code->functors[pc[1]]);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kArithConst) {
+        VM_SAFE_POINT;
+        ArithConst(&stack, pc[0], code->functors[pc[1]], code->constants[pc[2]]);
+        pc += 3;
+        VM_NEXT;
+    }
+    VM_OP(kPop) {
+        stack.pop_back();
+        VM_NEXT;
+    }
+    VM_OP(kJump) {
+        pc = code->code.data() + pc[0];
+        VM_NEXT;
+    }
+    VM_OP(kBranchFalse) {
+        bool test = IsTrue(stack.back());
+        stack.pop_back();
+        pc = test ? pc + 1 : code->code.data() + pc[0];
+        VM_NEXT;
+    }
+    VM_OP(kJumpIfTrue) {
+        pc = IsTrue(stack.back()) ? code->code.data() + pc[0] : pc + 1;
+        VM_NEXT;
+    }
+    VM_OP(kAnd) {
+        if (StopsAnd(stack.back())) {
+            stack.back() = MakeBool(false);
+            pc = code->code.data() + pc[0];
+        } else {
+            pc += 1;
+        }
+        VM_NEXT;
+    }
+    VM_OP(kOr) {
+        if (StopsOr(stack.back())) {
+            stack.back() = MakeBool(true);
+            pc = code->code.data() + pc[0];
+        } else {
+            pc += 1;
+        }
+        VM_NEXT;
+    }
+    VM_OP(kLocal) {
+        const auto& value = stack[base + pc[0]];
+        if (value == Unbound()) {
+            ThrowUnbound(code->messages[pc[1]]);
+        }
+        stack.push_back(value);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kCaptured) {
+        const auto& value = closure->Captured(pc[0]);
+        if (value == Unbound()) {
+            ThrowUnbound(code->messages[pc[1]]);
+        }
+        stack.push_back(value);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kSelf) {
+        stack.push_back(closure->shared_from_this());
+        VM_NEXT;
+    }
+    VM_OP(kSibling) {
+        PushSibling(&stack, closure, pc[0], code->messages[pc[1]]);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kGlobal) {
+        const auto& global = code->globals[pc[0]];
+        auto value = global->Load();
+        if (value == Unbound()) {
+            ThrowUnbound(global->name);
+        }
+        stack.push_back(std::move(value));
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kSetLocal) {
+        stack[base + pc[0]] = std::move(stack.back());
+        stack.pop_back();
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kUnbind) {
+        stack[base + pc[0]] = Unbound();
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kGroup) {
+        stack[base + pc[0]] = std::make_shared<ProcedureGroup>(pc[1]);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kSetMember) {
+        auto* group = static_cast<ProcedureGroup*>(stack[base + pc[1]].get());
+        group->Set(pc[2], stack.back());
+        stack[base + pc[0]] = std::move(stack.back());
+        stack.pop_back();
+        pc += 3;
+        VM_NEXT;
+    }
+    VM_OP(kDefine) {
+        code->globals[pc[0]]->Store(std::move(stack.back()));
+        stack.pop_back();
+        pc += 1;
+        VM_NEXT;
+    }
+    VM_OP(kClosure) {
+        MakeClosure(&stack, code->procedures[pc[0]], pc[1]);
+        pc += 2;
+        VM_NEXT;
+    }
+    VM_OP(kMember) {
+        MakeClosure(&stack, code->procedures[pc[0]], pc[1], stack[base + pc[2]], pc[3]);
+        pc += 4;
+        VM_NEXT;
+    }
+    VM_OP(kApply) {
+        VM_SAFE_POINT;
+        VM_SAVE(pc + 1);
+        if (Apply(m, pc[0])) {
+            VM_LOAD;
+        } else {
+            pc += 1;
+        }
+        VM_NEXT;
+    }
+    VM_OP(kTailApply) {
+        VM_SAFE_POINT;
+        VM_SAVE(pc + 1);
+        if (!TailApply(m, pc[0])) {
+            if (m->frames.empty()) {
+                return true;
+            }
+            Return(m, std::move(m->result));
+        }
+        VM_LOAD;
+        VM_NEXT;
+    }
+    VM_OP(kFail) {
+        throw RuntimeError(code->messages[pc[0]]);
+    }
+    VM_OP(kReturn) {
+        if (m->frames.empty()) {
+            m->result = std::move(stack.back());
+            return true;
+        }
+        m->base = base;
+        Return(m, std::move(stack.back()));
+        VM_LOAD;
+        VM_NEXT;
+    }
+
+#ifndef SCHEME_VM_COMPUTED_GOTO
+    }
+    throw RuntimeError("invalid bytecode");
+#endif
+#undef VM_OP
+#undef VM_NEXT
+#undef VM_SAVE
+#undef VM_LOAD
+#undef VM_SAFE_POINT
+}
+
+class Emitter {
+public:
+    Emitter(Code* code, Globals* globals) : code_(code), globals_(globals) {
+    }
+
+    // Mirrors Compiler::Compile
+    void TopLevel(const std::shared_ptr<Object>& obj, Scope* scope) {
+        std::string name;
+        if (obj == nullptr) {
+            Fail("can not calculate");
+        } else if (FindDefinition(obj, &name)) {
+            auto syntax = ParseSpecialForm(SpecialForm::kDefine, As<Cell>(obj)->GetSecond());
+            uint32_t global = Global(globals_->Define(name));
+            if (syntax.lambda) {
+                Lambda(*syntax.lambda, "", scope);
+            } else {
+                Operand(syntax.operands[0], scope, false);
+            }
+            Emit(kDefine, global);
+            Emit(kPushConst, Constant(nullptr));
+        } else {
+            Operand(obj, scope, false);
+        }
+        Emit(kReturn);
+    }
+
+private:
+    // Mirrors Compiler::CompileCall
+    void Call(const std::shared_ptr<Cell>& cell, Scope* scope, bool tail) {
+        auto first = cell->GetFirst();
+        if (auto symbol = As<Symbol>(first)) {
+            SpecialForm form;
+            if (FindSpecialForm(symbol->GetName(), &form)) {
+                SpecialFormCode(ParseSpecialForm(form, cell->GetSecond()), scope, tail);
+                return;
+            }
+            VariableRef ref;
+            bool is_variable = scope->Resolve(symbol->GetName(), &ref);
+            const auto& functor = FindBuiltin(symbol->GetName());
+            if (!is_variable && functor != nullptr) {
+                BuiltinCall(symbol->GetName(), functor, cell->GetSecond(), scope);
+                return;
+            }
+        } else if (Is<Quote>(first)) {
+            if (cell->GetSecond() != nullptr) {
+                Fail("quote takes one argument");
+            } else {
+                Emit(kPushConst, Constant(first));
+            }
+            return;
+        } else if (!Is<Cell>(first)) {
+            Fail("can not apply");
+            return;
+        }
+        Operand(first, scope, false);
+        size_t n = 0;
+        for (ListWalker it(cell->GetSecond()); it.AtCell(); it.Next(), ++n) {
+            Operand(it.Head(), scope, false);
+        }
+        Emit(tail ? kTailApply : kApply, n);
+    }
+
+    void BuiltinCall(const std::string& name, const std::shared_ptr<Object>& functor,
+                     const std::shared_ptr<Object>& arg_list, Scope* scope) {
+        std::vector<std::shared_ptr<Object>> args;
+        bool all_constant = true;
+        for (ListWalker it(arg_list); it.AtCell(); it.Next()) {
+            args.push_back(it.Head());
+            all_constant = all_constant && IsConstant(it.Head());
+        }
+        uint32_t f = Functor(functor);
+
+        const ArithOp* arith = FindArith(name);
+        if (arith != nullptr && args.size() == 2) {
+            Operand(args[0], scope, false);
+            if (!IsConstant(args[1])) {
+                Operand(args[1], scope, false);
+                Emit(kArith, *arith, f);
+            } else {
+                Emit(kArithConst, *arith, f, Constant(args[1]));
+            }
+        } else if (all_constant && !args.empty()) {
+            // the arguments are consecutive constants, the call gets a view of them
+            uint32_t first = Constant(args[0]);
+            for (size_t i = 1; i < args.size(); ++i) {
+                Constant(args[i]);
+            }
+            Emit(kCallConsts, f, args.size(), first);
+        } else {
+            for (const auto& arg : args) {
+                Operand(arg, scope, false);
+            }
+            if (args.size() == 1) {
+                Emit(name == "channel-receive" ? kReceive : kCallUnary, f);
+            } else if (args.size() == 2) {
+                Emit(name == "channel-send" ? kSend : kCallBinary, f);
+            } else {
+                Emit(kCall, f, args.size());
+            }
+        }
+    }
+
+    // Mirrors Compiler::CompileVariable
+    void Variable(const std::string& name, Scope* scope) {
+        VariableRef ref;
+        if (scope->Resolve(name, &ref)) {
+            VariableCode(ref, name);
+        } else if (const auto& builtin = FindBuiltin(name)) {
+            Emit(kPushConst, Constant(builtin));
+        } else {
+            Emit(kGlobal, Global(globals_->Find(name)));
+        }
+    }
+
+    void VariableCode(const VariableRef& ref, const std::string& name) {
+        switch (ref.kind) {
+            case VariableRef::kLocal:
+                Emit(kLocal, ref.index, Message(name));
+                break;
+            case VariableRef::kCaptured:
+                Emit(kCaptured, ref.index, Message(name));
+                break;
+            case VariableRef::kSelf:
+                Emit(kSelf);
+                break;
+            case VariableRef::kSibling:
+                Emit(kSibling, ref.index, Message(name));
+                break;
+        }
+    }
+
+    // The value of every operand of and/or is checked, the jumps go past the last one.
+    // A clause of a conditional jumps to the next one when its test fails, and past the
+    // last clause when it is done.
+    void SpecialFormCode(const SpecialFormSyntax& syntax, Scope* scope, bool tail) {
+        if (syntax.form == SpecialForm::kDefine) {
+            throw SyntaxError("define is only allowed at the top level and in bodies");
+        }
+        if (syntax.form == SpecialForm::kLambda || syntax.form == SpecialForm::kLet) {
+            BindingForm(syntax, scope, tail);
+            return;
+        }
+        if (syntax.form == SpecialForm::kFuture) {
+            Lambda(*syntax.lambda, "", scope);
+            Emit(kCallUnary, Functor(FindBuiltin("spawn")));
+            return;
+        }
+        std::vector<size_t> exits;
+        if (syntax.form == SpecialForm::kAnd || syntax.form == SpecialForm::kOr) {
+            bool is_and = syntax.form == SpecialForm::kAnd;
+            if (syntax.operands.empty()) {
+                Emit(kPushConst, Constant(MakeBool(is_and)));
+            }
+            for (size_t i = 0; i < syntax.operands.size(); ++i) {
+                if (i > 0) {
+                    Emit(kPop);
+                }
+                Operand(syntax.operands[i], scope, false);
+                exits.push_back(Jump(is_and ? kAnd : kOr));
+            }
+        } else {
+            for (const auto& clause : syntax.clauses) {
+                size_t next = 0;
+                if (!clause.is_else) {
+                    Operand(clause.test, scope, false);
+                    if (clause.body.empty()) {
+                        exits.push_back(Jump(kJumpIfTrue));
+                        Emit(kPop);
+                        continue;
+                    }
+                    next = Jump(kBranchFalse);
+                }
+                for (size_t i = 0; i < clause.body.size(); ++i) {
+                    if (i > 0) {
+                        Emit(kPop);
+                    }
+                    Operand(clause.body[i], scope, tail && i + 1 == clause.body.size());
+                }
+                exits.push_back(Jump(kJump));
+                if (clause.is_else) {
+                    break;
+                }
+                Land(next);
+            }
+            if (syntax.clauses.empty() || !syntax.clauses.back().is_else) {
+                Emit(kPushConst, Constant(nullptr));
+            }
+        }
+        for (size_t exit : exits) {
+            Land(exit);
+        }
+    }
+
+    // Mirrors Compiler::CompileBindingForm
+    void BindingForm(const SpecialFormSyntax& syntax, Scope* scope, bool tail) {
+        if (syntax.form == SpecialForm::kLambda) {
+            Lambda(*syntax.lambda, "", scope);
+            return;
+        }
+        if (!syntax.name.empty()) {
+            Lambda(*syntax.lambda, syntax.name, scope);
+            for (const auto& value : syntax.operands) {
+                Operand(value, scope, false);
+            }
+            Emit(tail ? kTailApply : kApply, syntax.operands.size());
+            return;
+        }
+        // all the values are on the stack before the first variable is set: they may use the
+        // slots of the variables for lets of their own
+        for (const auto& value : syntax.operands) {
+            Operand(value, scope, false);
+        }
+        size_t mark = scope->Mark();
+        std::vector<uint32_t> slots;
+        for (const auto& param : syntax.lambda->params) {
+            slots.push_back(scope->Declare(param));
+        }
+        for (auto it = slots.rbegin(); it != slots.rend(); ++it) {
+            Emit(kSetLocal, *it);
+        }
+        Body(syntax.lambda->body, scope, tail);
+        scope->Release(mark);
+    }
+
+    // Mirrors Compiler::CompileLambda. The body goes to a code of its own, the captured values
+    // are pushed here.
+    void Lambda(const LambdaSyntax& lambda, const std::string& self, Scope* scope,
+                std::optional<GroupMember> member = std::nullopt) {
+        Scope inner(scope, self, member);
+        for (const auto& param : lambda.params) {
+            inner.Declare(param);
+        }
+        Code body;
+        Emitter emitter(&body, globals_);
+        emitter.Body(lambda.body, &inner, true);
+        emitter.Emit(kReturn);
+        code_->procedures.push_back(std::make_shared<Procedure>(
+            lambda.params.size(), lambda.variadic, inner.FrameSize(), std::move(body)));
+        for (size_t i = 0; i < inner.Captures().size(); ++i) {
+            VariableCode(inner.Captures()[i], inner.CapturedNames()[i]);
+        }
+        if (member) {
+            Emit(kMember, code_->procedures.size() - 1, inner.Captures().size(), member->group,
+                 member->index);
+        } else {
+            Emit(kClosure, code_->procedures.size() - 1, inner.Captures().size());
+        }
+    }
+
+    // Mirrors Compiler::CompileBody. Definitions leave nothing on the stack.
+    void Body(const std::vector<std::shared_ptr<Object>>& body, Scope* scope, bool tail) {
+        size_t mark = scope->Mark();
+        auto names = BodyDefinitions(body);
+        std::vector<SpecialFormSyntax> definitions(body.size());
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (!names[i].empty()) {
+                definitions[i] =
+                    ParseSpecialForm(SpecialForm::kDefine, As<Cell>(body[i])->GetSecond());
+            }
+        }
+        auto in_group = BodyGroup(names, definitions);
+        uint32_t group_size = std::count(in_group.begin(), in_group.end(), true);
+        int64_t group = group_size > 1 ? static_cast<int64_t>(scope->Declare("")) : -1;
+        std::vector<int64_t> slots(body.size(), -1);
+        std::vector<std::optional<GroupMember>> members(body.size());
+        uint32_t index = 0;
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (names[i].empty()) {
+                continue;
+            }
+            if (group >= 0 && in_group[i]) {
+                members[i] = GroupMember{static_cast<uint32_t>(group), index++};
+            }
+            slots[i] = scope->Declare(names[i], members[i]);
+            Emit(kUnbind, slots[i]);
+        }
+        if (group >= 0) {
+            Emit(kGroup, group, group_size);
+        }
+        for (size_t i = 0; i < body.size(); ++i) {
+            bool last = i + 1 == body.size();
+            if (slots[i] < 0) {
+                Operand(body[i], scope, tail && last);
+                if (!last) {
+                    Emit(kPop);
+                }
+                continue;
+            }
+            const auto& syntax = definitions[i];
+            if (syntax.lambda) {
+                Lambda(*syntax.lambda, syntax.name, scope, members[i]);
+                Emit(kSetLocal, slots[i]);
+            } else if (members[i]) {
+                Operand(syntax.operands[0], scope, false);
+                Emit(kSetMember, slots[i], members[i]->group, members[i]->index);
+            } else {
+                Operand(syntax.operands[0], scope, false);
+                Emit(kSetLocal, slots[i]);
+            }
+            if (last) {
+                Emit(kPushConst, Constant(nullptr));
+            }
+        }
+        scope->Release(mark);
+    }
+
+    // Emits a jump, its target is set by Land
+    size_t Jump(Op op) {
+        Emit(op, 0);
+        return code_->code.size() - 1;
+    }
+
+    // The jump emitted at jump goes to the next instruction emitted
+    void Land(size_t jump) {
+        code_->code[jump] = code_->code.size();
+    }
+
+    // вложенные списки вычисляются, символы это переменные, остальное вычисляется в себя
+    void Operand(const std::shared_ptr<Object>& obj, Scope* scope, bool tail) {
+        if (auto cell = As<Cell>(obj)) {
+            Call(cell, scope, tail);
+        } else if (auto symbol = As<Symbol>(obj)) {
+            Variable(symbol->GetName(), scope);
+        } else {
+            Emit(kPushConst, Constant(obj));
+        }
+    }
+
+    static bool IsConstant(const std::shared_ptr<Object>& obj) {
+        return !Is<Cell>(obj) && !Is<Symbol>(obj);
+    }
+
+    void Fail(std::string message) {
+        Emit(kFail, Message(std::move(message)));
+    }
+
+    uint32_t Message(std::string message) {
+        code_->messages.push_back(std::move(message));
+        return code_->messages.size() - 1;
+    }
+
+    static const ArithOp* FindArith(std::string_view name) {
+        for (const auto& [op_name, op] : kArithOps) {
+            if (op_name == name) {
+                return &op;
+            }
+        }
+        return nullptr;
+    }
+
+    uint32_t Constant(const std::shared_ptr<Object>& obj) {
+        code_->constants.push_back(obj);
+        return code_->constants.size() - 1;
+    }
+
+    uint32_t Functor(const std::shared_ptr<Object>& functor) {
+        for (size_t i = 0; i < code_->functors.size(); ++i) {
+            if (code_->functors[i] == functor) {
+                return i;
+            }
+        }
+        code_->functors.push_back(functor);
+        return code_->functors.size() - 1;
+    }
+
+    uint32_t Global(const std::shared_ptr<::Global>& global) {
+        for (size_t i = 0; i < code_->globals.size(); ++i) {
+            if (code_->globals[i] == global) {
+                return i;
+            }
+        }
+        code_->globals.push_back(global);
+        return code_->globals.size() - 1;
+    }
+
+    template <class... Operands>
+    void Emit(Op op, Operands... operands) {
+        code_->code.push_back(op);
+        (code_->code.push_back(static_cast<uint32_t>(operands)), ...);
+    }
+
+    Code* code_;
+    Globals* globals_;
+};
+
+}  // namespace
+
+BytecodeCompiler::BytecodeCompiler(std::shared_ptr<Globals> globals)
+    : globals_(std::move(globals)) {
+}
+
+std::shared_ptr<Node> BytecodeCompiler::Compile(const std::shared_ptr<Object>& obj) {
+    auto program = std::make_shared<Program>();
+    Scope scope(nullptr, "");
+    Emitter emitter(&program->code, globals_.get());
+    emitter.TopLevel(obj, &scope);
+    program->frame_size = scope.FrameSize();
+    return program;
+}
+
+struct ResumableProgram::State {
+    State(std::shared_ptr<Node> node, Program* program)
+        : node(std::move(node)),
+          stack(program->frame_size),
+          machine(&stack, &program->code, nullptr, 0) {
+        machine.resumable = true;
+    }
+
+    std::shared_ptr<Node> node;
+    Stack stack;
+    Machine machine;
+    bool done = false;
+};
+
+ResumableProgram::ResumableProgram(std::shared_ptr<Node> program) {
+    auto code = dynamic_cast<Program*>(program.get());
+    if (code == nullptr) {
+        throw RuntimeError("the program can not be resumed");
+    }
+    state_ = std::make_unique<State>(std::move(program), code);
+}
+
+ResumableProgram::ResumableProgram(ResumableProgram&&) noexcept = default;
+ResumableProgram& ResumableProgram::operator=(ResumableProgram&&) noexcept = default;
+ResumableProgram::~ResumableProgram() = default;
+
+bool ResumableProgram::Resume(uint64_t steps) {
+    auto& state = *state_;
+    if (state.done) {
+        return true;
+    }
+    state.machine.steps = steps;
+    try {
+        state.done = RunCode(&state.machine);
+    } catch (...) {
+        state.done = true;
+        state.machine.frames.clear();
+        state.machine.callee = nullptr;
+        state.stack.clear();
+        throw;
+    }
+    if (state.done) {
+        state.machine.callee = nullptr;
+        state.stack.clear();
+    }
+    return state.done;
+}
+
+bool ResumableProgram::IsDone() const {
+    return state_->done;
+}
+
+const std::shared_ptr<Object>& ResumableProgram::Result() const {
+    return state_->machine.result;
+}
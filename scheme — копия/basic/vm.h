@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "compiler.h"
+#include "environment.h"
+#include "object.h"
+
+// Second execution engine: parsed expressions are compiled to bytecode for a stack machine
+// (push-constant, call-builtin-n, ...) with superinstructions for the common shapes: calls with
+// only constant arguments and binary arithmetic/comparisons, which are done inline on numbers.
+// Special forms become conditional jumps. Variables are addressed the way Compiler does it (see
+// environment.h): locals live in a frame at the bottom of the operand stack, and a call in tail
+// position to a lambda compiled here reuses the frame of the caller, so loops written as tail
+// recursion run in constant space.
+// The dispatch loop uses computed gotos where the compiler supports them. Calls of lambdas compiled
+// here do not recurse in C++: the caller waits in a frame of the loop, which makes the state of a
+// running program data that can be put aside, see ResumableProgram.
+//
+// A compiled program is a Node, so it can be used anywhere the tree built by Compiler can.
+class BytecodeCompiler {
+public:
+    explicit BytecodeCompiler(std::shared_ptr<Globals> globals = std::make_shared<Globals>());
+
+    std::shared_ptr<Node> Compile(const std::shared_ptr<Object>& obj);
+
+private:
+    std::shared_ptr<Globals> globals_;
+};
+
+// A program compiled by BytecodeCompiler, run a slice at a time. The calls of builtins and of
+// procedures are its safe points: it stops at one once it passed as many as it was given, and
+// goes on from there when it is resumed. A stopped program keeps its state to itself, none of it
+// is on a thread, so any number of them can take turns on a thread and each can be resumed by any
+// thread, one at a time. Builtins are not stopped inside: the procedures they call run to the
+// end within the slice, and a builtin which waits blocks the thread. The exceptions are calls of
+// channel-send and channel-receive by name, which do not wait: while the channel is full or empty
+// the program stops before the call, and tries it again when it is resumed.
+class ResumableProgram {
+public:
+    // Throws RuntimeError if program was not compiled by BytecodeCompiler
+    explicit ResumableProgram(std::shared_ptr<Node> program);
+    ResumableProgram(ResumableProgram&&) noexcept;
+    ResumableProgram& operator=(ResumableProgram&&) noexcept;
+    ~ResumableProgram();
+
+    // Runs the program until it is done or passed steps safe points. Returns true when it is
+    // done. Its error is thrown by the call it happens in, the program is done after that.
+    bool Resume(uint64_t steps);
+    bool IsDone() const;
+    // The value of the program once it is done, nullptr if it failed
+    const std::shared_ptr<Object>& Result() const;
+
+private:
+    struct State;
+
+    std::unique_ptr<State> state_;
+};
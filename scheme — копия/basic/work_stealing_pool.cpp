@@ -0,0 +1,139 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+thread_local WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(size_t workers) : start_(std::chrono::steady_clock::now()) {
+    workers = std::max<size_t>(workers, 1);
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // the deques exist before any worker may steal from them
+    for (size_t i = 0; i < workers; ++i) {
+        workers_[i]->thread = std::thread([this, i] { Loop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+WorkStealingPool* WorkStealingPool::Current() {
+    return current_pool;
+}
+
+void WorkStealingPool::Submit(Task task) {
+    size_t index = current_pool == this ? current_worker : next_++ % workers_.size();
+    {
+        std::lock_guard lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+        ++queued_;
+    }
+    // a worker which saw no tasks is either waiting already or sees queued_ after the lock
+    { std::lock_guard lock(sleep_mutex_); }
+    wake_.notify_one();
+}
+
+bool WorkStealingPool::Take(size_t index, Task* task, bool* stolen) {
+    if (index < workers_.size()) {
+        auto& own = *workers_[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            *stolen = false;
+            --queued_;
+            return true;
+        }
+    }
+    for (size_t i = 1; i <= workers_.size(); ++i) {
+        auto& other = *workers_[(index + i) % workers_.size()];
+        std::lock_guard lock(other.mutex);
+        if (!other.tasks.empty()) {
+            *task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            *stolen = true;
+            --queued_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::Run(size_t index, Task* task, bool stolen) {
+    Worker* worker = index < workers_.size() ? workers_[index].get() : nullptr;
+    // counted before the task, so the stats include the tasks whose results were seen
+    if (worker) {
+        ++worker->executed;
+        if (stolen) {
+            ++worker->stolen;
+        }
+    }
+    auto begin = std::chrono::steady_clock::now();
+    (*task)(index);
+    *task = nullptr;
+    if (worker) {
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        worker->busy_ns +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+}
+
+bool WorkStealingPool::RunPending() {
+    size_t index = current_pool == this ? current_worker : workers_.size();
+    Task task;
+    bool stolen;
+    if (!Take(index, &task, &stolen)) {
+        return false;
+    }
+    Run(index, &task, stolen);
+    return true;
+}
+
+void WorkStealingPool::Loop(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    Task task;
+    bool stolen;
+    while (true) {
+        if (Take(index, &task, &stolen)) {
+            Run(index, &task, stolen);
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+std::vector<WorkStealingPool::WorkerStats> WorkStealingPool::GetStats() const {
+    auto lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+    std::vector<WorkerStats> stats;
+    for (const auto& worker : workers_) {
+        WorkerStats& item = stats.emplace_back();
+        item.tasks = worker->executed;
+        item.stolen = worker->stolen;
+        if (lifetime > 0) {
+            item.utilization = static_cast<double>(worker->busy_ns) / lifetime;
+        }
+    }
+    return stats;
+}
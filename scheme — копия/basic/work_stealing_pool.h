@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads running tasks. Each worker has a deque of its own: it takes the tasks
+// it submitted itself from the back, newest first, and when it has none it steals the oldest
+// ones of the others. Tasks submitted from other threads are spread over the workers in turn.
+class WorkStealingPool {
+public:
+    // The index of the worker running the task. Tasks must not throw.
+    using Task = std::function<void(size_t worker)>;
+
+    struct WorkerStats {
+        uint64_t tasks = 0;         // started
+        uint64_t stolen = 0;        // of those, taken from the deques of other workers
+        double utilization = 0;     // the part of the lifetime of the pool spent running tasks
+    };
+
+    explicit WorkStealingPool(size_t workers);
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    // Runs the tasks which are queued, then joins the workers
+    ~WorkStealingPool();
+
+    void Submit(Task task);
+    // Runs one queued task on the calling thread, for a thread waiting for the result of another
+    // task. Returns false if there was none.
+    bool RunPending();
+
+    size_t Size() const {
+        return workers_.size();
+    }
+    // The tasks submitted and not started yet
+    size_t QueueDepth() const {
+        return queued_.load();
+    }
+    std::vector<WorkerStats> GetStats() const;
+
+    // The pool the calling thread is a worker of, or nullptr
+    static WorkStealingPool* Current();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        std::atomic<uint64_t> executed = 0;
+        std::atomic<uint64_t> stolen = 0;
+        std::atomic<uint64_t> busy_ns = 0;
+    };
+
+    void Loop(size_t index);
+    // Takes a task for the worker index, or for a thread of no pool if index is Size()
+    bool Take(size_t index, Task* task, bool* stolen);
+    void Run(size_t index, Task* task, bool stolen);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> queued_ = 0;
+    std::atomic<size_t> next_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::chrono::steady_clock::time_point start_;
+};